@@ -39,10 +39,19 @@ section .bss
 %endif
 
 ; // the one and only synth object
+%ifdef AUTHORING
+; // the render state runs from here to the end of the delay lines in use, see the keyframes of 4klangrender
+global __4klang_state
+__4klang_state
+%endif
 %if MAX_VOICES > 1
 go4k_voiceindex 		resd	16
 %endif
 go4k_transformed_values	resd	16
+%ifdef AUTHORING
+global __4klang_synth_wrk
+__4klang_synth_wrk
+%endif
 go4k_synth_wrk			resb	go4k_synth.size
 global _go4k_delay_buffer_ofs
 _go4k_delay_buffer_ofs	resd	1
@@ -51,7 +60,24 @@ _go4k_delay_buffer		resd	16*16*go4kDLL_wrk.size
 
 %ifdef AUTHORING
 global __4klang_current_tick
-__4klang_current_tick	resd	0
+__4klang_current_tick	resd	1
+%ifdef SINGLE_TICK_RENDERING
+; // sub tick rendering: a call renders from the current sample of the tick up to the sample end (0 = the whole tick)
+global __4klang_current_sample
+__4klang_current_sample	resd	1
+global __4klang_sample_end
+__4klang_sample_end		resd	1
+%endif
+; // instruments played live by 4klangrender, one bit each, ignore their patterns
+global __4klang_live_instruments
+__4klang_live_instruments	resd	1
+%ifdef GO4K_PROFILE
+; // cycles (rdtsc) and calls of the units, indexed like the dwords of their workspaces in go4k_synth_wrk
+global __4klang_profile_cycles
+__4klang_profile_cycles		resq	go4k_synth.size/4
+global __4klang_profile_calls
+__4klang_profile_calls		resd	go4k_synth.size/4
+%endif
 %endif
 
 %ifdef GO4K_USE_ENVELOPE_RECORDINGS
@@ -127,6 +153,18 @@ c_i12					dd		0x3DAAAAAA
 FREQ_NORMALIZE			dd		0.000092696138	; // 220.0/(2^(69/12)) / 44100.0
 global _LFO_NORMALIZE
 _LFO_NORMALIZE			dd		DEF_LFO_NORMALIZE
+%ifdef AUTHORING
+; // the command and parameter streams the render loop runs, 4klangrender points them to loaded bytecode,
+; // and the notes it plays
+global __4klang_synth_instructions
+__4klang_synth_instructions		dd		go4k_synth_instructions
+global __4klang_synth_parameter_values
+__4klang_synth_parameter_values	dd		go4k_synth_parameter_values
+global __4klang_patterns
+__4klang_patterns				dd		go4k_patterns
+global __4klang_pattern_lists
+__4klang_pattern_lists			dd		go4k_pattern_lists
+%endif
 %ifdef GO4K_USE_GROOVE_PATTERN
 go4k_groove_pattern		dw		0011100111001110b
 %endif
@@ -1602,13 +1640,26 @@ export_func	_4klang_render
 ; loop all ticks	
 go4k_render_tickloop:	
 	push	ecx
+%ifdef SINGLE_TICK_RENDERING
+%ifdef AUTHORING
+	mov		ecx, dword [__4klang_current_sample]
+%else
+	xor		ecx, ecx
+%endif
+%else
 	xor		ecx, ecx
+%endif
 ; loop all samples per tick	
 go4k_render_sampleloop:	
 		push	ecx
 		xor		ecx, ecx
+%ifdef AUTHORING
+		mov		ebx, dword [__4klang_synth_instructions]	; // ebx = instrument command index
+		mov		VAL, dword [__4klang_synth_parameter_values]; // VAL = instrument values index
+%else
 		mov		ebx, go4k_synth_instructions	; // ebx = instrument command index
 		mov		VAL, go4k_synth_parameter_values; // VAL = instrument values index
+%endif
 		mov		edi, _go4k_delay_buffer			; // get offset of first delay buffer
 		mov		dword [_go4k_delay_buffer_ofs], edi	; // store offset in delaybuffer offset variable
 		mov		edi, go4k_synth_wrk				; // edi = first instrument
@@ -1617,6 +1668,10 @@ go4k_render_instrumentloop:
 			mov		eax, dword [esp]				; // eax = current tick sample
 			and		eax, eax
 			jnz		go4k_render_instrument_process	; // tick change? (first sample in current tick)	
+%ifdef AUTHORING
+			bt		dword [__4klang_live_instruments], ecx
+			jc		go4k_render_instrument_process	; // played live, skip the pattern
+%endif
 			call	go4kUpdateInstrument			; // update instrument state
 ; process instrument			
 go4k_render_instrument_process:
@@ -1719,7 +1774,25 @@ go4k_render_nogroove:
 %else
 		cmp		ecx, dword SAMPLES_PER_TICK
 %endif
+%ifdef SINGLE_TICK_RENDERING
+%ifdef AUTHORING
+		jge		go4k_render_tickdone
+		mov		eax, dword [__4klang_sample_end]
+		and		eax, eax
+		jz		go4k_render_sampleloop			; // no sample end, the whole tick
+		cmp		ecx, eax
+		jl		go4k_render_sampleloop
+		mov		dword [__4klang_current_sample], ecx	; // go on from here with the next call
+	pop		ecx
+	jmp		go4k_render_done
+go4k_render_tickdone:
+	mov		dword [__4klang_current_sample], 0
+%else
+		jl		go4k_render_sampleloop	
+%endif
+%else
 		jl		go4k_render_sampleloop	
+%endif
 	pop		ecx	
 	inc		ecx
 %ifdef AUTHORING
@@ -1733,6 +1806,7 @@ no_loop_yet:
 %else 
 	jl		go4k_render_tickloop
 %endif
+go4k_render_done:
 %ifdef GO4K_USE_BUFFER_RECORDINGS	
 	pop		ecx
 %endif	
@@ -1761,7 +1835,27 @@ go4k_VM_process_loop:
 	inc		ebx
 	test	eax, eax	
 	je		go4k_VM_process_done						; // command byte = 0? so done
+%ifdef GO4K_PROFILE
+	push	eax
+	rdtsc
+	push	edx
+	push	eax
+	mov		eax, dword [esp+8]
+	call	dword [eax*4+go4k_synth_commands]
+	rdtsc
+	sub		eax, dword [esp]
+	sbb		edx, dword [esp+4]
+	add		esp, 12
+	push	ecx
+	mov		ecx, WRK
+	sub		ecx, go4k_synth_wrk							; // byte offset of the workspace
+	add		dword [__4klang_profile_cycles+ecx*2], eax
+	adc		dword [__4klang_profile_cycles+ecx*2+4], edx
+	inc		dword [__4klang_profile_calls+ecx]
+	pop		ecx
+%else
 	call	dword [eax*4+go4k_synth_commands]
+%endif
 	add		WRK, MAX_UNIT_SLOTS*4					; // go to next workspace slot
 	jmp		short go4k_VM_process_loop
 go4k_VM_process_done:	
@@ -19,6 +19,17 @@ GO4K_FOP	OP(FOP_ADDP2)
 GO4K_OUT	GAIN(128), AUXSEND(0)
 `);
 
+// delay times the DELAY(index) of the DLL and GLITCH units refer to, the first is the note sync period.
+// instrumentdisassembler -song prints the compact table of its instruments.
+global.setDelayTimes = (times) => {
+	delaytimes = times.slice();
+};
+
+setDelayTimes([0,
+	1116, 1188, 1276, 1356, 1422, 1492, 1556, 1618,
+	1140, 1212, 1300, 1380, 1446, 1516, 1580, 1642,
+	22050, 16537, 11025]);
+
 global.GO4K_FSTG = (amount,instrindex,unitindex,slot,type='FST_SET') => {
 	return `GO4K_FSTG\t`+
 		`AMOUNT(${amount}),`+
@@ -63,12 +74,16 @@ const adjustedBPM = (global.bpm << 2) >> global.beats_per_pattern_shift;
 const vierklangh = `#define	SAMPLE_RATE	44100
 #define	BPM	${adjustedBPM}
 #define	MAX_INSTRUMENTS	${instrumentsArr.length}
+#define	MAX_VOICES 1
 #define	MAX_PATTERNS ${max_patterns * looptimes}
 #define	PATTERN_SIZE_SHIFT ${pattern_size_shift}
 #define	PATTERN_SIZE (1	<< PATTERN_SIZE_SHIFT)
 #define	MAX_TICKS (MAX_PATTERNS*PATTERN_SIZE)
 #define	SAMPLES_PER_TICK (SAMPLE_RATE*4*60/(BPM*PATTERN_SIZE))
 #define	MAX_SAMPLES	(SAMPLES_PER_TICK*MAX_TICKS)
+#define	DELAY_TIMES	${delaytimes.length}
+#define	SONG_PATTERNS ${max_patterns}
+#define	SONG_TICKS (SONG_PATTERNS*PATTERN_SIZE)
 #define SINGLE_TICK_RENDERING`;
 
 const vierklanginc = `
@@ -705,27 +720,7 @@ section .data
 %ifdef GO4K_USE_DLL
 global _go4k_delay_times
 _go4k_delay_times
-	dw 0
-	dw 1116
-	dw 1188
-	dw 1276
-	dw 1356
-	dw 1422
-	dw 1492
-	dw 1556
-	dw 1618
-	dw 1140
-	dw 1212
-	dw 1300
-	dw 1380
-	dw 1446
-	dw 1516
-	dw 1580
-	dw 1642
-	dw 22050
-	dw 16537
-	dw 11025
-%endif
+${delaytimes.map(time => `\tdw ${time}\n`).join('')}%endif
 `;
 	fs.writeFileSync('4klang.h', vierklangh);
 	fs.writeFileSync('4klang.inc', vierklanginc);
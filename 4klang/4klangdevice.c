@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "4klangrender.h"
+#include "4klanglive.h"
+#include "4klangqueue.h"
+#include "4klangdevice.h"
+
+#ifdef SINGLE_TICK_RENDERING
+// device: plays on an ALSA device (-d) instead of writing the samples. a thread with realtime priority
+// renders periods of -p frames, shorter than a tick, through __4klang_sample_end, and writes them
+#ifdef ALSA_OUTPUT
+#include <alsa/asoundlib.h>
+#include <sched.h>
+#define DEVICE_PERIODS 2
+#define DEVICE_PRIORITY 70
+
+typedef struct {
+    snd_pcm_t *pcm;
+    snd_pcm_uframes_t period;
+    snd_pcm_uframes_t buffer;
+    float *samples;                 // one period
+    int starttick;
+    int realtime;
+    int failed;
+    int xruns;
+    snd_pcm_sframes_t maxdelay;     // most frames queued in the device after a period
+} Device;
+
+Device device;
+
+int device_open(Device *d, const char *name, int period) {
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_sw_params_t *sw;
+    int err = snd_pcm_open(&d->pcm, name, SND_PCM_STREAM_PLAYBACK, 0);
+    if(err < 0) {
+        fprintf(stderr,"Unable to open device %s: %s\n", name, snd_strerror(err));
+        return 0;
+    }
+    d->period = period;
+    d->buffer = (snd_pcm_uframes_t)period * DEVICE_PERIODS;
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_hw_params_any(d->pcm, hw);
+    if((err = snd_pcm_hw_params_set_access(d->pcm, hw, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0 ||
+        (err = snd_pcm_hw_params_set_format(d->pcm, hw, SND_PCM_FORMAT_FLOAT_LE)) < 0 ||
+        (err = snd_pcm_hw_params_set_channels(d->pcm, hw, 2)) < 0 ||
+        (err = snd_pcm_hw_params_set_rate(d->pcm, hw, SAMPLE_RATE, 0)) < 0 ||
+        (err = snd_pcm_hw_params_set_period_size_near(d->pcm, hw, &d->period, NULL)) < 0 ||
+        (err = snd_pcm_hw_params_set_buffer_size_near(d->pcm, hw, &d->buffer)) < 0 ||
+        (err = snd_pcm_hw_params(d->pcm, hw)) < 0) {
+        fprintf(stderr,"Unable to play stereo float samples at %d Hz on %s: %s\n", SAMPLE_RATE, name, snd_strerror(err));
+        snd_pcm_close(d->pcm);
+        return 0;
+    }
+    // start once the buffer is full
+    snd_pcm_sw_params_alloca(&sw);
+    snd_pcm_sw_params_current(d->pcm, sw);
+    snd_pcm_sw_params_set_start_threshold(d->pcm, sw, d->buffer);
+    snd_pcm_sw_params(d->pcm, sw);
+    d->samples = malloc(d->period * 2 * sizeof(float));
+    return d->samples != NULL;
+}
+
+void device_write(Device *d, snd_pcm_uframes_t frames) {
+    float *samples = d->samples;
+    while(frames > 0) {
+        snd_pcm_sframes_t written = snd_pcm_writei(d->pcm, samples, frames);
+        if(written < 0) {
+            if(written == -EPIPE)
+                d->xruns++;
+            if(snd_pcm_recover(d->pcm, (int)written, 1) < 0) {
+                fprintf(stderr,"\nDevice: %s\n", snd_strerror((int)written));
+                d->failed = 1;
+                return;
+            }
+            continue;
+        }
+        samples += written * 2;
+        frames -= written;
+    }
+    snd_pcm_sframes_t delay;
+    if(snd_pcm_delay(d->pcm, &delay) == 0 && delay > d->maxdelay)
+        d->maxdelay = delay;
+}
+
+void device_report(Device *d) {
+    fprintf(stderr,"\nDevice: %lu frame periods, %lu frame buffer, latency %.1f ms (%.1f ms queued at most), %d xruns%s\n",
+        (unsigned long)d->period, (unsigned long)d->buffer, (d->buffer + d->period) * 1000.0 / SAMPLE_RATE,
+        d->maxdelay * 1000.0 / SAMPLE_RATE, d->xruns, d->realtime ? "" : ", no realtime priority");
+}
+
+void *device_player(void *arg) {
+    Device *d = (Device *)arg;
+    snd_pcm_uframes_t filled = 0;
+    int n = d->starttick;
+    while(!d->failed) {
+        if(_4klang_current_sample == 0) {
+            if(n == MAX_TICKS || !start_tick(n))
+                break;
+            if(n > d->starttick && n % QUEUE_REPORT_TICKS == 0)
+                device_report(d);
+            n++;
+        }
+        live_apply();
+        // up to the end of the period or of the tick
+        int frames = SAMPLES_PER_TICK - _4klang_current_sample;
+        if((snd_pcm_uframes_t)frames > d->period - filled)
+            frames = d->period - filled;
+        _4klang_sample_end = _4klang_current_sample + frames;
+        _4klang_render(d->samples + filled * 2);
+        filled += frames;
+        if(filled == d->period) {
+            device_write(d, filled);
+            filled = 0;
+        }
+    }
+    if(filled)
+        device_write(d, filled);
+    snd_pcm_drain(d->pcm);
+    return NULL;
+}
+
+int play_device(const char *name, int period, int starttick) {
+    pthread_t player;
+    pthread_attr_t attr;
+    struct sched_param param;
+    Device *d = &device;
+    d->starttick = starttick;
+    if(!device_open(d, name, period))
+        return 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = DEVICE_PRIORITY;
+    pthread_attr_setschedparam(&attr, &param);
+    d->realtime = pthread_create(&player, &attr, device_player, d) == 0;
+    pthread_attr_destroy(&attr);
+    // without the rights for realtime priority (rtprio in /etc/security/limits.conf) it plays at normal priority
+    if(!d->realtime && pthread_create(&player, NULL, device_player, d) != 0) {
+        fprintf(stderr,"Unable to start the player thread\n");
+        return 0;
+    }
+    pthread_join(player, NULL);
+    device_report(d);
+    snd_pcm_close(d->pcm);
+    free(d->samples);
+    return !d->failed;
+}
+#else
+int play_device(const char *name, int period, int starttick) {
+    (void)name;
+    (void)period;
+    (void)starttick;
+    fprintf(stderr,"-d needs a build with -DALSA_OUTPUT and -lasound\n");
+    return 0;
+}
+#endif
+#endif
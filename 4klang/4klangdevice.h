@@ -0,0 +1,7 @@
+#pragma once
+
+// the render in periods shorter than a tick, played on an ALSA device (-d), see 4klangdevice.c
+#define MIN_PERIOD_FRAMES 16
+#define DEFAULT_PERIOD_FRAMES 256
+
+int play_device(const char *name, int period, int starttick);
@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "4klangrender.h"
+#include "4klangkeyframes.h"
+
+#ifdef SINGLE_TICK_RENDERING
+// keyframes: the render state every KEYFRAME_TICKS ticks, kept in a file (-k) to start at any tick (-s)
+// or where the previous process stopped (-r). a keyframe holds the workspaces and the delay lines in
+// use, with the zero runs packed, and a hash of the instruments and of all notes played before it, so
+// that an edit of the song drops the keyframes after it and keeps the ones before.
+#define KEYFRAME_MAGIC 0x666b6b34
+
+typedef struct {
+    unsigned int tick;
+    unsigned int randseed;
+    unsigned long long hash;
+    unsigned int words;             // dwords of state
+    unsigned int packed;            // dwords following: zero run, literal run, literals, ...
+} Keyframe;
+
+FILE *keyframefile = NULL;
+KeyframeHeader keyframeheader;
+long keyframeoffsets[SONG_TICKS / KEYFRAME_TICKS + 1];    // in the file by tick / KEYFRAME_TICKS, 0 for none
+long keyframeend;
+unsigned long long songhash[SONG_TICKS + 1];               // of the instruments and the notes before a tick
+unsigned int *keyframedata = NULL;
+unsigned int keyframedatasize = 0;
+int keyframestainted = 0;                                   // the state was rendered with other instruments
+int keyframesreadonly = 0;                                  // restored from but never written, as by the jobs of -l
+
+unsigned long long hash_bytes(unsigned long long hash, const unsigned char *data, unsigned int size) {
+    for(unsigned int n = 0; n < size; n++) {
+        hash ^= data[n];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void hash_song() {
+    unsigned int commands = 0, values = 0;
+    bytecode_size(MAX_INSTRUMENTS + 1, &commands, &values);
+    unsigned long long hash = 14695981039346656037ULL;
+    hash = hash_bytes(hash, _4klang_synth_instructions, commands);
+    hash = hash_bytes(hash, _4klang_synth_parameter_values, values);
+    // the first delay time is the note sync period the DLL units write
+    hash = hash_bytes(hash, (const unsigned char *)&_go4k_delay_times[1], (DELAY_TIMES - 1) * 2);
+    songhash[0] = hash;
+    for(int tick = 0; tick < SONG_TICKS; tick++) {
+        for(int i = 0; i < MAX_INSTRUMENTS; i++) {
+            unsigned char pattern = _4klang_pattern_lists[i * SONG_PATTERNS + tick / PATTERN_SIZE];
+            hash = hash_bytes(hash, &_4klang_patterns[pattern * PATTERN_SIZE + tick % PATTERN_SIZE], 1);
+        }
+        songhash[tick + 1] = hash;
+    }
+}
+
+unsigned int *keyframe_buffer(unsigned int words) {
+    if(words > keyframedatasize) {
+        free(keyframedata);
+        keyframedata = malloc(words * 4);
+        keyframedatasize = keyframedata ? words : 0;
+    }
+    return keyframedata;
+}
+
+void write_keyframe_header() {
+    fseek(keyframefile, 0, SEEK_SET);
+    fwrite(&keyframeheader, sizeof(keyframeheader), 1, keyframefile);
+    fflush(keyframefile);
+}
+
+// opens the keyframe file, moving the keyframes that still match the song to the front
+int open_keyframes(const char *filename) {
+    keyframefile = fopen(filename, "r+b");
+    if(!keyframefile)
+        keyframefile = fopen(filename, "w+b");
+    if(!keyframefile) {
+        fprintf(stderr,"Unable to open file %s\n", filename);
+        return 0;
+    }
+    hash_song();
+    if(fread(&keyframeheader, sizeof(keyframeheader), 1, keyframefile) != 1 || keyframeheader.magic != KEYFRAME_MAGIC) {
+        keyframeheader.magic = KEYFRAME_MAGIC;
+        keyframeheader.stoptick = 0;
+        keyframeheader.count = 0;
+    }
+    long readoffset = sizeof(keyframeheader);
+    unsigned int count = keyframeheader.count;
+    keyframeend = readoffset;
+    keyframeheader.count = 0;
+    for(unsigned int n = 0; n < count; n++) {
+        Keyframe keyframe;
+        fseek(keyframefile, readoffset, SEEK_SET);
+        unsigned int *data = NULL;
+        if(fread(&keyframe, sizeof(keyframe), 1, keyframefile) != 1 ||
+            !(data = keyframe_buffer(keyframe.packed)) ||
+            fread(data, 4, keyframe.packed, keyframefile) != keyframe.packed) {
+            break;
+        }
+        readoffset += sizeof(keyframe) + keyframe.packed * 4;
+        if(keyframe.tick >= SONG_TICKS || keyframe.tick % KEYFRAME_TICKS || keyframe.hash != songhash[keyframe.tick] ||
+            keyframeoffsets[keyframe.tick / KEYFRAME_TICKS]) {
+            continue;
+        }
+        fseek(keyframefile, keyframeend, SEEK_SET);
+        fwrite(&keyframe, sizeof(keyframe), 1, keyframefile);
+        fwrite(data, 4, keyframe.packed, keyframefile);
+        keyframeoffsets[keyframe.tick / KEYFRAME_TICKS] = keyframeend;
+        keyframeend += sizeof(keyframe) + keyframe.packed * 4;
+        keyframeheader.count++;
+    }
+    write_keyframe_header();
+    fprintf(stderr,"%u of %u keyframes in %s match the song\n", keyframeheader.count, count, filename);
+    return 1;
+}
+
+// the keyframes of the song before a reload of the instruments don't match anymore, and the state
+// rendered since holds the workspaces and delay lines of the old instruments, which no render of the
+// song reaches, so no keyframes are kept anymore until the next process
+void drop_keyframes() {
+    keyframestainted = 1;
+    hash_song();
+    memset(keyframeoffsets, 0, sizeof(keyframeoffsets));
+    keyframeend = sizeof(keyframeheader);
+    keyframeheader.count = 0;
+    if(!keyframesreadonly)
+        write_keyframe_header();
+}
+
+// adds a keyframe before rendering a tick every KEYFRAME_TICKS ticks
+void save_keyframe() {
+    int tick = _4klang_current_tick;
+    if(!keyframefile || keyframestainted || keyframesreadonly || !tick || tick % KEYFRAME_TICKS || keyframeoffsets[tick / KEYFRAME_TICKS])
+        return;
+    // the delay lines in use end where the last sample left the delay buffer offset
+    unsigned int words = (unsigned int)(_go4k_delay_buffer_ofs - _4klang_state);
+    unsigned int *data = keyframe_buffer(words + words / 2 + 2);
+    if(!data)
+        return;
+    Keyframe keyframe = {tick, _RandSeed, songhash[tick], words, 0};
+    for(unsigned int n = 0; n < words;) {
+        unsigned int zeros = 0, literals = 0;
+        while(n + zeros < words && !_4klang_state[n + zeros])
+            zeros++;
+        // single zeros between literals cost less as literals
+        while(n + zeros + literals < words && (_4klang_state[n + zeros + literals] ||
+            (n + zeros + literals + 1 < words && _4klang_state[n + zeros + literals + 1])))
+            literals++;
+        data[keyframe.packed++] = zeros;
+        data[keyframe.packed++] = literals;
+        memcpy(&data[keyframe.packed], &_4klang_state[n + zeros], literals * 4);
+        keyframe.packed += literals;
+        n += zeros + literals;
+    }
+    fseek(keyframefile, keyframeend, SEEK_SET);
+    fwrite(&keyframe, sizeof(keyframe), 1, keyframefile);
+    fwrite(data, 4, keyframe.packed, keyframefile);
+    keyframeoffsets[tick / KEYFRAME_TICKS] = keyframeend;
+    keyframeend += sizeof(keyframe) + keyframe.packed * 4;
+    keyframeheader.count++;
+    write_keyframe_header();
+}
+
+int restore_keyframe(long offset) {
+    Keyframe keyframe;
+    unsigned int *data = NULL;
+    fseek(keyframefile, offset, SEEK_SET);
+    if(fread(&keyframe, sizeof(keyframe), 1, keyframefile) != 1 || !(data = keyframe_buffer(keyframe.packed)) ||
+        fread(data, 4, keyframe.packed, keyframefile) != keyframe.packed) {
+        return 0;
+    }
+    // a job of the server may play other instruments than the ones the file was compacted for
+    if(keyframe.tick >= SONG_TICKS || keyframe.hash != songhash[keyframe.tick])
+        return 0;
+    for(unsigned int n = 0, p = 0; p + 2 <= keyframe.packed && n < keyframe.words;) {
+        unsigned int zeros = data[p++], literals = data[p++];
+        if(n + zeros + literals > keyframe.words || p + literals > keyframe.packed)
+            return 0;
+        memset(&_4klang_state[n], 0, zeros * 4);
+        memcpy(&_4klang_state[n + zeros], &data[p], literals * 4);
+        n += zeros + literals;
+        p += literals;
+    }
+    _RandSeed = keyframe.randseed;
+    _4klang_current_tick = keyframe.tick;
+    return 1;
+}
+
+// restores the keyframe before a tick and renders up to it
+void seek(int tick) {
+    for(int k = tick / KEYFRAME_TICKS; k > 0 && keyframefile; k--) {
+        if(keyframeoffsets[k] && restore_keyframe(keyframeoffsets[k]))
+            break;
+    }
+    int from = _4klang_current_tick;
+    while(_4klang_current_tick < tick) {
+        save_keyframe();
+        _4klang_render(buf);
+    }
+    fprintf(stderr,"Starting at tick %d, rendered %d ticks from tick %d\n", tick, tick - from, from);
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+// the render state kept every KEYFRAME_TICKS ticks (-k), see 4klangkeyframes.c
+#include <stdio.h>
+
+#define KEYFRAME_TICKS 64
+
+typedef struct {
+    unsigned int magic;
+    unsigned int stoptick;          // tick the last process stopped at
+    unsigned int count;             // keyframes following
+} KeyframeHeader;
+
+extern FILE *keyframefile;
+extern KeyframeHeader keyframeheader;
+extern int keyframesreadonly;
+
+void hash_song();
+void write_keyframe_header();
+int open_keyframes(const char *filename);
+void drop_keyframes();
+void save_keyframe();
+void seek(int tick);
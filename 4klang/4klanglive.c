@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "4klangrender.h"
+#include "4klanglive.h"
+
+#ifdef SINGLE_TICK_RENDERING
+// live: notes from a raw MIDI device or FIFO (-m), played on the instrument of their channel instead of
+// its patterns from the first note on. the voices of a channel are the ones of its instrument and of the
+// copies of it that follow (as songs use for chords), the free ones first, else the one playing longest.
+// a reader thread queues the notes, the render applies them between periods (-d) or ticks.
+#define LIVE_EVENTS 256
+#define VOICE_CLEAR_DWORDS (2 + 64 * 16)    // what go4kUpdateInstrument clears for a new note
+#define MAX_LIVE_VOICES (MAX_INSTRUMENTS * MAX_VOICES)
+
+// raw MIDI notes played live, see live_start
+const char *midifile = NULL;
+
+typedef struct {
+    unsigned int *voice;
+    int note;                       // MIDI note held, -1 when released
+    unsigned int started;
+} LiveVoice;
+
+typedef struct {
+    LiveVoice voices[MAX_LIVE_VOICES];
+    int count;
+    unsigned int instruments;       // bits of __4klang_live_instruments
+} LiveChannel;
+
+LiveChannel livechannels[16];
+unsigned int livestarted = 0;
+unsigned char liveevents[LIVE_EVENTS][3];
+volatile unsigned int livehead = 0;  // written by the reader
+volatile unsigned int livetail = 0;  // written by the render
+
+int same_instrument(int a, int b) {
+    unsigned int acommands, avalues, bcommands, bvalues, aend, avend, bend, bvend;
+    bytecode_size(a, &acommands, &avalues);
+    bytecode_size(a + 1, &aend, &avend);
+    bytecode_size(b, &bcommands, &bvalues);
+    bytecode_size(b + 1, &bend, &bvend);
+    return aend - acommands == bend - bcommands && avend - avalues == bvend - bvalues &&
+        !memcmp(&_4klang_synth_instructions[acommands], &_4klang_synth_instructions[bcommands], aend - acommands) &&
+        !memcmp(&_4klang_synth_parameter_values[avalues], &_4klang_synth_parameter_values[bvalues], avend - avalues);
+}
+
+void live_channels() {
+    for(int c = 0; c < 16; c++) {
+        LiveChannel *channel = &livechannels[c];
+        memset(channel, 0, sizeof(LiveChannel));
+        for(int i = c; i < MAX_INSTRUMENTS && (i == c || same_instrument(c, i)); i++) {
+            for(int v = 0; v < MAX_VOICES; v++) {
+                channel->voices[channel->count].voice = &_4klang_synth_wrk[(i * MAX_VOICES + v) * VOICE_DWORDS];
+                channel->voices[channel->count++].note = -1;
+            }
+            channel->instruments |= 1u << i;
+        }
+    }
+}
+
+void live_note(int c, int note, int on) {
+    LiveChannel *channel = &livechannels[c];
+    if(!channel->count)
+        return;
+    if(!on) {
+        for(int v = 0; v < channel->count; v++) {
+            if(channel->voices[v].note == note) {
+                channel->voices[v].voice[0]++;
+                channel->voices[v].note = -1;
+            }
+        }
+        return;
+    }
+    _4klang_live_instruments |= channel->instruments;
+    LiveVoice *voice = &channel->voices[0];
+    for(int v = 0; v < channel->count; v++) {
+        LiveVoice *candidate = &channel->voices[v];
+        int free = candidate->voice[1] == 0, voicefree = voice->voice[1] == 0;
+        if(free != voicefree ? free : candidate->started < voice->started)
+            voice = candidate;
+    }
+    memset(voice->voice, 0, VOICE_CLEAR_DWORDS * 4);
+    voice->voice[1] = note;
+    voice->note = note;
+    voice->started = ++livestarted;
+}
+
+// applies the notes received since the last call
+void live_apply() {
+    while(livetail != livehead) {
+        unsigned char *event = liveevents[livetail % LIVE_EVENTS];
+        int on = (event[0] & 0xf0) == 0x90 && event[2] > 0;
+        if(event[1] > 0)
+            live_note(event[0] & 0x0f, event[1], on);
+        __sync_synchronize();
+        livetail++;
+    }
+}
+
+// reads note on and note off messages with running status, skipping everything else
+void *live_reader(void *arg) {
+    (void)arg;
+    unsigned char status = 0, data[2];
+    int count = 0;
+    for(;;) {
+        FILE *midi = fopen(midifile, "rb");
+        if(!midi) {
+            fprintf(stderr,"Unable to open MIDI input %s\n", midifile);
+            return NULL;
+        }
+        int byte;
+        while((byte = fgetc(midi)) != EOF) {
+            if(byte >= 0xf8) {
+                continue;                           // realtime messages don't change the running status
+            } else if(byte & 0x80) {
+                status = byte < 0xf0 ? byte : 0;    // system messages (sysex) cancel it
+                count = 0;
+            } else if((status & 0xe0) == 0x80) {
+                data[count++] = byte;
+                if(count == 2) {
+                    count = 0;
+                    if(livehead - livetail < LIVE_EVENTS) {
+                        unsigned char *event = liveevents[livehead % LIVE_EVENTS];
+                        event[0] = status;
+                        event[1] = data[0];
+                        event[2] = data[1];
+                        __sync_synchronize();
+                        livehead++;
+                    }
+                }
+            }
+        }
+        fclose(midi);
+        // a FIFO ends with its writer, wait for the next one
+        struct stat st;
+        if(stat(midifile, &st) || !S_ISFIFO(st.st_mode))
+            return NULL;
+    }
+}
+
+int live_start() {
+    pthread_t reader;
+    live_channels();
+    return pthread_create(&reader, NULL, live_reader, NULL) == 0 && pthread_detach(reader) == 0;
+}
+#endif
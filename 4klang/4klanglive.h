@@ -0,0 +1,9 @@
+#pragma once
+
+// notes played live from a raw MIDI input (-m), see 4klanglive.c
+#define VOICE_DWORDS (2 + 64 * 16 + 4)       // go4k_instrument: release, note, workspace and outputs
+
+extern const char *midifile;
+
+void live_apply();
+int live_start();
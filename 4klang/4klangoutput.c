@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "4klangrender.h"
+#include "4klangoutput.h"
+
+// output: the samples as rendered (32 bit float, 16 bit on _WIN32) in a raw stream or a WAV file of
+// 32 bit float or 16 bit samples. the WAV header announces the length of the song up front, so that
+// it can be streamed, and is rewritten with the frames written at the end if the output can seek.
+// it reserves a JUNK chunk that turns into the ds64 chunk of RF64 beyond 4 GB.
+#define WAV_HEADER_SIZE 94
+
+Output output;
+
+void put32(unsigned char *p, unsigned int value) {
+    p[0] = value; p[1] = value >> 8; p[2] = value >> 16; p[3] = value >> 24;
+}
+
+void put64(unsigned char *p, unsigned long long value) {
+    put32(p, (unsigned int)value);
+    put32(p + 4, (unsigned int)(value >> 32));
+}
+
+void write_wav_header(Output *o, unsigned long long frames) {
+    unsigned char h[WAV_HEADER_SIZE];
+    unsigned int blockalign = 2 * o->bits / 8;
+    unsigned long long datasize = frames * blockalign;
+    unsigned long long riffsize = datasize + WAV_HEADER_SIZE - 8;
+    int rf64 = riffsize > 0xffffffffULL;
+    memset(h, 0, sizeof(h));
+    memcpy(h, rf64 ? "RF64" : "RIFF", 4);
+    put32(h + 4, rf64 ? 0xffffffff : (unsigned int)riffsize);
+    memcpy(h + 8, "WAVE", 4);
+    memcpy(h + 12, rf64 ? "ds64" : "JUNK", 4);
+    put32(h + 16, 28);
+    if(rf64) {
+        put64(h + 20, riffsize);
+        put64(h + 28, datasize);
+        put64(h + 36, frames);
+    }
+    memcpy(h + 48, "fmt ", 4);
+    put32(h + 52, 18);
+    h[56] = o->bits == 32 ? 3 : 1;      // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+    h[58] = 2;
+    put32(h + 60, SAMPLE_RATE);
+    put32(h + 64, SAMPLE_RATE * blockalign);
+    h[68] = blockalign;
+    h[70] = o->bits;
+    memcpy(h + 74, "fact", 4);
+    put32(h + 78, 4);
+    put32(h + 82, rf64 ? 0xffffffff : (unsigned int)frames);
+    memcpy(h + 86, "data", 4);
+    put32(h + 90, rf64 ? 0xffffffff : (unsigned int)datasize);
+    if(fwrite(h, sizeof(h), 1, o->file) != 1)
+        o->failed = 1;
+}
+
+void output_start(Output *o, unsigned long long frames) {
+    if(o->wav)
+        write_wav_header(o, frames);
+}
+
+void output_samples(Output *o, const void *samples, int frames) {
+    if(o->failed)
+        return;
+    if(o->bits == RENDER_BITS) {
+        if(fwrite(samples, RENDER_BITS / 8 * 2, frames, o->file) != (size_t)frames)
+            o->failed = 1;
+    } else {
+        // like GO4K_USE_16BIT_OUTPUT does, with the samples clipped already
+        if(frames > o->pcmframes) {
+            free(o->pcm);
+            o->pcm = malloc(frames * 2 * sizeof(short));
+            o->pcmframes = o->pcm ? frames : 0;
+        }
+        const float *f = (const float *)samples;
+        for(int n = 0; n < frames * 2 && o->pcm; n++) {
+            float v = f[n] * 32767.0f;
+            v = v > 32767.0f ? 32767.0f : v < -32767.0f ? -32767.0f : v;
+            o->pcm[n] = (short)(v < 0 ? v - 0.5f : v + 0.5f);
+        }
+        if(!o->pcm || fwrite(o->pcm, sizeof(short) * 2, frames, o->file) != (size_t)frames)
+            o->failed = 1;
+    }
+    if(!o->failed)
+        o->frames += frames;
+}
+
+void output_finish(Output *o, unsigned long long announced) {
+    if(fflush(o->file))
+        o->failed = 1;
+    if(o->wav && !o->failed && o->frames != announced) {
+        if(fseek(o->file, 0, SEEK_SET) == 0)
+            write_wav_header(o, o->frames);
+        else
+            fprintf(stderr,"\nWAV header announces %llu frames, %llu were written\n", announced, o->frames);
+    }
+    if(fclose(o->file))
+        o->failed = 1;
+    free(o->pcm);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// the samples written to a raw stream or a WAV file, see 4klangoutput.c
+#include <stdio.h>
+
+#ifdef _WIN32
+#define RENDER_BITS 16
+#else
+#define RENDER_BITS 32
+#endif
+
+typedef struct {
+    FILE *file;
+    int wav;
+    int bits;
+    unsigned long long frames;      // written
+    short *pcm;                     // float samples converted to 16 bit
+    int pcmframes;
+    int failed;                     // a write failed, nothing more is written
+} Output;
+
+extern Output output;
+
+void output_start(Output *o, unsigned long long frames);
+void output_samples(Output *o, const void *samples, int frames);
+void output_finish(Output *o, unsigned long long announced);
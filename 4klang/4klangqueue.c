@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "4klangrender.h"
+#include "4klangoutput.h"
+#include "4klanglive.h"
+#include "4klangqueue.h"
+
+#ifdef SINGLE_TICK_RENDERING
+// render and output pipeline: the main thread renders ticks into a ring of tick buffers and a writer
+// thread drains them to the output, so that a slow consumer and a slow tick don't stall each other
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Output *out;
+    char *buffers;
+    int size;                       // ticks in the ring
+    int head;                       // ticks rendered
+    int tail;                       // ticks written
+    int done;
+    int maxdepth;                   // most ticks queued
+    int renderstalls;               // the render waited for the writer, the output is too slow
+    int writerstalls;               // the writer waited for the render, the output ran dry
+    int failed;                     // the output failed, the render stops
+} TickQueue;
+
+TickQueue queue;
+
+void *queue_writer(void *arg) {
+    TickQueue *q = (TickQueue *)arg;
+    pthread_mutex_lock(&q->lock);
+    for(;;) {
+        if(q->tail == q->head) {
+            if(q->done)
+                break;
+            if(q->tail)
+                q->writerstalls++;
+            while(q->tail == q->head && !q->done)
+                pthread_cond_wait(&q->changed, &q->lock);
+            continue;
+        }
+        char *tick = q->buffers + (size_t)(q->tail % q->size) * sizeof(buf);
+        pthread_mutex_unlock(&q->lock);
+        output_samples(q->out, tick, SAMPLES_PER_TICK);
+        pthread_mutex_lock(&q->lock);
+        q->failed = q->out->failed;
+        q->tail++;
+        pthread_cond_signal(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+int queue_start(TickQueue *q, Output *out, int size, pthread_t *writer) {
+    memset(q, 0, sizeof(TickQueue));
+    q->out = out;
+    q->size = size;
+    q->buffers = malloc((size_t)size * sizeof(buf));
+    if(!q->buffers)
+        return 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->changed, NULL);
+    return pthread_create(writer, NULL, queue_writer, q) == 0;
+}
+
+// the buffer of the next tick, once the writer made room for it, NULL once the output failed
+void *queue_slot(TickQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    if(q->failed) {
+        pthread_mutex_unlock(&q->lock);
+        return NULL;
+    }
+    if(q->head - q->tail == q->size) {
+        q->renderstalls++;
+        while(q->head - q->tail == q->size)
+            pthread_cond_wait(&q->changed, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return q->buffers + (size_t)(q->head % q->size) * sizeof(buf);
+}
+
+void queue_push(TickQueue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->head++;
+    if(q->head - q->tail > q->maxdepth)
+        q->maxdepth = q->head - q->tail;
+    pthread_cond_signal(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+}
+
+// reports the queue depth and the stalls every QUEUE_REPORT_TICKS ticks
+void queue_report(TickQueue *q, int final) {
+    pthread_mutex_lock(&q->lock);
+    if(final || q->head % QUEUE_REPORT_TICKS == 0) {
+        fprintf(stderr,"\nQueue: %d of %d ticks used at most, %d render stalls (slow output), %d writer stalls (slow render)\n",
+            q->maxdepth, q->size, q->renderstalls, q->writerstalls);
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+void queue_finish(TickQueue *q, pthread_t writer) {
+    pthread_mutex_lock(&q->lock);
+    q->done = 1;
+    pthread_cond_signal(&q->changed);
+    pthread_mutex_unlock(&q->lock);
+    pthread_join(writer, NULL);
+    queue_report(q, 1);
+    free(q->buffers);
+}
+
+int render_output(int starttick, int endtick, int queueticks) {
+    unsigned long long frames = (unsigned long long)(endtick - (starttick < endtick ? starttick : endtick)) * SAMPLES_PER_TICK;
+    output_start(&output, frames);
+
+    pthread_t writer;
+    if(!queue_start(&queue, &output, queueticks, &writer)) {
+        fprintf(stderr,"Unable to start the writer thread\n");
+        return 0;
+    }
+
+    time_t starttime = time(NULL);
+    for(int n=starttick;n<endtick;n++) {
+        time_t elapsed = time(NULL) - starttime;
+        
+        #ifdef _WIN32
+        fprintf(stderr,"Rendering tick %d / %d, elapsed time: %ld seconds\r",_4klang_current_tick, MAX_TICKS, elapsed);
+        #endif
+        if(!start_tick(n)) {
+            break;
+        }
+        // a client or a pipe that goes away, a full disk
+        void *slot = queue_slot(&queue);
+        if(!slot) {
+            break;
+        }
+        live_apply();
+        _4klang_render(slot);
+        queue_push(&queue);
+        queue_report(&queue, 0);
+    }
+    queue_finish(&queue, writer);
+    output_finish(&output, frames);
+    if(output.failed) {
+        fprintf(stderr,"\nUnable to write the output, stopped after %llu frames\n", output.frames);
+        return 0;
+    }
+    return 1;
+}
+#endif
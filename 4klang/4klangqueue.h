@@ -0,0 +1,7 @@
+#pragma once
+
+// the render of ticks into a queue that a writer thread drains to the output, see 4klangqueue.c
+#define MAX_QUEUE_TICKS 64
+#define QUEUE_REPORT_TICKS 256
+
+int render_output(int starttick, int endtick, int queueticks);
@@ -1,25 +1,107 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
-#include "4klang.h"
+#include "4klangrender.h"
+#include "4klangoutput.h"
+#include "4klangkeyframes.h"
+#include "4klangqueue.h"
+#include "4klanglive.h"
+#include "4klangdevice.h"
+#include "4klangserver.h"
+#include "tools/go4kbytecode.h"
 
-#ifdef _WIN32
-#define SIGUSR1 SIGABRT
-#endif
+// the parts of the renderer: 4klangoutput.c writes the samples, 4klangkeyframes.c keeps the render
+// state, 4klangqueue.c renders ticks ahead of the output, 4klanglive.c plays MIDI input,
+// 4klangdevice.c plays on an ALSA device and 4klangserver.c renders the jobs of a Unix socket
 
-#ifdef __linux
-extern void __4klang_render(void*) __attribute__ ((stdcall));
-extern int __4klang_current_tick;
-#define _4klang_current_tick __4klang_current_tick
-#define _4klang_render __4klang_render
-#else
-extern void _4klang_render(void*) __attribute__ ((stdcall));
-extern int _4klang_current_tick;
-#endif
+// instruments written by instrumentdisassembler -bytecode, run instead of the assembled ones
+const char *bytecodefile = NULL;
+unsigned char *bytecode = NULL;
+// name of the song in the JSON of the benchmark, see benchmark
+const char *benchname = NULL;
+// folded stacks of the unit cycles and the table of them for instrumentdisassembler -calibrate, see profile_report
+const char *profilefile = NULL;
+const char *profileunitsfile = NULL;
+// Unix socket of the render server, see serve
+const char *servername = NULL;
+
+// parameter bytes of the commands, see the GO4K_ macros in 4klang.inc
+const unsigned char valuesizes[] = {0, 5, 8, 3, 3, 8, 1, 3, 1, 2, 1, 1, 5, 3};
+
+// bytes of the command and parameter streams of the first instruments (MAX_INSTRUMENTS + 1 with the global chain)
+void bytecode_size(int instruments, unsigned int *commands, unsigned int *values) {
+    *commands = *values = 0;
+    for(int streams = 0; streams < instruments; (*commands)++) {
+        if(!_4klang_synth_instructions[*commands])
+            streams++;
+        *values += valuesizes[_4klang_synth_instructions[*commands]];
+    }
+}
+
+// runs the bytecode in data (malloced, kept while it runs), count bytes of size were read
+int load_bytecode_data(unsigned char *data, long size, long count, const char *filename) {
+    const Go4kBytecodeHeader *header = (const Go4kBytecodeHeader *)data;
+    const char *error = NULL;
+    if(count != size || size < (long)sizeof(Go4kBytecodeHeader) ||
+        memcmp(header->magic, GO4K_BYTECODE_MAGIC, 4) || header->version != GO4K_BYTECODE_VERSION) {
+        error = "is no go4k bytecode";
+    } else if((long)sizeof(Go4kBytecodeHeader) + (long)header->commands + (long)header->values + (long)header->delaytimes * 2 != size) {
+        error = "is truncated";
+    } else if(header->instruments != MAX_INSTRUMENTS) {
+        error = "has another number of instruments than the song";
+    } else if(header->delaytimes > DELAY_TIMES) {
+        error = "has more delay times than the song";
+    } else if(header->delaylines > GO4K_BYTECODE_DELAY_LINES) {
+        error = "has more delay lines than 4klang.asm";
+    } else {
+        // the render loop runs the command streams up to the one of the global chain
+        const unsigned char *commands = data + sizeof(Go4kBytecodeHeader);
+        unsigned int streams = 0, values = 0;
+        for(unsigned int n = 0; n < header->commands && !error; n++) {
+            if(commands[n] >= sizeof(valuesizes))
+                error = "has unknown units";
+            else if(commands[n] == 0)
+                streams++;
+            values += valuesizes[commands[n] < sizeof(valuesizes) ? commands[n] : 0];
+        }
+        if(!error && (streams != MAX_INSTRUMENTS + 1 || commands[header->commands - 1] || values != header->values))
+            error = "has broken command streams";
+    }
+    if(error) {
+        fprintf(stderr,"%s %s\n", filename, error);
+        free(data);
+        return 0;
+    }
+
+    _4klang_synth_instructions = data + sizeof(Go4kBytecodeHeader);
+    _4klang_synth_parameter_values = _4klang_synth_instructions + header->commands;
+    memcpy(_go4k_delay_times, _4klang_synth_parameter_values + header->values, header->delaytimes * 2);
+    free(bytecode);
+    bytecode = data;
+    fprintf(stderr,"\nLoaded %s\n", filename);
+    return 1;
+}
+
+int load_bytecode(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if(!file) {
+        fprintf(stderr,"Unable to open file %s\n", filename);
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *data = malloc(size > 0 ? size : 1);
+    long count = data ? (long)fread(data, 1, size, file) : 0;
+    fclose(file);
+    return load_bytecode_data(data, size, count, filename);
+}
 
 #ifdef SINGLE_TICK_RENDERING
 #include <time.h>
 volatile sig_atomic_t keep_going = 1;
+volatile sig_atomic_t reload_bytecode = 0;
 #ifdef _WIN32
 char buf[SAMPLES_PER_TICK * 2 * 2];
 #else
@@ -31,53 +113,409 @@ void sig_handler(int sig) {
         keep_going = 0;
         fprintf(stderr,"\nWill exit soon\n");        
     }
+#ifdef SIGHUP
+    if(sig==SIGHUP) {
+        reload_bytecode = 1;
+    }
+#endif
+}
+
+// profile: a build of 4klang.asm and 4klangrender.c with -DGO4K_PROFILE counts the cycles and calls of every
+// unit, at the offset of its workspace. the report at the end (also after SIGUSR1) sums them by unit type,
+// instrument and unit, -P writes them as folded stacks for flamegraph.pl and -U as lines of command stream, unit,
+// command, calls and cycles for instrumentdisassembler -calibrate
+#ifdef GO4K_PROFILE
+#define PROFILE_DWORDS ((MAX_INSTRUMENTS + 1) * MAX_VOICES * VOICE_DWORDS)
+#define PROFILE_UNITS ((MAX_INSTRUMENTS + 1) * 64)
+
+typedef struct {
+    char name[40];
+    unsigned long long cycles;
+    unsigned long long calls;
+} ProfileEntry;
+
+const char *unitnames[] = {"", "ENV", "VCO", "VCF", "DST", "DLL", "FOP", "FST", "PAN", "OUT", "ACC", "FLD", "GLITCH", "FSTG"};
+ProfileEntry profiletypes[sizeof(valuesizes)];
+ProfileEntry profileinstruments[MAX_INSTRUMENTS + 1];
+ProfileEntry profileunits[PROFILE_UNITS];
+
+// the counts belong to the units they were taken with, a reload of the instruments starts over
+void profile_reset() {
+    memset(_4klang_profile_cycles, 0, PROFILE_DWORDS * sizeof(unsigned long long));
+    memset(_4klang_profile_calls, 0, PROFILE_DWORDS * sizeof(unsigned int));
+}
+
+int compare_profile(const void *a, const void *b) {
+    unsigned long long x = ((const ProfileEntry *)a)->cycles, y = ((const ProfileEntry *)b)->cycles;
+    return x > y ? -1 : x < y;
+}
+
+void profile_section(const char *title, ProfileEntry *entries, int count, unsigned long long total) {
+    qsort(entries, count, sizeof(ProfileEntry), compare_profile);
+    fprintf(stderr,"\n%-24s %16s %7s %12s %10s\n", title, "cycles", "", "calls", "per call");
+    for(int n = 0; n < count && entries[n].cycles; n++) {
+        fprintf(stderr,"%-24s %16llu %6.1f%% %12llu %10.1f\n", entries[n].name, entries[n].cycles,
+            entries[n].cycles * 100.0 / total, entries[n].calls, (double)entries[n].cycles / entries[n].calls);
+    }
+}
+
+void profile_report() {
+    FILE *folded = profilefile ? fopen(profilefile, "w") : NULL;
+    if(profilefile && !folded)
+        fprintf(stderr,"Unable to open file %s\n", profilefile);
+    FILE *unitsfile = profileunitsfile ? fopen(profileunitsfile, "w") : NULL;
+    if(profileunitsfile && !unitsfile)
+        fprintf(stderr,"Unable to open file %s\n", profileunitsfile);
+    memset(profiletypes, 0, sizeof(profiletypes));
+    memset(profileinstruments, 0, sizeof(profileinstruments));
+    memset(profileunits, 0, sizeof(profileunits));
+    for(int type = 1; type < (int)sizeof(valuesizes); type++)
+        strcpy(profiletypes[type].name, unitnames[type]);
+    unsigned long long total = 0, samples = 0;
+    int units = 0;
+    unsigned int command = 0;
+    // the command streams in the order of the workspaces, the global chain last
+    for(int i = 0; i <= MAX_INSTRUMENTS; i++, command++) {
+        ProfileEntry *instrument = &profileinstruments[i];
+        if(i < MAX_INSTRUMENTS)
+            snprintf(instrument->name, sizeof(instrument->name), "instrument %d", i);
+        else
+            strcpy(instrument->name, "global");
+        for(int slot = 0; _4klang_synth_instructions[command]; slot++, command++) {
+            int type = _4klang_synth_instructions[command];
+            ProfileEntry *unit = &profileunits[units++];
+            snprintf(unit->name, sizeof(unit->name), "%.16s %d %.6s", instrument->name, slot, unitnames[type]);
+            for(int v = 0; v < MAX_VOICES; v++) {
+                unsigned int offset = (i * MAX_VOICES + v) * VOICE_DWORDS + 2 + slot * 16;
+                unit->cycles += _4klang_profile_cycles[offset];
+                unit->calls += _4klang_profile_calls[offset];
+            }
+            // the global chain runs once every sample
+            if(i == MAX_INSTRUMENTS && !slot)
+                samples = unit->calls;
+            profiletypes[type].cycles += unit->cycles;
+            profiletypes[type].calls += unit->calls;
+            instrument->cycles += unit->cycles;
+            instrument->calls += unit->calls;
+            total += unit->cycles;
+            if(folded && unit->cycles)
+                fprintf(folded, "4klang;%s;%d %s %llu\n", instrument->name, slot, unitnames[type], unit->cycles);
+            if(unitsfile)
+                fprintf(unitsfile, "%d %d %d %llu %llu\n", i, slot, type, unit->calls, unit->cycles);
+        }
+    }
+    if(folded)
+        fclose(folded);
+    if(unitsfile)
+        fclose(unitsfile);
+    if(!total)
+        return;
+    fprintf(stderr,"\nProfile: %llu cycles in the units", total);
+    if(samples)
+        fprintf(stderr,", %.0f per sample", (double)total / samples);
+    fprintf(stderr,"\n");
+    profile_section("unit type", profiletypes, sizeof(valuesizes), total);
+    profile_section("instrument", profileinstruments, MAX_INSTRUMENTS + 1, total);
+    profile_section("unit", profileunits, units, total);
+}
+#endif
+
+// the work between ticks: stops on SIGUSR1, loads the instruments again on SIGHUP and keeps a keyframe
+int start_tick(int n) {
+    if(((n % 16) == 0) && !keep_going) {
+        return 0;
+    }
+    // changed instruments play from the next tick on
+    if(reload_bytecode && bytecodefile) {
+        reload_bytecode = 0;
+        if(load_bytecode(bytecodefile)) {
+            if(keyframefile)
+                drop_keyframes();
+#ifdef GO4K_PROFILE
+            profile_reset();
+#endif
+        }
+    }
+    save_keyframe();
+    return 1;
+}
+
+// benchmark (-B): renders the song without output, timing every tick, best of BENCH_RUNS runs. the share
+// of an instrument is the time saved by a render without its units, what remains is the global chain.
+// prints one line of JSON (see tools/benchmark.sh)
+#define BENCH_RUNS 3
+
+unsigned int benchrandseed;
+unsigned int benchwords = 0;        // dwords of state the render used
+
+int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+double bench_seconds() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// renders the song from the start, returns the seconds and the ones of every tick
+double bench_run(double *ticktimes) {
+    memset(_4klang_state, 0, benchwords * 4);
+    _RandSeed = benchrandseed;
+    _4klang_current_tick = 0;
+    double total = 0;
+    for(int n = 0; n < SONG_TICKS && keep_going; n++) {
+        double start = bench_seconds();
+        _4klang_render(buf);
+        double seconds = bench_seconds() - start;
+        if(ticktimes)
+            ticktimes[n] = seconds;
+        total += seconds;
+    }
+    unsigned int words = (unsigned int)(_go4k_delay_buffer_ofs - _4klang_state);
+    if(words > benchwords)
+        benchwords = words;
+    return total;
+}
+
+int benchmark(const char *name) {
+    double *ticktimes = malloc(SONG_TICKS * sizeof(double) * 2), *besttimes = ticktimes + SONG_TICKS;
+    unsigned int commands, values, begin, beginvalues, end, endvalues;
+    bytecode_size(MAX_INSTRUMENTS + 1, &commands, &values);
+    unsigned char *instructions = _4klang_synth_instructions, *parametervalues = _4klang_synth_parameter_values;
+    unsigned char *without = malloc(commands + values);
+    if(!ticktimes || !without) {
+        fprintf(stderr,"Unable to allocate the benchmark buffers\n");
+        return 0;
+    }
+    benchrandseed = _RandSeed;
+    double best = 0;
+    for(int run = 0; run < BENCH_RUNS; run++) {
+        double seconds = bench_run(ticktimes);
+        if(!run || seconds < best) {
+            best = seconds;
+            memcpy(besttimes, ticktimes, SONG_TICKS * sizeof(double));
+        }
+        fprintf(stderr,"Run %d: %.3f s\n", run + 1, seconds);
+    }
+    double songseconds = (double)SONG_TICKS * SAMPLES_PER_TICK / SAMPLE_RATE;
+    qsort(besttimes, SONG_TICKS, sizeof(double), compare_doubles);
+    printf("{\"name\":\"%s\",\"ticks\":%d,\"samples_per_tick\":%d,\"seconds\":%.6f,\"realtime\":%.2f,"
+        "\"tick_ms\":{\"p50\":%.4f,\"p99\":%.4f,\"max\":%.4f},\"instruments\":[",
+        name, SONG_TICKS, SAMPLES_PER_TICK, best, songseconds / best,
+        besttimes[SONG_TICKS / 2] * 1000, besttimes[SONG_TICKS * 99 / 100] * 1000, besttimes[SONG_TICKS - 1] * 1000);
+
+    // the command streams with the one of the instrument emptied, and its parameters left out
+    double shares = 0;
+    for(int i = 0; i < MAX_INSTRUMENTS; i++) {
+        _4klang_synth_instructions = instructions;
+        bytecode_size(i, &begin, &beginvalues);
+        bytecode_size(i + 1, &end, &endvalues);
+        memcpy(without, instructions, begin);
+        without[begin] = 0;
+        memcpy(without + begin + 1, instructions + end, commands - end);
+        memcpy(without + commands, parametervalues, beginvalues);
+        memcpy(without + commands + beginvalues, parametervalues + endvalues, values - endvalues);
+        _4klang_synth_instructions = without;
+        _4klang_synth_parameter_values = without + commands;
+        double share = (best - bench_run(NULL)) / best;
+        _4klang_synth_parameter_values = parametervalues;
+        // the timing noise of instruments that cost next to nothing
+        share = share > 0 ? share : 0;
+        shares += share;
+        printf("%s%.4f", i ? "," : "", share);
+        fprintf(stderr,"Instrument %d: %.1f %%\n", i, share * 100);
+    }
+    _4klang_synth_instructions = instructions;
+    printf("],\"global\":%.4f}\n", shares < 1 ? 1 - shares : 0);
+    fflush(stdout);
+    free(ticktimes);
+    free(without);
+    return keep_going;
 }
 #else
 float buf[MAX_SAMPLES * 2];
 #endif
 
-int main() {
-    FILE *fp;
+void usage() {
+    fprintf(stderr,"USAGE: 4klangrender [-o file] [-w] [-b 16|32] [-q ticks | -d device [-p frames]] [-m midi] [-k keyframes] [-s tick | -r] [-P folded] [-U units] [instruments.4kb]\n");
+    fprintf(stderr,"       4klangrender -B name [instruments.4kb]\n");
+    fprintf(stderr,"       4klangrender -l socket [-j jobs] [-k keyframes] [instruments.4kb]\n");
+    fprintf(stderr,"  instruments.4kb is played instead of the assembled instruments and reloaded on SIGHUP\n");
+    fprintf(stderr,"  -o writes to a file instead of stdout\n");
+    fprintf(stderr,"  -w writes a WAV file (RF64 beyond 4 GB) instead of raw samples\n");
+    fprintf(stderr,"  -b writes 16 bit or 32 bit float samples (default %d)\n", RENDER_BITS);
+#ifdef SINGLE_TICK_RENDERING
+    fprintf(stderr,"  -q renders up to that many ticks ahead of the output, 1 to %d (default 4)\n", MAX_QUEUE_TICKS);
+    fprintf(stderr,"  -d plays on an ALSA device, rendering periods of -p frames, %d to %d (default %d)\n", MIN_PERIOD_FRAMES, SAMPLES_PER_TICK, DEFAULT_PERIOD_FRAMES);
+    fprintf(stderr,"  -m plays the notes from a raw MIDI device or FIFO, channel 1 on the first instrument\n");
+    fprintf(stderr,"  -k keeps keyframes of the render state in a file, every %d ticks\n", KEYFRAME_TICKS);
+    fprintf(stderr,"  -s starts at a tick, from the keyframe before it\n");
+    fprintf(stderr,"  -r starts at the tick the last process with the same keyframes stopped at\n");
+    fprintf(stderr,"  -B times the render of the song and of every instrument without output, printing JSON\n");
+    fprintf(stderr,"  -l renders the jobs of clients of a Unix socket, -j at once (default a job per core), see serve\n");
+#ifdef GO4K_PROFILE
+    fprintf(stderr,"  -P writes the cycles of the units as folded stacks for flamegraph.pl, with the report at the end\n");
+    fprintf(stderr,"  -U writes the calls and cycles of the units for instrumentdisassembler -calibrate\n");
+#else
+    fprintf(stderr,"  -P and -U need a build of 4klang.asm and 4klangrender.c with -DGO4K_PROFILE\n");
+#endif
+#else
+    fprintf(stderr,"  -q, -d, -p, -m, -k, -s, -r, -B, -l, -j, -P and -U need SINGLE_TICK_RENDERING\n");
+#endif
+}
+
+int main(int argc, char *argv[]) {
+#ifdef _WIN32
+    const char *filename = "petersalomonsen_4klangfirstattempt.wav";
+    output.wav = 1;
+#else
+    const char *filename = NULL;
+#endif
+    output.bits = RENDER_BITS;
+    const char *keyframes = NULL;
+    int starttick = 0;
+    int resume = 0;
+    int queueticks = 0;
+    const char *devicename = NULL;
+    int periodframes = 0;
+    int workers = 0;
+    for(int arg = 1; arg < argc; arg++) {
+        if(!strcmp(argv[arg], "-k") && arg + 1 < argc) {
+            keyframes = argv[++arg];
+        } else if(!strcmp(argv[arg], "-s") && arg + 1 < argc) {
+            starttick = atoi(argv[++arg]);
+        } else if(!strcmp(argv[arg], "-q") && arg + 1 < argc) {
+            queueticks = atoi(argv[++arg]);
+        } else if(!strcmp(argv[arg], "-r")) {
+            resume = 1;
+        } else if(!strcmp(argv[arg], "-d") && arg + 1 < argc) {
+            devicename = argv[++arg];
+        } else if(!strcmp(argv[arg], "-p") && arg + 1 < argc) {
+            periodframes = atoi(argv[++arg]);
+        } else if(!strcmp(argv[arg], "-m") && arg + 1 < argc) {
+            midifile = argv[++arg];
+        } else if(!strcmp(argv[arg], "-B") && arg + 1 < argc) {
+            benchname = argv[++arg];
+        } else if(!strcmp(argv[arg], "-l") && arg + 1 < argc) {
+            servername = argv[++arg];
+        } else if(!strcmp(argv[arg], "-j") && arg + 1 < argc) {
+            workers = atoi(argv[++arg]);
+        } else if(!strcmp(argv[arg], "-P") && arg + 1 < argc) {
+            profilefile = argv[++arg];
+        } else if(!strcmp(argv[arg], "-U") && arg + 1 < argc) {
+            profileunitsfile = argv[++arg];
+        } else if(!strcmp(argv[arg], "-o") && arg + 1 < argc) {
+            filename = argv[++arg];
+        } else if(!strcmp(argv[arg], "-w")) {
+            output.wav = 1;
+        } else if(!strcmp(argv[arg], "-b") && arg + 1 < argc) {
+            output.bits = atoi(argv[++arg]);
+        } else if(argv[arg][0] == '-') {
+            usage();
+            return 1;
+        } else {
+            bytecodefile = argv[arg];
+        }
+    }
+    if((output.bits != 16 && output.bits != 32) || output.bits > RENDER_BITS) {
+        usage();
+        return 1;
+    }
+    // a device plays the samples instead of an output
+    if(devicename ? filename != NULL || output.wav || output.bits != RENDER_BITS || queueticks : periodframes) {
+        usage();
+        return 1;
+    }
+    // the benchmark renders the whole song from the start and nothing else, the jobs of the server say what they render
+    if(((benchname || servername) && (devicename || filename != NULL || output.wav || output.bits != RENDER_BITS || queueticks ||
+        midifile || (keyframes && !servername) || starttick || resume || profilefile || profileunitsfile)) ||
+        (benchname && servername) || (workers && !servername)) {
+        usage();
+        return 1;
+    }
+#ifndef GO4K_PROFILE
+    if(profilefile || profileunitsfile) {
+        usage();
+        return 1;
+    }
+#endif
+    if(bytecodefile && !load_bytecode(bytecodefile)) {
+        return 1;
+    }
     #ifdef _WIN32
     fprintf(stderr,"\n4klang - First Attempt - composed by Peter Salomonsen in the year 2019\r\n");
-    const char * filename = "petersalomonsen_4klangfirstattempt.wav";
     fprintf(stderr,"\nWriting to wav file %s\r\n\n", filename);
-    fp = fopen(filename, "wb");
-    const unsigned int bytelength = MAX_SAMPLES * 2 * 2;
-    char header[] = {0x52, 0x49, 0x46, 0x46, 0x24, 0x08, 0x00, 0x00, 0x57, 0x41, 0x56, 0x45, 0x66, 0x6d, 0x74, 0x20, 0x10, 0x00, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 
-        0x44, 0xac, 0x00, 0x00, 0x88, 0x58, 0x01, 0x00, 0x04, 0x00, 0x10, 0x00, 0x64, 0x61, 0x74, 0x61,
-        bytelength & 0xff, (bytelength >> 8) & 0xff, (bytelength >> 16) & 0xff, (bytelength >> 24) & 0xff};
-    fwrite(header, sizeof(header), 1, fp);
-    #else
-    fp = fdopen(fileno(stdout), "wb");
     #endif
+    if(!devicename && !benchname && !servername) {
+        output.file = filename ? fopen(filename, "wb") : fdopen(fileno(stdout), "wb");
+        if(!output.file) {
+            fprintf(stderr,"Unable to open file %s\n", filename);
+            return 1;
+        }
+    }
     
 #ifdef SINGLE_TICK_RENDERING
     signal(SIGUSR1, sig_handler);
+#ifdef SIGHUP
+    signal(SIGHUP, sig_handler);
+#endif
     _4klang_current_tick = 0;
+    if(benchname) {
+        return benchmark(benchname) ? 0 : 1;
+    }
+    if(servername) {
+        return serve(servername, workers, keyframes) ? 0 : 1;
+    }
+    if(keyframes && !open_keyframes(keyframes)) {
+        return 1;
+    }
+    if(resume) {
+        starttick = keyframeheader.stoptick;
+    }
+    if(starttick > 0) {
+        seek(starttick % SONG_TICKS);
+    }
 
-    time_t starttime = time(NULL);
-    for(int n=0;n<MAX_TICKS;n++) {
-        if(
-            ((n % 16) == 0) &&
-            !keep_going) {
-            break;
-        }
-
-        time_t elapsed = time(NULL) - starttime;
-        
-        #ifdef _WIN32
-        fprintf(stderr,"Rendering tick %d / %d, elapsed time: %ld seconds\r",_4klang_current_tick, MAX_TICKS, elapsed);
-        #endif
-        _4klang_render(buf);
-        
-        fwrite(buf, sizeof(buf), 1, fp);
+    if(!queueticks) {
+        queueticks = 4;
+    }
+    if(!periodframes) {
+        periodframes = DEFAULT_PERIOD_FRAMES;
+    }
+    // keyframes hold the notes of the song, not the ones played live
+    if(queueticks < 1 || queueticks > MAX_QUEUE_TICKS || periodframes < MIN_PERIOD_FRAMES || periodframes > SAMPLES_PER_TICK ||
+        (midifile && keyframes)) {
+        usage();
+        return 1;
+    }
+    if(midifile && !live_start()) {
+        fprintf(stderr,"Unable to start the MIDI reader thread\n");
+        return 1;
+    }
+    int played = devicename ? play_device(devicename, periodframes, starttick) : render_output(starttick, MAX_TICKS, queueticks);
+#ifdef GO4K_PROFILE
+    profile_report();
+#endif
+    if(keyframefile) {
+        keyframeheader.stoptick = _4klang_current_tick;
+        write_keyframe_header();
+        fclose(keyframefile);
+    }
+    if(!played) {
+        return 1;
     }
 #else
+    if(keyframes || starttick || resume || queueticks || devicename || periodframes || midifile || benchname || profilefile || profileunitsfile || servername) {
+        usage();
+        return 1;
+    }
+    output_start(&output, MAX_SAMPLES);
     _4klang_render(buf);
-    fwrite(buf, sizeof(buf), 1, fp);
+    output_samples(&output, buf, MAX_SAMPLES);
+    output_finish(&output, MAX_SAMPLES);
 #endif
-    fclose(fp);
 
     fprintf(stderr,"\nDone");
-}
\ No newline at end of file
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// the symbols of 4klang.asm and what the parts of 4klangrender share: the instruments, the
+// render buffer and the signals
+#include <signal.h>
+#include "4klang.h"
+
+#ifdef _WIN32
+#define SIGUSR1 SIGABRT
+#endif
+
+#ifdef __linux
+extern void __4klang_render(void*) __attribute__ ((stdcall));
+extern int __4klang_current_tick;
+extern int __4klang_current_sample;
+extern int __4klang_sample_end;
+extern unsigned char *__4klang_synth_instructions;
+extern unsigned char *__4klang_synth_parameter_values;
+extern unsigned short _go4k_delay_times[];
+extern unsigned char *__4klang_patterns;
+extern unsigned char *__4klang_pattern_lists;
+extern unsigned int __4klang_state[];
+extern unsigned int __4klang_synth_wrk[];
+extern unsigned int __4klang_live_instruments;
+extern unsigned int *_go4k_delay_buffer_ofs;
+extern unsigned int _RandSeed;
+#define _4klang_current_tick __4klang_current_tick
+#define _4klang_current_sample __4klang_current_sample
+#define _4klang_sample_end __4klang_sample_end
+#define _4klang_render __4klang_render
+#define _4klang_synth_instructions __4klang_synth_instructions
+#define _4klang_synth_parameter_values __4klang_synth_parameter_values
+#define _4klang_patterns __4klang_patterns
+#define _4klang_pattern_lists __4klang_pattern_lists
+#define _4klang_state __4klang_state
+#define _4klang_synth_wrk __4klang_synth_wrk
+#define _4klang_live_instruments __4klang_live_instruments
+#ifdef GO4K_PROFILE
+extern unsigned long long __4klang_profile_cycles[];
+extern unsigned int __4klang_profile_calls[];
+#define _4klang_profile_cycles __4klang_profile_cycles
+#define _4klang_profile_calls __4klang_profile_calls
+#endif
+#else
+extern void _4klang_render(void*) __attribute__ ((stdcall));
+extern int _4klang_current_tick;
+extern int _4klang_current_sample;
+extern int _4klang_sample_end;
+extern unsigned char *_4klang_synth_instructions;
+extern unsigned char *_4klang_synth_parameter_values;
+extern unsigned short go4k_delay_times[];
+extern unsigned char *_4klang_patterns;
+extern unsigned char *_4klang_pattern_lists;
+extern unsigned int _4klang_state[];
+extern unsigned int _4klang_synth_wrk[];
+extern unsigned int _4klang_live_instruments;
+extern unsigned int *go4k_delay_buffer_ofs;
+extern unsigned int RandSeed;
+#ifdef GO4K_PROFILE
+extern unsigned long long _4klang_profile_cycles[];
+extern unsigned int _4klang_profile_calls[];
+#endif
+#define _go4k_delay_times go4k_delay_times
+#define _go4k_delay_buffer_ofs go4k_delay_buffer_ofs
+#define _RandSeed RandSeed
+#endif
+
+// instruments written by instrumentdisassembler -bytecode, run instead of the assembled ones
+extern const char *bytecodefile;
+
+void bytecode_size(int instruments, unsigned int *commands, unsigned int *values);
+int load_bytecode_data(unsigned char *data, long size, long count, const char *filename);
+int load_bytecode(const char *filename);
+
+#ifdef SINGLE_TICK_RENDERING
+extern volatile sig_atomic_t keep_going;
+extern volatile sig_atomic_t reload_bytecode;
+#ifdef _WIN32
+extern char buf[SAMPLES_PER_TICK * 2 * 2];
+#else
+extern float buf[SAMPLES_PER_TICK * 2];
+#endif
+
+void sig_handler(int sig);
+int start_tick(int n);
+#else
+extern float buf[MAX_SAMPLES * 2];
+#endif
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "4klangrender.h"
+#include "4klangoutput.h"
+#include "4klangkeyframes.h"
+#include "4klangqueue.h"
+#include "4klangserver.h"
+
+#ifdef SINGLE_TICK_RENDERING
+// server (-l socket): renders jobs from the clients of a Unix socket, each in a child forked from the running
+// process, so that a job pays for neither the start of a process nor the load of the song. up to -j jobs
+// render at once. a job is a line "RENDER starttick ticks bytes output" followed by bytes of bytecode
+// (instrumentdisassembler -bytecode, 0 for the instruments of the server). output - streams the raw samples
+// back on the socket, any other output is a file (WAV for a name ending in .wav) answered with "OK frames".
+// a job that fails is answered with "ERROR reason". with -k a job starts from the keyframe before its start
+// tick that matches its instruments. the jobs only read the keyframes, the renders of -k write them
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define MAX_JOB_BYTECODE (16 << 20)
+
+int server_job(int client, const char *keyframes) {
+    // the server applied a SIGHUP before the fork, one during the job reloads its instruments
+    reload_bytecode = 0;
+    FILE *request = fdopen(dup(client), "rb");
+    char line[1200], target[1024];
+    int starttick, ticks;
+    long bytes;
+    const char *error = NULL;
+    if(!request || !fgets(line, sizeof(line), request) ||
+        sscanf(line, "RENDER %d %d %ld %1023s", &starttick, &ticks, &bytes, target) != 4) {
+        error = "expected RENDER starttick ticks bytes output";
+    } else if(starttick < 0 || ticks < 1 || starttick >= MAX_TICKS || ticks > MAX_TICKS - starttick) {
+        error = "ticks out of the song";
+    } else if(bytes < 0 || bytes > MAX_JOB_BYTECODE) {
+        error = "bytecode too large";
+    } else if(bytes) {
+        // the job plays its own instruments, not the ones of a SIGHUP to the server
+        bytecodefile = NULL;
+        unsigned char *data = malloc(bytes);
+        long count = data ? (long)fread(data, 1, bytes, request) : 0;
+        if(!load_bytecode_data(data, bytes, count, "job"))
+            error = "no bytecode for the song";
+    }
+    if(request)
+        fclose(request);
+    if(!error) {
+        int stream = !strcmp(target, "-");
+        size_t length = strlen(target);
+        output.wav = !stream && length > 4 && !strcmp(target + length - 4, ".wav");
+        output.file = stream ? fdopen(dup(client), "wb") : fopen(target, "wb");
+        if(!output.file)
+            error = "unable to open the output";
+    }
+    if(error) {
+        dprintf(client, "ERROR %s\n", error);
+        return 0;
+    }
+    if(keyframes && starttick > 0) {
+        // a file position of its own, and the hashes of the instruments of the job
+        keyframefile = fopen(keyframes, "rb");
+        keyframesreadonly = 1;
+        hash_song();
+    }
+    if(starttick > 0)
+        seek(starttick % SONG_TICKS);
+    if(!render_output(starttick, starttick + ticks, 4)) {
+        dprintf(client, "ERROR unable to write the output\n");
+        return 0;
+    }
+    if(strcmp(target, "-"))
+        dprintf(client, "OK %llu\n", output.frames);
+    return 1;
+}
+
+int serve(const char *path, int workers, const char *keyframes) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    // the socket of a server before, but never a file that happens to have the name
+    struct stat status;
+    if(lstat(path, &status) == 0 && S_ISSOCK(status.st_mode))
+        unlink(path);
+    if(server < 0 || bind(server, (struct sockaddr *)&address, sizeof(address)) || listen(server, 16)) {
+        fprintf(stderr,"Unable to listen on %s\n", path);
+        return 0;
+    }
+    // drops the keyframes of other songs, the children open the file again for reading
+    if(keyframes) {
+        if(!open_keyframes(keyframes))
+            return 0;
+        fclose(keyframefile);
+        keyframefile = NULL;
+    }
+    if(workers < 1)
+        workers = (int)sysconf(_SC_NPROCESSORS_ONLN) > 0 ? (int)sysconf(_SC_NPROCESSORS_ONLN) : 1;
+    // a client that goes away fails the writes of its job, which ends it. SIGUSR1 the server
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sig_handler;
+    sigaction(SIGUSR1, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr,"Serving on %s, %d jobs at once\n", path, workers);
+    int running = 0;
+    while(keep_going) {
+        if(running == workers && wait(NULL) > 0)
+            running--;
+        while(running > 0 && waitpid(-1, NULL, WNOHANG) > 0)
+            running--;
+        int client = accept(server, NULL, NULL);
+        // a SIGHUP reloads the instruments for the jobs that follow without bytecode of their own
+        if(reload_bytecode && bytecodefile) {
+            reload_bytecode = 0;
+            load_bytecode(bytecodefile);
+        }
+        if(client < 0)
+            continue;
+        pid_t pid = fork();
+        if(pid == 0) {
+            close(server);
+            exit(server_job(client, keyframes) ? 0 : 1);
+        }
+        if(pid > 0)
+            running++;
+        close(client);
+    }
+    close(server);
+    unlink(path);
+    while(running > 0 && wait(NULL) > 0)
+        running--;
+    return 1;
+}
+#else
+int serve(const char *path, int workers, const char *keyframes) {
+    (void)path;
+    (void)workers;
+    (void)keyframes;
+    fprintf(stderr,"-l needs Unix sockets\n");
+    return 0;
+}
+#endif
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// the render jobs of the clients of a Unix socket (-l), see 4klangserver.c
+int serve(const char *path, int workers, const char *keyframes);
@@ -1,4 +1,4 @@
 node 4klang.inc.js
 ./yasm.exe -f elf32 4klang.asm
-gcc -s -O3 -m32 4klang.o 4klangrender.c -o 4klangrender
+gcc -s -O3 -m32 -pthread 4klang.o 4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c -o 4klangrender
 ./yasm.exe -f bin tiny.asm -o tiny.exe
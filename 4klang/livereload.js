@@ -1,11 +1,44 @@
 const cp = require('child_process');
 const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const crypto = require('crypto');
+
+// renderers by the hash of the sources they are built from, so that undoing an edit or
+// going back to an earlier version of the song skips yasm and gcc
+const buildcache = path.join(os.homedir(), '.cache', '4klang');
+// the sources of 4klangrender
+const renderModules = ['4klangrender', '4klangoutput', '4klangkeyframes', '4klangqueue', '4klanglive', '4klangdevice', '4klangserver'];
+const renderSources = renderModules.map(module => `${module}.c`);
+
+const buildRenderer = () => {
+    const hash = crypto.createHash('sha1');
+    ['4klang.asm', '4klang.inc', '4klang.h'].concat(renderSources, renderModules.map(module => `${module}.h`)).forEach(file =>
+        hash.update(fs.readFileSync(file))
+    );
+    const cached = path.join(buildcache, hash.digest('hex'));
+    if (!fs.existsSync(cached)) {
+        fs.mkdirSync(buildcache, { recursive: true });
+        cp.execSync('yasm -f macho 4klang.asm');
+        cp.execSync(`gcc -Wl,-no_pie -m32 -pthread 4klang.o ${renderSources.join(' ')} -o ${cached}.tmp`);
+        fs.renameSync(`${cached}.tmp`, cached);
+    }
+    // the running renderer keeps the old file
+    fs.rmSync('./4klangrender', { force: true });
+    fs.copyFileSync(cached, './4klangrender');
+};
+
+// instruments written by instrumentdisassembler -bytecode, the running renderer reloads them on SIGHUP
+const bytecode = process.argv[2];
+// a restarted renderer goes on at the tick the previous one stopped at, from the keyframes of the song
+const rendererArgs = (resume) =>
+    ['-k', '4klang.keyframes'].concat(resume ? ['-r'] : [], bytecode ? [bytecode] : []);
 
 let livereloadchild = null;
 let childfinishedpromise = null;
 
-const startChild = () => {
-    livereloadchild = cp.spawn('./4klangrender', [], {
+const startChild = (resume) => {
+    livereloadchild = cp.spawn('./4klangrender', rendererArgs(resume), {
         stdio: ['pipe', 'inherit', 'inherit','ipc']
     });
     childfinishedpromise = new Promise(resolve =>
@@ -23,12 +56,11 @@ fs.watchFile('./4klang.inc.js', async (curr, prev) => {
     const previousLiveReloadChild = livereloadchild;                                   
     try {
         cp.execSync('node 4klang.inc.js');
-        cp.execSync('yasm -f macho 4klang.asm');
-        cp.execSync('gcc -Wl,-no_pie -m32 4klang.o 4klangrender.c -o 4klangrender');
+        buildRenderer();
         previousLiveReloadChild.kill('SIGUSR1');
         await childfinishedpromise;
     
-        startChild();
+        startChild(true);
         console.error('RELOAD');
     } catch(e) {
         console.error('Failed to reload');
@@ -36,4 +68,13 @@ fs.watchFile('./4klang.inc.js', async (curr, prev) => {
     reloadinprogress = false;
 });
 
+if (bytecode) {
+    fs.watchFile(bytecode, () => {
+        if (!reloadinprogress) {
+            livereloadchild.kill('SIGHUP');
+            console.error('RELOAD INSTRUMENTS');
+        }
+    });
+}
+
 startChild();
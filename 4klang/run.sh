@@ -10,6 +10,6 @@ fi
 
 node 4klang.inc.js
 yasm -f macho 4klang.asm
-gcc -Wl,-no_pie -m32 4klang.o 4klangrender.c -o 4klangrender
+gcc -Wl,-no_pie -m32 -pthread 4klang.o 4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c -o 4klangrender
 node livereload.js | sox -S -t raw -b 32 -e float -r 44100 -c 2 - -d
-#./4klangrender | sox -S -t raw -b 32 -e float -r 44100 -c 2 - out.wav
+#./4klangrender -w -o out.wav
@@ -1,6 +1,10 @@
 node 4klang.inc.js
 yasm -f elf32 4klang.asm
-gcc -m32 4klang.o 4klangrender.c -o 4klangrender
+gcc -m32 -pthread 4klang.o 4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c -o 4klangrender
 node livereload.js | sox -S -t raw -b 32 -e float -r 44100 -c 2 - -d
-#./4klangrender | sox -S -t raw -b 32 -e float -r 44100 -c 2 - out.wav
+#./4klangrender -w -o out.wav
+# play on the sound card directly, in periods of 128 frames
+#gcc -m32 -pthread -DALSA_OUTPUT 4klang.o 4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c -lasound -o 4klangrender && ./4klangrender -d default -p 128
 
+# profile the units, then flamegraph.pl unit.folded > unit.svg
+#yasm -f elf32 -DGO4K_PROFILE 4klang.asm && gcc -m32 -pthread -DGO4K_PROFILE 4klang.o 4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c -o 4klangrender && ./4klangrender -P unit.folded -U units.txt > /dev/null
@@ -0,0 +1,50 @@
+#!/bin/bash
+# Benchmark of 4klang.asm: builds the songs and the instruments, each alone playing the same pattern
+# like nulltest.sh, and renders them with 4klangrender -B. Prints one line of JSON per song or
+# instrument: realtime factor, tick cost percentiles and the share of every instrument.
+# Needs node, yasm and gcc with 32 bit support (multilib).
+# USAGE: benchmark.sh [song.inc.js | instrument.inc ...] > benchmark.jsonl
+# without arguments it runs the songs in songs and the instruments in instruments
+set -e
+
+TOOLS=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$TOOLS/.." && pwd)
+PATTERN=${PATTERN:-60,1,1,1,1,1,1,1,0,0,0,0,67,1,0,0}
+PATTERNS=${PATTERNS:-4}
+# the sources of 4klangrender, with the headers they include
+RENDER_SOURCES="4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c"
+RENDER_HEADERS="4klangrender.h 4klangoutput.h 4klangkeyframes.h 4klangqueue.h 4klanglive.h 4klangdevice.h 4klangserver.h"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ $# -eq 0 ]
+    then
+        set -- "$ROOT"/songs/*.inc.js "$ROOT"/songs/*/4klang.inc.js "$ROOT"/instruments/*.inc
+fi
+
+for FILE in "$@"; do
+    FILE=$(cd "$(dirname "$FILE")" && pwd)/$(basename "$FILE")
+    NAME=${FILE#$ROOT/}
+    echo "$NAME" >&2
+    DIR=$WORK/build
+    rm -rf "$DIR"
+    mkdir "$DIR"
+    # songs load instruments relative to the 4klang directory, and all of them build with its 4klang.asm
+    ln -s "$ROOT/instruments" "$DIR/instruments"
+    (cd "$ROOT" && cp 4klang.asm $RENDER_SOURCES $RENDER_HEADERS "$DIR")
+    if ! (
+        cd "$DIR"
+        case "$FILE" in
+            *.inc.js) node "$FILE" ;;
+            *) NULLTEST_PATTERN=$PATTERN NULLTEST_PATTERNS=$PATTERNS node "$TOOLS/nulltest.inc.js" "$FILE" ;;
+        esac
+        yasm -f elf32 4klang.asm
+        gcc -m32 -O2 -pthread -I"$ROOT" 4klang.o $RENDER_SOURCES -o 4klangrender
+    ) > "$WORK/build.log" 2>&1
+        then
+            cat "$WORK/build.log" >&2
+            echo "{\"name\":\"$NAME\",\"error\":\"build failed\"}"
+            continue
+    fi
+    "$DIR/4klangrender" -B "$NAME" 2> /dev/null || echo "{\"name\":\"$NAME\",\"error\":\"render failed\"}"
+done
@@ -1,3 +1,5 @@
-g++ -m32 instrumentdisassembler.cpp -o instrumentdisassembler
+g++ -O2 instrumentdisassembler.cpp instrumentloader.cpp instrumentoptimizer.cpp instrumentcost.cpp instrumentlibrary.cpp -pthread -o instrumentdisassembler
+g++ -O3 go4krender.cpp go4kengine.cpp instrumentloader.cpp instrumentoptimizer.cpp instrumentcost.cpp instrumentlibrary.cpp -ldl -pthread -o go4krender
 ./instrumentdisassembler BA_DarkChorus.4ki
-#./instrumentdisassembler pOWL_BAS_Dubstep07.4ki
\ No newline at end of file
+#./instrumentdisassembler pOWL_BAS_Dubstep07.4ki
+#./instrumentdisassembler -cpp BA_DarkChorus.4ki > instruments.cpp
@@ -0,0 +1,31 @@
+#pragma once
+
+/////////////////////////////////////////////////////////////////////////////////////
+// go4k bytecode
+//
+// the command and parameter streams of 4klang.inc (go4k_synth_instructions and
+// go4k_synth_parameter_values) as instrumentdisassembler -bytecode writes them, with the
+// delay times they index. 4klangrender loads them in place of the assembled ones, at start
+// and on SIGHUP, so that changed instruments play without yasm and gcc. the unit bytes
+// are laid out like the GO4K_ macros of 4klang_inc.make.js with MAX_VOICES 1.
+//
+// file layout, little endian: the header, the commands, the values, the delay times (words)
+/////////////////////////////////////////////////////////////////////////////////////
+
+#define GO4K_BYTECODE_MAGIC		"4kbc"
+#define GO4K_BYTECODE_VERSION	1
+// delay lines of the fixed delay buffer of 4klang.asm
+#define GO4K_BYTECODE_DELAY_LINES	(16*16)
+// the command of FST units storing to another instrument, the others are the unit ids
+#define GO4K_BYTECODE_FSTG		13
+
+typedef struct Go4kBytecodeHeader
+{
+	char			magic[4];
+	unsigned short	version;
+	unsigned short	instruments;	// command streams before the one of the global chain
+	unsigned short	delaylines;		// DLL and GLITCH lines used per sample
+	unsigned short	delaytimes;
+	unsigned int	commands;		// bytes of the command streams, each ended by 0
+	unsigned int	values;			// bytes of the parameters
+} Go4kBytecodeHeader;
@@ -0,0 +1,1294 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "./go4kkernels.h"
+
+// the global chain 4klang_inc.make.js generates for every song, see Go4kDefaultDelayTimes for the delay times
+static const BYTE DefaultGlobalUnits[][MAX_UNIT_SLOTS] =
+{
+	{ M_ACC, ACC_AUX },
+	{ M_DLL, 55, 70, 100, 64, 0, 0, 0, 8 },
+	{ M_FOP, FOP_XCH },
+	{ M_DLL, 55, 70, 100, 64, 0, 0, 8, 8 },
+	{ M_FOP, FOP_XCH },
+	{ M_ACC, ACC_OUT },
+	{ M_FOP, FOP_ADDP2 },
+	{ M_OUT, 128, 0 },
+};
+
+/////////////////////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////////////////////
+
+static bool IsEmptyInstrument(const BYTE (*units)[MAX_UNIT_SLOTS])
+{
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		if (units[u][0] != M_NONE)
+			return false;
+	}
+	return true;
+}
+
+// number of delay lines the DLL and GLITCH units of a unit chain use per sample
+static int CountDelayLines(const BYTE (*units)[MAX_UNIT_SLOTS])
+{
+	int lines = 0;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		// the kernels run one line for a count of 0
+		if (units[u][0] == M_DLL)
+			lines += ((DLL_valP)units[u])->count ? ((DLL_valP)units[u])->count : 1;
+		if (units[u][0] == M_GLITCH)
+			lines++;
+	}
+	return lines;
+}
+
+// lengths of the delay lines of a unit chain in processing order, returns the number of lines.
+// a line holds the longest delay time it can run with, the note sync period of the lowest note
+// for the first delay time and MAX_DELAY for empty times, which wrap at the end of the line.
+static int DelayLineLengths(Go4kEngineP engine, const BYTE (*units)[MAX_UNIT_SLOTS], DWORD *lengths)
+{
+	int lines = 0;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		if (units[u][0] == M_GLITCH)
+			lengths[lines++] = MAX_DELAY;
+		if (units[u][0] != M_DLL)
+			continue;
+		DLL_valP v = (DLL_valP)units[u];
+		for (int k = 0; k < v->count || k == 0; k++)
+		{
+			int delayindex = (v->delay + k) & (MAX_DELAY_TIMES - 1);
+			DWORD length = delayindex ? engine->delay_times[delayindex] : (DWORD)lrint(1 / (double)FREQ_NORMALIZE);
+			lengths[lines++] = length ? length : MAX_DELAY;
+		}
+	}
+	return lines;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// lanes
+//
+// the voices of a lane group run the unit chain of its first instrument together. the
+// workspaces are transposed to workspace[slot][lane], and the value stack to stack[depth][lane],
+// so that every unit processes all lanes in one loop. lanes are in the order the scalar engine
+// processes the voices, which keeps the delay lines and the noise sequence of every voice.
+// padding lanes have no voice and note 0, they are computed along but never stored.
+/////////////////////////////////////////////////////////////////////////////////////
+
+#define FOR_LANES(l)	for (int l = 0; l < GO4K_LANES; l++)
+
+typedef float LaneSlots[GO4K_LANES];
+
+typedef struct Go4kLaneGroup
+{
+	int		instrument;					// first instrument, all of them have its unit chain
+	int		lanes;						// voices of the group, polyphony per instrument
+	int		first;						// first unit, its envelope ends the note
+	int		delaylines;					// delay lines of one voice
+	int		noiseunits;					// noise oscillations of one voice per sample
+	InstrumentWorkspaceP voice[GO4K_LANES];
+	LaneSlots workspace[MAX_UNITS*MAX_UNIT_SLOTS];
+	// copied from the voices every sample
+	DWORD	note[GO4K_LANES];
+	DWORD	release[GO4K_LANES];
+	DWORD	seed[GO4K_LANES];
+	int		delaycursor[GO4K_LANES];
+	double	stack[64][GO4K_LANES];
+	int		sp;
+} *Go4kLaneGroupP;
+
+static inline double *LanePush(Go4kLaneGroupP group)
+{
+	return group->stack[group->sp++];
+}
+
+static inline double *LaneTop(Go4kLaneGroupP group, int depth = 0)
+{
+	return group->stack[group->sp - 1 - depth];
+}
+
+// multiplier of the noise seed for the given number of noise oscillations
+static DWORD NoiseAdvance(DWORD count)
+{
+	DWORD factor = 1;
+	DWORD base = 16007;
+	for (; count; count >>= 1, base *= base)
+	{
+		if (count & 1)
+			factor *= base;
+	}
+	return factor;
+}
+
+// stack depth the unit needs, and its change of the depth. returns false if the unit can't run
+// in lanes: it accesses other voices, or its stack use depends on the voice.
+static bool LaneStackEffect(const BYTE *unit, int instrument, int &needs, int &change)
+{
+	needs = 0;
+	change = 0;
+	switch (unit[0])
+	{
+	case M_NONE:
+		return true;
+	case M_ENV:
+	case M_FLD:
+		change = 1;
+		return true;
+	case M_VCO:
+		change = unit[8] & VCO_STEREO ? 2 : 1;
+		// without waveform the phase is pushed as well, but not for a voice without note
+		return (unit[8] & (VCO_SINE | VCO_TRISAW | VCO_PULSE | VCO_GATE | VCO_NOISE)) != 0;
+	case M_VCF:
+	case M_DST:
+		needs = unit[3] & VCF_STEREO ? 2 : 1;
+		return true;
+	case M_DLL:
+		needs = 1;
+		return true;
+	case M_PAN:
+		needs = 1;
+		change = 1;
+		return true;
+	case M_OUT:
+		needs = 2;
+		change = -2;
+		return true;
+	case M_FST:
+	{
+		FST_valP v = (FST_valP)unit;
+		needs = 1;
+		change = v->type & FST_POP ? -1 : 0;
+		return v->dest_stack == -1 || v->dest_stack == instrument;
+	}
+	case M_FOP:
+		switch (unit[1])
+		{
+		case FOP_POP:		needs = 1; change = -1; break;
+		case FOP_ADDP:
+		case FOP_MULP:		needs = 2; change = -1; break;
+		case FOP_PUSH:		needs = 1; change = 1; break;
+		case FOP_XCH:
+		case FOP_ADD:
+		case FOP_MUL:		needs = 2; break;
+		case FOP_ADDP2:
+		case FOP_MULP2:		needs = 4; change = -2; break;
+		case FOP_LOADNOTE:	change = 1; break;
+		}
+		return true;
+	}
+	return false;
+}
+
+// a chain runs in lanes if all of its units can, and it never reads below the bottom of the
+// stack or pushes beyond the top, where the scalar engine would read zeros or drop values
+static bool IsLaneChain(const BYTE (*units)[MAX_UNIT_SLOTS], int instrument)
+{
+	int depth = 0;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		int needs, change;
+		if (!LaneStackEffect(units[u], instrument, needs, change) || depth < needs)
+			return false;
+		depth += change;
+		if (depth > 64 - STACK_GUARD)
+			return false;
+
+		// an envelope only leaves its states through release, unless something stores to its state
+		FST_valP v = (FST_valP)units[u];
+		if (v->id == M_FST && v->dest_unit >= 0 && v->dest_unit < MAX_UNITS && v->dest_slot == ENV_WRK_STATE
+			&& units[(int)v->dest_unit][0] == M_ENV)
+			return false;
+	}
+	return true;
+}
+
+static int CountNoiseUnits(const BYTE (*units)[MAX_UNIT_SLOTS])
+{
+	int count = 0;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		if (units[u][0] == M_VCO && (units[u][8] & VCO_NOISE) && !(units[u][8] & (VCO_SINE | VCO_TRISAW | VCO_PULSE | VCO_GATE)))
+			count += units[u][8] & VCO_STEREO ? 2 : 1;
+	}
+	return count;
+}
+
+static void ClearLane(Go4kEngineP engine, int instrument, int voice)
+{
+	if (engine->lanegroupof[instrument] < 0)
+		return;
+	Go4kLaneGroupP group = &engine->lanegroups[engine->lanegroupof[instrument]];
+	int lane = (instrument - group->instrument) * engine->polyphony + voice;
+	for (int s = 0; s < MAX_UNITS * MAX_UNIT_SLOTS; s++)
+		group->workspace[s][lane] = 0;
+}
+
+static void LanesENV(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[5];
+	Transform(unit, 5, v);
+	double *out = LanePush(group);
+	FOR_LANES(l)
+	{
+		if (group->note[l] == 0)
+		{
+			out[l] = 0;
+			continue;
+		}
+		if (group->release[l])
+			SetDword(&wrk[ENV_WRK_STATE][l], ENV_STATE_RELEASE);
+
+		// lane chains have no state beyond release here, see IsLaneChain
+		BYTE state = (BYTE)GetDword(&wrk[ENV_WRK_STATE][l]);
+		double level = wrk[ENV_WRK_LEVEL][l];
+		if (state < ENV_STATE_OFF && state != ENV_STATE_SUSTAIN)
+		{
+			double step = Power(-((v[state] + wrk[ENV_WRK_AM + state][l]) * 24.0));
+			bool statechange = false;
+			if (state == ENV_STATE_ATTAC)
+			{
+				level += step;
+				if (level >= 1)
+				{
+					level = 1;
+					statechange = true;
+				}
+			}
+			else if (state == ENV_STATE_DECAY)
+			{
+				level -= step;
+				if (v[2] >= level)
+				{
+					level = v[2];
+					statechange = true;
+				}
+			}
+			else
+			{
+				level -= step;
+				if (level <= 0)
+				{
+					level = 0;
+					statechange = true;
+				}
+			}
+			if (statechange)
+				SetDword(&wrk[ENV_WRK_STATE][l], GetDword(&wrk[ENV_WRK_STATE][l]) + 1);
+			wrk[ENV_WRK_LEVEL][l] = (float)level;
+		}
+		out[l] = level * (v[4] + wrk[ENV_WRK_GM][l]);
+	}
+}
+
+// one oscillation of a lane, the same as the loop body of Go4kVCO
+static double VCOLane(Go4kLaneGroupP group, const BYTE *unit, const float *v, BYTE flags, LaneSlots *wrk, int l)
+{
+	double detune = (v[1] - 0.5) * 2;
+	if (flags & VCO_STEREO)
+		detune = -detune;
+	double x = (v[0] - 0.5 + wrk[VCO_WRK_TM][l]) / c_i128 + detune + wrk[VCO_WRK_DM][l];
+	if (!(flags & VCO_LFO))
+		x += group->note[l];
+	double freq = Power(x * c_i12) * ((flags & VCO_LFO) ? DEF_LFO_NORMALIZE : FREQ_NORMALIZE);
+
+	double phase = fmod(freq + wrk[VCO_WRK_PHASE][l] + wrk[VCO_WRK_FM][l] + 1, 1);
+	wrk[VCO_WRK_PHASE][l] = (float)phase;
+	double p = fmod(phase + wrk[VCO_WRK_PM][l] + v[2] + 1, 1);
+	double c = v[4] + wrk[VCO_WRK_CM][l];
+
+	double out;
+	if (flags & VCO_SINE)
+		out = c >= p ? sin(2 * M_PI * (p / c)) : 0;
+	else if (flags & VCO_TRISAW)
+		out = (c >= p ? p / c : (1 - p) / (1 - c)) * 2 - 1;
+	else if (flags & VCO_PULSE)
+		out = c >= p ? 1 : -1;
+	else if (flags & VCO_GATE)
+	{
+		WORD gatebits = unit[4] | (unit[5] << 8);
+		out = (gatebits >> (RoundToInt(p * 16) & 15)) & 1 ? 1 : 0;
+		out = out + (wrk[VCO_WRK_CM][l] - out) * c_dc_const;
+		wrk[VCO_WRK_CM][l] = (float)out;
+	}
+	else
+	{
+		group->seed[l] *= 16007;
+		out = (int)group->seed[l] / 2147483648.0;
+	}
+	out = Waveshaper(out, v[5] + wrk[VCO_WRK_SM][l]);
+	return out * (v[6] + wrk[VCO_WRK_GM][l]);
+}
+
+static void LanesVCO(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[8];
+	Transform(unit, 8, v);
+	BYTE flags = unit[8];
+	double *out2 = flags & VCO_STEREO ? LanePush(group) : NULL;
+	double *out = LanePush(group);
+	FOR_LANES(l)
+	{
+		if (group->note[l] == 0)
+		{
+			if (out2)
+				out2[l] = 0;
+			out[l] = 0;
+			continue;
+		}
+		// a stereo vco runs twice, the first time with the second phase and negated detune
+		if (out2)
+		{
+			float phase = wrk[VCO_WRK_PHASE][l];
+			wrk[VCO_WRK_PHASE][l] = wrk[VCO_WRK_PHASE2][l];
+			wrk[VCO_WRK_PHASE2][l] = phase;
+			out2[l] = VCOLane(group, unit, v, flags, wrk, l);
+			phase = wrk[VCO_WRK_PHASE][l];
+			wrk[VCO_WRK_PHASE][l] = wrk[VCO_WRK_PHASE2][l];
+			wrk[VCO_WRK_PHASE2][l] = phase;
+		}
+		out[l] = VCOLane(group, unit, v, flags & ~VCO_STEREO, wrk, l);
+	}
+}
+
+static void LanesVCF(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[3];
+	Transform(unit, 3, v);
+	BYTE type = unit[3];
+	int channels = type & VCF_STEREO ? 2 : 1;
+	for (int c = channels - 1; c >= 0; c--)
+	{
+		double *top = LaneTop(group, c);
+		LaneSlots *state = c ? wrk + VCF_WRK_LOW2 : wrk;
+		FOR_LANES(l)
+		{
+			float res = v[1] + wrk[VCF_WRK_RM][l];
+			double f = v[0] + wrk[VCF_WRK_FM][l];
+			float freq = (float)(f * f);
+
+			float low = freq * state[VCF_WRK_BAND][l] + state[VCF_WRK_LOW][l];
+			double high = (top[l] - low) - res * state[VCF_WRK_BAND][l];
+			float band = (float)(high * freq + state[VCF_WRK_BAND][l]);
+			double out = 0;
+			if (type & VCF_LOWPASS)
+				out += low;
+			if (type & VCF_HIGHPASS)
+				out += (float)high;
+			if (type & VCF_BANDPASS)
+				out += band;
+			if (type & VCF_PEAK)
+			{
+				out += low;
+				out -= (float)high;
+			}
+
+			// a voice without note keeps its filter state and input
+			bool active = group->note[l] != 0;
+			state[VCF_WRK_LOW][l] = active ? low : state[VCF_WRK_LOW][l];
+			state[VCF_WRK_HIGH][l] = active ? (float)high : state[VCF_WRK_HIGH][l];
+			state[VCF_WRK_BAND][l] = active ? band : state[VCF_WRK_BAND][l];
+			top[l] = active ? out : top[l];
+		}
+	}
+}
+
+static void LanesDST(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[3];
+	Transform(unit, 3, v);
+	bool stereo = (unit[3] & VCF_STEREO) != 0;
+	double *top = LaneTop(group);
+	double *top1 = stereo ? LaneTop(group, 1) : NULL;
+	FOR_LANES(l)
+	{
+		if (group->note[l] == 0)
+			continue;
+		double snh = v[1] + wrk[DST_WRK_SM][l];
+		snh = wrk[DST_WRK_SNHPHASE][l] - snh * snh;
+		wrk[DST_WRK_SNHPHASE][l] = (float)snh;
+		if (0 < snh)
+		{
+			if (stereo)
+				top1[l] = wrk[DST_WRK_OUT2][l];
+			top[l] = wrk[DST_WRK_OUT][l];
+			continue;
+		}
+		wrk[DST_WRK_SNHPHASE][l] = 1 + (float)snh;
+		if (stereo)
+		{
+			top1[l] = Waveshaper(top1[l], v[0] + wrk[DST_WRK_DM][l]);
+			wrk[DST_WRK_OUT2][l] = (float)top1[l];
+		}
+		top[l] = Waveshaper(top[l], v[0] + wrk[DST_WRK_DM][l]);
+		wrk[DST_WRK_OUT][l] = (float)top[l];
+	}
+}
+
+// the delay lines are shared by all voices, so every lane runs on its own
+static void LanesDLL(Go4kEngineP engine, Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[8];
+	Transform(unit, 8, v);
+	double *top = LaneTop(group);
+	for (int l = 0; l < group->lanes; l++)
+	{
+		int delayindex = unit[7];
+		int count = unit[8];
+		if (delayindex == 0)
+		{
+			long period = lrint(1 / (Power(group->note[l] * c_i12) * FREQ_NORMALIZE));
+			engine->delay_times[0] = (WORD)(period < -32768 || period > 32767 ? 0x8000 : period);
+		}
+
+		double in = top[l];
+		double out = in * (v[1] + wrk[DLL_WRK2_IM][l]);
+		double pregain = v[0] + wrk[DLL_WRK2_PM][l];
+		in = in * (pregain * pregain);
+
+		float *line = engine->delaybuffer + engine->delayoffsets[group->delaycursor[l]];
+		DWORD length;
+		double freq = v[4] + wrk[DLL_WRK2_SM][l];
+		freq = freq * freq;
+		freq = freq * freq;
+		double phase = fmod(freq / DLL_DEPTH + line[DELAY_WRK_PHASE] + 1, 1);
+		line[DELAY_WRK_PHASE] = (float)phase;
+		double depth = v[5] + wrk[DLL_WRK2_AM][l];
+		depth = depth * depth;
+		depth = depth * depth;
+		int offset = RoundToInt((1 + sin(2 * M_PI * phase)) * (depth * DLL_DEPTH));
+
+		float damp = v[3] + wrk[DLL_WRK2_DM][l];
+		float feedback = v[2] + wrk[DLL_WRK2_FM][l];
+		do
+		{
+			line = engine->delaybuffer + engine->delayoffsets[group->delaycursor[l]];
+			length = GetDword(&line[DELAY_WRK_LENGTH]);
+			int size = engine->delay_times[delayindex & (MAX_DELAY_TIMES - 1)];
+			int index = (int)GetDword(&line[DELAY_WRK_INDEX]);
+			int readindex = index + offset;
+			if (readindex >= size)
+				readindex -= size;
+			double cout = DelayRead(line, readindex);
+			out += cout;
+
+			double store = cout * ((1 - v[3]) - wrk[DLL_WRK2_DM][l]) + damp * line[DELAY_WRK_STORE];
+			line[DELAY_WRK_STORE] = (float)store;
+			line[DELAY_WRK_BUFFER + index] = (float)(store * feedback + in);
+
+			index++;
+			if (index >= size)
+				index -= size;
+			if ((unsigned)index >= length)
+				index = 0;
+			SetDword(&line[DELAY_WRK_INDEX], index);
+
+			delayindex++;
+			group->delaycursor[l]++;
+		} while (--count > 0);
+
+		double dc = line[DELAY_WRK_DCOUT] * c_dc_const - line[DELAY_WRK_DCIN];
+		line[DELAY_WRK_DCIN] = (float)out;
+		out = out + dc;
+		out = (out + 0.5) - 0.5;
+		line[DELAY_WRK_DCOUT] = (float)out;
+		top[l] = out;
+	}
+}
+
+static void LanesFOP(Go4kLaneGroupP group, const BYTE *unit)
+{
+	double *t0 = LaneTop(group);
+	double *t1 = group->sp > 1 ? LaneTop(group, 1) : NULL;
+	double *t2 = group->sp > 2 ? LaneTop(group, 2) : NULL;
+	double *t3 = group->sp > 3 ? LaneTop(group, 3) : NULL;
+	double a;
+	switch (unit[1])
+	{
+	case FOP_POP:
+		group->sp--;
+		break;
+	case FOP_ADDP:
+		FOR_LANES(l) t1[l] += t0[l];
+		group->sp--;
+		break;
+	case FOP_MULP:
+		FOR_LANES(l) t1[l] *= t0[l];
+		group->sp--;
+		break;
+	case FOP_PUSH:
+		t1 = LanePush(group);
+		FOR_LANES(l) t1[l] = t0[l];
+		break;
+	case FOP_XCH:
+		FOR_LANES(l)
+		{
+			a = t0[l];
+			t0[l] = t1[l];
+			t1[l] = a;
+		}
+		break;
+	case FOP_ADD:
+		FOR_LANES(l) t0[l] += t1[l];
+		break;
+	case FOP_MUL:
+		FOR_LANES(l) t0[l] *= t1[l];
+		break;
+	case FOP_ADDP2:
+		FOR_LANES(l)
+		{
+			t2[l] += t0[l];
+			t3[l] += t1[l];
+		}
+		group->sp -= 2;
+		break;
+	case FOP_LOADNOTE:
+		t1 = LanePush(group);
+		FOR_LANES(l) t1[l] = group->note[l] * c_i128;
+		break;
+	case FOP_MULP2:
+		FOR_LANES(l)
+		{
+			t2[l] *= t0[l];
+			t3[l] *= t1[l];
+		}
+		group->sp -= 2;
+		break;
+	}
+}
+
+static void LanesFST(Go4kLaneGroupP group, const BYTE *unit)
+{
+	FST_valP v = (FST_valP)unit;
+	int slot = v->dest_unit * MAX_UNIT_SLOTS + v->dest_slot;
+	double *top = LaneTop(group);
+	if (v->dest_unit >= 0 && slot < MAX_UNITS * MAX_UNIT_SLOTS)
+	{
+		float *dest = group->workspace[slot];
+		double amount = (v->amount * c_i128 - 0.5) * 2;
+		FOR_LANES(l)
+		{
+			double value = amount * top[l];
+			if (v->type & FST_ADD)
+				value += dest[l];
+			dest[l] = (float)value;
+		}
+	}
+	if (v->type & FST_POP)
+		group->sp--;
+}
+
+static void LanesPAN(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[1];
+	Transform(unit, 1, v);
+	double *in = LaneTop(group);
+	double *l = LanePush(group);
+	FOR_LANES(n)
+	{
+		double r = in[n] * (v[0] + wrk[PAN_WRK_PM][n]);
+		l[n] = in[n] - r;
+		in[n] = r;
+	}
+}
+
+static void LanesOUT(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[2];
+	Transform(unit, 2, v);
+	double *l = LaneTop(group);
+	double *r = LaneTop(group, 1);
+	group->sp -= 2;
+	for (int n = 0; n < group->lanes; n++)
+	{
+		InstrumentWorkspaceP voice = group->voice[n];
+		double aux = v[1] + wrk[OUT_WRK_AM][n];
+		double gain = v[0] + wrk[OUT_WRK_GM][n];
+		voice->dlloutl = (float)(l[n] * aux);
+		voice->dlloutr = (float)(r[n] * aux);
+		voice->outl = (float)(l[n] * gain);
+		voice->outr = (float)(r[n] * gain);
+	}
+}
+
+static void LanesFLD(Go4kLaneGroupP group, const BYTE *unit, LaneSlots *wrk)
+{
+	float v[1];
+	Transform(unit, 1, v);
+	double *out = LanePush(group);
+	FOR_LANES(l) out[l] = (v[0] - 0.5) * 2 + wrk[FLD_WRK_VM][l];
+}
+
+// runs one sample of a lane group, at the position of its first instrument
+static void ProcessLanes(Go4kEngineP engine, Go4kLaneGroupP group)
+{
+	// the noise seed advances per oscillation of a voice with note, in processing order
+	DWORD seed = (DWORD)engine->randseed;
+	DWORD noise = 0;
+	FOR_LANES(l)
+	{
+		InstrumentWorkspaceP voice = group->voice[l];
+		group->note[l] = voice ? voice->note : 0;
+		group->release[l] = voice ? voice->release : 0;
+		group->delaycursor[l] = engine->delaycursor + l * group->delaylines;
+		group->seed[l] = seed * NoiseAdvance(noise);
+		if (group->note[l])
+			noise += group->noiseunits;
+	}
+	engine->delaycursor += group->lanes * group->delaylines;
+	engine->randseed = (int)(seed * NoiseAdvance(noise));
+
+	const BYTE (*units)[MAX_UNIT_SLOTS] = engine->synth->InstrumentValues[group->instrument];
+	group->sp = 0;
+	for (int u = group->first; u < MAX_UNITS; u++)
+	{
+		const BYTE *unit = units[u];
+		LaneSlots *wrk = &group->workspace[u * MAX_UNIT_SLOTS];
+		switch (unit[0])
+		{
+		case M_ENV:
+			LanesENV(group, unit, wrk);
+			break;
+		case M_VCO:
+			LanesVCO(group, unit, wrk);
+			break;
+		case M_VCF:
+			LanesVCF(group, unit, wrk);
+			break;
+		case M_DST:
+			LanesDST(group, unit, wrk);
+			break;
+		case M_DLL:
+			LanesDLL(engine, group, unit, wrk);
+			break;
+		case M_FOP:
+			LanesFOP(group, unit);
+			break;
+		case M_FST:
+			LanesFST(group, unit);
+			break;
+		case M_PAN:
+			LanesPAN(group, unit, wrk);
+			break;
+		case M_OUT:
+			LanesOUT(group, unit, wrk);
+			break;
+		case M_FLD:
+			LanesFLD(group, unit, wrk);
+			break;
+		}
+	}
+
+	// kill the note once the envelope of the first unit is done
+	LaneSlots &state = group->workspace[group->first * MAX_UNIT_SLOTS + ENV_WRK_STATE];
+	for (int l = 0; l < group->lanes; l++)
+	{
+		if ((BYTE)GetDword(&state[l]) == ENV_STATE_OFF)
+			group->voice[l]->note = 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// voices
+/////////////////////////////////////////////////////////////////////////////////////
+
+// go4k_VM_process: runs the unit chain of an instrument (or the global chain, instrument
+// MAX_INSTRUMENTS) on one voice. units and workspace slots are not compacted as in the
+// asm, so FST destinations address the unit indices of the instrument directly.
+static void ProcessVoice(Go4kEngineP engine, const BYTE (*units)[MAX_UNIT_SLOTS], InstrumentWorkspaceP voice, int instrument)
+{
+	engine->sp = STACK_GUARD;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		const BYTE *unit = units[u];
+		float *wrk = &voice->workspace[u * MAX_UNIT_SLOTS];
+		switch (unit[0])
+		{
+		case M_ENV:
+			Go4kENV(engine, unit, wrk, voice);
+			break;
+		case M_VCO:
+			Go4kVCO(engine, unit, wrk, voice);
+			break;
+		case M_VCF:
+			Go4kVCF(engine, unit, wrk, voice);
+			break;
+		case M_DST:
+			Go4kDST(engine, unit, wrk, voice);
+			break;
+		case M_DLL:
+			Go4kDLL(engine, unit, wrk, voice);
+			break;
+		case M_FOP:
+			Go4kFOP(engine, unit, voice);
+			break;
+		case M_FST:
+		{
+			FST_valP v = (FST_valP)unit;
+			int slot = v->dest_unit * MAX_UNIT_SLOTS + v->dest_slot;
+			if (v->dest_stack != -1 && v->dest_stack != instrument)
+				Go4kFSTG(engine, unit, voice);
+			else
+				Go4kFST(engine, unit, v->dest_unit >= 0 && slot < MAX_UNITS * MAX_UNIT_SLOTS ? &voice->workspace[slot] : NULL);
+			break;
+		}
+		case M_PAN:
+			Go4kPAN(engine, unit, wrk);
+			break;
+		case M_OUT:
+			Go4kOUT(engine, unit, wrk, voice);
+			break;
+		case M_ACC:
+			Go4kACC(engine, unit);
+			break;
+		case M_FLD:
+			Go4kFLD(engine, unit, wrk);
+			break;
+		case M_GLITCH:
+			Go4kGLITCH(engine, unit, wrk);
+			break;
+		}
+	}
+}
+
+// go4kUpdateInstrument: releases the voices of an instrument, and starts a new note on the next voice
+static void UpdateInstrument(Go4kEngineP engine, int instrument, BYTE note)
+{
+	SynthObjectP synth = engine->synth;
+	if (note == HLD)
+		return;
+	InstrumentWorkspaceP voices = &synth->InstrumentWork[instrument * MAX_POLYPHONY];
+	for (int i = 0; i < engine->polyphony; i++)
+		voices[i].release++;
+	if (note < HLD)
+		return;
+
+	int voice = 0;
+	if (engine->polyphony > 1)
+	{
+		voice = synth->VoiceIndex[instrument] ? 1 : 0;
+		synth->VoiceIndex[instrument] = voice ^ 1;
+	}
+	memset(&voices[voice], 0, offsetof(InstrumentWorkspace, dlloutl));
+	voices[voice].note = note;
+	ClearLane(engine, instrument, voice);
+}
+
+// runs the voices of an instrument for one sample, or its lane group at the first instrument of the group
+static void ProcessInstrument(Go4kEngineP engine, int i)
+{
+	SynthObjectP synth = engine->synth;
+	if (engine->lanegroupof[i] >= 0)
+	{
+		// the whole group runs at its first instrument, after the notes of all of them
+		Go4kLaneGroupP group = &engine->lanegroups[engine->lanegroupof[i]];
+		if (group->instrument != i)
+			return;
+		for (int j = i; engine->tickpending && j < MAX_INSTRUMENTS; j++)
+		{
+			if (engine->lanegroupof[j] == engine->lanegroupof[i])
+				UpdateInstrument(engine, j, engine->ticknotes[j]);
+		}
+		ProcessLanes(engine, group);
+		return;
+	}
+	if (engine->tickpending)
+		UpdateInstrument(engine, i, engine->ticknotes[i]);
+
+	const BYTE (*units)[MAX_UNIT_SLOTS] = synth->InstrumentValues[i];
+	int first = 0;
+	while (first < MAX_UNITS && units[first][0] == M_NONE)
+		first++;
+	if (first == MAX_UNITS)
+		return;
+
+	for (int j = 0; j < engine->polyphony; j++)
+	{
+		InstrumentWorkspaceP voice = &synth->InstrumentWork[i * MAX_POLYPHONY + j];
+		if (engine->compiled[i])
+			engine->compiled[i](engine, voice);
+		else
+			ProcessVoice(engine, units, voice, i);
+		// kill the note once the envelope of the first unit is done
+		if ((BYTE)GetDword(&voice->workspace[first * MAX_UNIT_SLOTS + ENV_WRK_STATE]) == ENV_STATE_OFF)
+			voice->note = 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// stems
+//
+// a task renders its instruments for all samples of a Go4kEngine_Render call on a copy of the
+// engine, with its own value stack and delay times, starting every instrument at its own delay
+// lines. the calling thread then runs the other instruments and the global chain sample by sample,
+// with the outputs the tasks recorded. tasks only share the noise sequence through the global
+// chain, which draws the same number of noise samples every sample.
+/////////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Go4kStemFrame
+{
+	float	out[MAX_POLYPHONY][4];		// dlloutl, dlloutr, outl and outr of the voices
+	DWORD	randseed;					// the noise seed after the instrument
+} *Go4kStemFrameP;
+
+static int FindTask(int *tasks, int i)
+{
+	while (tasks[i] != i)
+		i = tasks[i] = tasks[tasks[i]];
+	return i;
+}
+
+static void JoinTasks(int *tasks, int a, int b)
+{
+	tasks[FindTask(tasks, a)] = FindTask(tasks, b);
+}
+
+// whether a chain sets the note sync delay time, or reads it without setting it first
+static void NoteSyncUse(const BYTE (*units)[MAX_UNIT_SLOTS], bool &sets, bool &reads)
+{
+	sets = reads = false;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		const BYTE *unit = units[u];
+		if (unit[0] == M_DLL && unit[7] == 0)
+			sets = true;
+		else if (unit[0] == M_DLL && unit[7] + unit[8] > MAX_DELAY_TIMES)
+			reads = true;
+		else if (unit[0] == M_GLITCH && unit[5] == 0)
+			reads = true;
+	}
+}
+
+static void RenderStemTask(Go4kEngineP engine, int task, int samples)
+{
+	Go4kEngine worker = *engine;
+	SynthObjectP synth = engine->synth;
+	DWORD globalnoise = NoiseAdvance(CountNoiseUnits(synth->GlobalValues));
+	for (int s = 0; s < samples; s++)
+	{
+		Go4kStemFrameP frames = &engine->stemframes[(size_t)s * MAX_INSTRUMENTS];
+		for (int i = 0; i < MAX_INSTRUMENTS; i++)
+		{
+			if (engine->stemtaskof[i] != task)
+				continue;
+			worker.delaycursor = engine->stemcursor[i];
+			ProcessInstrument(&worker, i);
+			frames[i].randseed = (DWORD)worker.randseed;
+		}
+		worker.tickpending = 0;
+		worker.randseed = (int)((DWORD)worker.randseed * globalnoise);
+		// a lane group leaves the outputs of all its voices at its first instrument
+		for (int i = 0; i < MAX_INSTRUMENTS; i++)
+		{
+			if (engine->stemtaskof[i] != task)
+				continue;
+			for (int j = 0; j < engine->polyphony; j++)
+				memcpy(frames[i].out[j], &synth->InstrumentWork[i * MAX_POLYPHONY + j].dlloutl, sizeof(frames[i].out[j]));
+		}
+	}
+}
+
+// the worker threads of the stems, started by Go4kEngine_PlanStems and joined by Go4kEngine_Free.
+// every Go4kEngine_Render starts a round, in which the workers and the calling thread take the tasks
+// in turn, and waits until all workers are done with it
+typedef struct Go4kStemPool
+{
+	std::vector<std::thread> threads;
+	std::mutex lock;
+	std::condition_variable start;
+	std::condition_variable finish;
+	unsigned int round = 0;
+	int running = 0;					// workers still in the round
+	bool stopping = false;
+	int samples = 0;
+	std::atomic<int> next { 0 };
+} *Go4kStemPoolP;
+
+static void RunStemTasks(Go4kEngineP engine, Go4kStemPoolP pool)
+{
+	for (int task = pool->next++; task < engine->stemtasks; task = pool->next++)
+		RenderStemTask(engine, task, pool->samples);
+}
+
+static void StemWorker(Go4kEngineP engine, Go4kStemPoolP pool)
+{
+	unsigned int round = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(pool->lock);
+			pool->start.wait(lock, [&]() { return pool->stopping || pool->round != round; });
+			if (pool->stopping)
+				return;
+			round = pool->round;
+		}
+		RunStemTasks(engine, pool);
+		std::lock_guard<std::mutex> lock(pool->lock);
+		if (--pool->running == 0)
+			pool->finish.notify_one();
+	}
+}
+
+static void StopStemPool(Go4kEngineP engine)
+{
+	Go4kStemPoolP pool = engine->stempool;
+	if (pool == NULL)
+		return;
+	{
+		std::lock_guard<std::mutex> lock(pool->lock);
+		pool->stopping = true;
+	}
+	pool->start.notify_all();
+	for (size_t t = 0; t < pool->threads.size(); t++)
+		pool->threads[t].join();
+	delete pool;
+	engine->stempool = NULL;
+}
+
+// runs the tasks on the worker threads, returns false if there are none or no memory for their outputs
+static bool RenderStemTasks(Go4kEngineP engine, int samples)
+{
+	if (engine->stemtasks == 0)
+		return false;
+	if (samples > engine->stemsamples)
+	{
+		free(engine->stemframes);
+		engine->stemframes = (Go4kStemFrameP)malloc((size_t)samples * MAX_INSTRUMENTS * sizeof(Go4kStemFrame));
+		engine->stemsamples = engine->stemframes ? samples : 0;
+		if (engine->stemframes == NULL)
+			return false;
+	}
+
+	Go4kStemPoolP pool = engine->stempool;
+	if (pool == NULL)
+	{
+		for (int task = 0; task < engine->stemtasks; task++)
+			RenderStemTask(engine, task, samples);
+		return true;
+	}
+	{
+		std::lock_guard<std::mutex> lock(pool->lock);
+		pool->samples = samples;
+		pool->next = 0;
+		pool->running = (int)pool->threads.size();
+		pool->round++;
+	}
+	pool->start.notify_all();
+	RunStemTasks(engine, pool);
+	std::unique_lock<std::mutex> lock(pool->lock);
+	pool->finish.wait(lock, [&]() { return pool->running == 0; });
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// engine
+/////////////////////////////////////////////////////////////////////////////////////
+
+bool Go4kEngine_Init(Go4kEngineP engine, SynthObjectP synth, int polyphony)
+{
+	memset(engine, 0, sizeof(Go4kEngine));
+	engine->synth = synth;
+	memset(engine->lanegroupof, -1, sizeof(engine->lanegroupof));
+	memset(engine->stemtaskof, -1, sizeof(engine->stemtaskof));
+	engine->stemnoisetask = -1;
+	engine->polyphony = polyphony > 1 ? MAX_POLYPHONY : 1;
+	engine->randseed = 1;
+	engine->clipoutput = true;
+	engine->sp = STACK_GUARD;
+	memcpy(engine->delay_times, Go4kDefaultDelayTimes, sizeof(Go4kDefaultDelayTimes));
+
+	if (IsEmptyInstrument(synth->GlobalValues))
+		memcpy(synth->GlobalValues, DefaultGlobalUnits, sizeof(DefaultGlobalUnits));
+	memset(synth->InstrumentWork, 0, sizeof(synth->InstrumentWork));
+	memset(&synth->GlobalWork, 0, sizeof(synth->GlobalWork));
+	memset(synth->VoiceIndex, 0, sizeof(synth->VoiceIndex));
+
+	engine->delaylines = CountDelayLines(synth->GlobalValues);
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+	{
+		if (IsEmptyInstrument(synth->InstrumentValues[i]))
+			continue;
+		engine->delaylines += CountDelayLines(synth->InstrumentValues[i]) * engine->polyphony;
+		// the asm gives the global chain the instrument count as note
+		engine->globalnote = i + 1;
+	}
+	if (engine->globalnote == 0)
+		engine->globalnote = 1;
+
+	// lay out the delay lines in the order the voices consume them
+	engine->delayoffsets = (size_t *)malloc((engine->delaylines + 1) * sizeof(size_t));
+	DWORD *lengths = (DWORD *)malloc((engine->delaylines + 1) * sizeof(DWORD));
+	if (!engine->delayoffsets || !lengths)
+	{
+		free(lengths);
+		return false;
+	}
+	int lines = 0;
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+	{
+		const BYTE (*units)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		engine->stemcursor[i] = lines;
+		for (int j = 0; j < (i < MAX_INSTRUMENTS ? engine->polyphony : 1); j++)
+			lines += DelayLineLengths(engine, units, &lengths[lines]);
+	}
+	for (int l = 0; l < lines; l++)
+	{
+		engine->delayoffsets[l] = engine->delaysamples;
+		engine->delaysamples += DELAY_WRK_BUFFER + lengths[l];
+	}
+	engine->delayoffsets[lines] = engine->delaysamples;
+
+	engine->delaybuffer = (float *)calloc(engine->delaysamples + 1, sizeof(float));
+	for (int l = 0; engine->delaybuffer && l < lines; l++)
+		SetDword(&engine->delaybuffer[engine->delayoffsets[l] + DELAY_WRK_LENGTH], lengths[l]);
+	free(lengths);
+	return engine->delaybuffer != NULL;
+}
+
+void Go4kEngine_Free(Go4kEngineP engine)
+{
+	StopStemPool(engine);
+	free(engine->delaybuffer);
+	engine->delaybuffer = NULL;
+	free(engine->delayoffsets);
+	engine->delayoffsets = NULL;
+	engine->delaysamples = 0;
+	engine->delaylines = 0;
+	free(engine->lanegroups);
+	engine->lanegroups = NULL;
+	engine->lanegroupcount = 0;
+	memset(engine->lanegroupof, -1, sizeof(engine->lanegroupof));
+	free(engine->stemframes);
+	engine->stemframes = NULL;
+	engine->stemsamples = 0;
+	engine->stemtasks = 0;
+	engine->stemnoisetask = -1;
+	memset(engine->stemtaskof, -1, sizeof(engine->stemtaskof));
+}
+
+int Go4kEngine_PlanLanes(Go4kEngineP engine)
+{
+	SynthObjectP synth = engine->synth;
+	bool lanes[MAX_INSTRUMENTS];
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+		lanes[i] = !IsEmptyInstrument(synth->InstrumentValues[i]) && !engine->compiled[i] && IsLaneChain(synth->InstrumentValues[i], i);
+
+	// the workspaces other chains store to stay in InstrumentWork
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+	{
+		const BYTE (*units)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			FST_valP v = (FST_valP)units[u];
+			if (v->id == M_FST && v->dest_stack >= 0 && v->dest_stack < MAX_INSTRUMENTS && v->dest_stack != i)
+				lanes[(int)v->dest_stack] = false;
+		}
+	}
+
+	// runs of instruments with the same chain, skipping the empty ones in between
+	int firsts[MAX_INSTRUMENTS];
+	int counts[MAX_INSTRUMENTS];
+	int groups = 0;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+	{
+		if (!lanes[i])
+			continue;
+		int count = 1;
+		int next = i + 1;
+		for (; next < MAX_INSTRUMENTS && (count + 1) * engine->polyphony <= GO4K_LANES; next++)
+		{
+			if (IsEmptyInstrument(synth->InstrumentValues[next]))
+				continue;
+			if (!lanes[next] || memcmp(synth->InstrumentValues[next], synth->InstrumentValues[i], sizeof(synth->InstrumentValues[i])))
+				break;
+			count++;
+		}
+		// a single voice is faster on its own
+		if (count * engine->polyphony >= 2)
+		{
+			firsts[groups] = i;
+			counts[groups] = count;
+			groups++;
+		}
+		i = next - 1;
+	}
+	if (groups == 0)
+		return 0;
+
+	engine->lanegroups = (Go4kLaneGroupP)calloc(groups, sizeof(Go4kLaneGroup));
+	if (engine->lanegroups == NULL)
+		return -1;
+	engine->lanegroupcount = groups;
+	int voices = 0;
+	for (int g = 0; g < groups; g++)
+	{
+		Go4kLaneGroupP group = &engine->lanegroups[g];
+		const BYTE (*units)[MAX_UNIT_SLOTS] = synth->InstrumentValues[firsts[g]];
+		group->instrument = firsts[g];
+		group->delaylines = CountDelayLines(units);
+		group->noiseunits = CountNoiseUnits(units);
+		while (units[group->first][0] == M_NONE)
+			group->first++;
+		for (int i = firsts[g]; group->lanes < counts[g] * engine->polyphony; i++)
+		{
+			if (IsEmptyInstrument(synth->InstrumentValues[i]))
+				continue;
+			engine->lanegroupof[i] = (signed char)g;
+			for (int j = 0; j < engine->polyphony; j++)
+				group->voice[group->lanes++] = &synth->InstrumentWork[i * MAX_POLYPHONY + j];
+		}
+		voices += group->lanes;
+	}
+	return voices;
+}
+
+int Go4kEngine_PlanStems(Go4kEngineP engine, int threads)
+{
+	SynthObjectP synth = engine->synth;
+	// instruments in one task, and the ones that stay on the calling thread (task MAX_INSTRUMENTS)
+	int tasks[MAX_INSTRUMENTS + 1];
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+		tasks[i] = i;
+	bool empty[MAX_INSTRUMENTS];
+	bool noise[MAX_INSTRUMENTS];
+	bool sets[MAX_INSTRUMENTS + 1];
+	bool reads[MAX_INSTRUMENTS + 1];
+	bool notesync = false;
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+	{
+		const BYTE (*units)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		NoteSyncUse(units, sets[i], reads[i]);
+		notesync = notesync || reads[i];
+		if (i < MAX_INSTRUMENTS)
+		{
+			empty[i] = IsEmptyInstrument(units);
+			noise[i] = CountNoiseUnits(units) > 0;
+		}
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			FST_valP v = (FST_valP)units[u];
+			if (v->id == M_FST && v->dest_stack >= 0 && v->dest_stack <= MAX_INSTRUMENTS && v->dest_stack != i)
+				JoinTasks(tasks, i, v->dest_stack);
+			// the accumulators read the outputs of all voices as they are
+			if (v->id == M_ACC && i < MAX_INSTRUMENTS)
+				JoinTasks(tasks, i, MAX_INSTRUMENTS);
+		}
+		if (i < MAX_INSTRUMENTS && engine->lanegroupof[i] >= 0)
+			JoinTasks(tasks, i, engine->lanegroups[engine->lanegroupof[i]].instrument);
+	}
+	int noisefirst = -1;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+	{
+		if (notesync && (sets[i] || reads[i]))
+			JoinTasks(tasks, i, MAX_INSTRUMENTS);
+		if (noise[i] && noisefirst < 0)
+			noisefirst = i;
+		else if (noise[i])
+			JoinTasks(tasks, i, noisefirst);
+	}
+
+	// number the tasks in the order of their first instrument
+	int number[MAX_INSTRUMENTS + 1];
+	memset(number, -1, sizeof(number));
+	engine->stemtasks = 0;
+	engine->stemnoisetask = -1;
+	int instruments = 0;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+	{
+		int task = FindTask(tasks, i);
+		engine->stemtaskof[i] = -1;
+		if (empty[i] || task == FindTask(tasks, MAX_INSTRUMENTS))
+			continue;
+		if (number[task] < 0)
+			number[task] = engine->stemtasks++;
+		engine->stemtaskof[i] = (signed char)number[task];
+		if (noise[i])
+			engine->stemnoisetask = number[task];
+		instruments++;
+	}
+	engine->stemthreads = threads > 0 ? threads : 1;
+
+	// the calling thread takes tasks too, so one worker less than there are threads
+	StopStemPool(engine);
+	int workers = (engine->stemthreads < engine->stemtasks ? engine->stemthreads : engine->stemtasks) - 1;
+	if (workers > 0)
+	{
+		engine->stempool = new Go4kStemPool;
+		for (int t = 0; t < workers; t++)
+			engine->stempool->threads.push_back(std::thread(StemWorker, engine, engine->stempool));
+	}
+	return instruments;
+}
+
+void Go4kEngine_Tick(Go4kEngineP engine, const BYTE notes[MAX_INSTRUMENTS])
+{
+	memcpy(engine->ticknotes, notes, MAX_INSTRUMENTS);
+	engine->tickpending = 1;
+}
+
+void Go4kEngine_Render(Go4kEngineP engine, float *buffer, int samples)
+{
+	Go4kEngine_RenderStems(engine, buffer, NULL, samples);
+}
+
+void Go4kEngine_RenderStems(Go4kEngineP engine, float *buffer, float *stems[MAX_INSTRUMENTS], int samples)
+{
+	SynthObjectP synth = engine->synth;
+	bool workers = RenderStemTasks(engine, samples);
+	for (int s = 0; s < samples; s++)
+	{
+		for (int i = 0; i < MAX_INSTRUMENTS; i++)
+		{
+			engine->delaycursor = engine->stemcursor[i];
+			if (!workers || engine->stemtaskof[i] < 0)
+			{
+				ProcessInstrument(engine, i);
+				continue;
+			}
+			// the outputs the worker left for the ACC units of the global chain
+			Go4kStemFrameP frame = &engine->stemframes[(size_t)s * MAX_INSTRUMENTS + i];
+			for (int j = 0; j < engine->polyphony; j++)
+				memcpy(&synth->InstrumentWork[i * MAX_POLYPHONY + j].dlloutl, frame->out[j], sizeof(frame->out[j]));
+			if (engine->stemtaskof[i] == engine->stemnoisetask)
+				engine->randseed = (int)frame->randseed;
+		}
+		engine->tickpending = 0;
+
+		for (int i = 0; stems && i < MAX_INSTRUMENTS; i++)
+		{
+			if (stems[i] == NULL)
+				continue;
+			double l = 0;
+			double r = 0;
+			for (int j = 0; j < engine->polyphony; j++)
+			{
+				l += synth->InstrumentWork[i * MAX_POLYPHONY + j].outl;
+				r += synth->InstrumentWork[i * MAX_POLYPHONY + j].outr;
+			}
+			stems[i][s * 2] = (float)l;
+			stems[i][s * 2 + 1] = (float)r;
+		}
+
+		engine->delaycursor = engine->stemcursor[MAX_INSTRUMENTS];
+		synth->GlobalWork.note = engine->globalnote;
+		ProcessVoice(engine, synth->GlobalValues, &synth->GlobalWork, MAX_INSTRUMENTS);
+
+		float l = synth->GlobalWork.outl;
+		float r = synth->GlobalWork.outr;
+		if (engine->clipoutput)
+		{
+			l = !(l < 1) ? 1 : !(l > -1) ? -1 : l;
+			r = !(r < 1) ? 1 : !(r > -1) ? -1 : r;
+		}
+		*buffer++ = l;
+		*buffer++ = r;
+	}
+}
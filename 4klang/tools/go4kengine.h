@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include "./instrumentdisassembler.h"
+
+/////////////////////////////////////////////////////////////////////////////////////
+// native go4k engine
+//
+// Interprets the unit chains of a SynthObject the way 4klang.asm does, with the
+// instrument and global state kept in the InstrumentWork/GlobalWork workspaces, so
+// that songs can be rendered by a 64 bit build without yasm and a 32 bit toolchain.
+// The constants and the defaults below are the ones 4klang_inc.make.js generates.
+/////////////////////////////////////////////////////////////////////////////////////
+
+#define HLD						1
+#define MAX_DELAY				65536
+#define MAX_DELAY_TIMES			512
+#define DEF_LFO_NORMALIZE		0.000038f
+#define FREQ_NORMALIZE			0.000092696138f
+
+// delay line workspace, see go4kDLL_wrk and go4kGLITCH_wrk, with the length of the buffer in front of it
+#define DELAY_WRK_INDEX			0
+#define DELAY_WRK_STORE			1
+#define DELAY_WRK_DCIN			2
+#define DELAY_WRK_DCOUT			3
+#define DELAY_WRK_PHASE			4
+#define DELAY_WRK_LENGTH		5
+#define DELAY_WRK_BUFFER		6
+#define GLITCH_WRK_SLIZESIZE	2
+#define GLITCH_WRK_SLICEPITCH	3
+
+// voices rendered together in lanes mode, see Go4kEngine_PlanLanes
+#define GO4K_LANES				8
+
+struct Go4kLaneGroup;
+struct Go4kStemFrame;
+struct Go4kStemPool;
+struct Go4kEngine;
+
+// a unit chain compiled by instrumentdisassembler -cpp, runs one voice for one sample
+typedef void (*Go4kVoiceFunction)(struct Go4kEngine *engine, InstrumentWorkspaceP voice);
+
+typedef struct Go4kEngine
+{
+	SynthObjectP synth;
+	int		polyphony;				// voices per instrument, 1 or MAX_POLYPHONY (MAX_VOICES in 4klang.inc)
+	DWORD	globalnote;				// note of the global chain, the instrument count in 4klang.asm
+	int		randseed;
+	bool	clipoutput;
+	WORD	delay_times[MAX_DELAY_TIMES];
+	// delay lines of the DLL and GLITCH units, consumed in processing order every sample. they
+	// share one arena, each sized to the longest delay time its unit can use, see Go4kEngine_Init
+	float	*delaybuffer;
+	size_t	*delayoffsets;				// start of every delay line in delaybuffer
+	size_t	delaysamples;				// size of the arena
+	int		delaylines;
+	int		delaycursor;
+	int		tickpending;
+	BYTE	ticknotes[MAX_INSTRUMENTS];
+	// the fpu stack of the unit chain being processed
+	double	stack[64];
+	int		sp;
+	// compiled unit chains, run instead of the interpreter for the instruments that have one
+	Go4kVoiceFunction compiled[MAX_INSTRUMENTS];
+	// voices running in lanes, lanegroupof is the group of each instrument or -1
+	struct Go4kLaneGroup *lanegroups;
+	int		lanegroupcount;
+	signed char lanegroupof[MAX_INSTRUMENTS];
+	// instruments rendered on worker threads, stemtaskof is the task of each instrument or -1
+	int		stemthreads;
+	int		stemtasks;
+	int		stemnoisetask;				// the task with all the noise oscillators, or -1
+	signed char stemtaskof[MAX_INSTRUMENTS];
+	int		stemcursor[MAX_INSTRUMENTS + 1];	// first delay line of every instrument and of the global chain
+	struct Go4kStemFrame *stemframes;
+	int		stemsamples;
+	struct Go4kStemPool *stempool;		// the worker threads, see Go4kEngine_PlanStems
+} *Go4kEngineP;
+
+// sets up the engine for the instruments loaded into synth, installing the default global
+// chain and delay times when synth has none. returns false if the delay lines can't be allocated.
+// a delay line holds the longest delay time of its unit (MAX_DELAY for GLITCH units and empty
+// times), reads beyond it are silent like the never written samples of a MAX_DELAY line.
+bool Go4kEngine_Init(Go4kEngineP engine, SynthObjectP synth, int polyphony);
+void Go4kEngine_Free(Go4kEngineP engine);
+// lanes mode: the voices of consecutive instruments with the same unit chain keep their workspaces
+// in structure of arrays layout and run the chain together, up to GO4K_LANES voices per pass.
+// chains with GLITCH, ACC or FSTG units, and instruments that other chains store to, stay scalar.
+// call after Go4kEngine_Init, returns the number of voices in lanes or -1 if out of memory.
+int Go4kEngine_PlanLanes(Go4kEngineP engine);
+// stems mode: instruments render on up to threads worker threads, each task for all samples of
+// Go4kEngine_Render before the global chain runs on their outputs. instruments that store to each
+// other share a task, the ones storing to the global chain or stored to by it, chains with ACC and
+// chains reading the note sync delay time of others stay on the calling thread, and so do all noise
+// oscillators if one of them does, since they draw from one noise sequence. the mixdown is the same
+// as without stems. the worker threads start here and are joined by Go4kEngine_Free. call after
+// Go4kEngine_PlanLanes, returns the number of instruments on workers.
+int Go4kEngine_PlanStems(Go4kEngineP engine, int threads);
+// starts a new tick with one pattern byte per instrument: 0 releases, HLD holds, anything above is a new note
+void Go4kEngine_Tick(Go4kEngineP engine, const BYTE notes[MAX_INSTRUMENTS]);
+// renders interleaved stereo samples
+void Go4kEngine_Render(Go4kEngineP engine, float *buffer, int samples);
+// renders like Go4kEngine_Render, and the out bus of every instrument that has a stems buffer (the
+// sum of its voices before the global chain, without the aux send) as interleaved stereo samples
+void Go4kEngine_RenderStems(Go4kEngineP engine, float *buffer, float *stems[MAX_INSTRUMENTS], int samples);
@@ -0,0 +1,602 @@
+#pragma once
+
+#include <math.h>
+#include <string.h>
+#include "./go4kengine.h"
+
+/////////////////////////////////////////////////////////////////////////////////////
+// go4k unit kernels
+//
+// shared by the interpreter in go4kengine.cpp and the code instrumentdisassembler -cpp
+// generates. the unit bytes are a template parameter: the interpreter passes the unit
+// as const BYTE *, generated code a Go4kConstUnit, which turns every parameter and flag
+// into a compile time constant.
+/////////////////////////////////////////////////////////////////////////////////////
+
+// unit bytes as template arguments, the bytes not given are 0
+template <BYTE... Bytes>
+struct Go4kConstUnit
+{
+	constexpr BYTE operator[](int n) const
+	{
+		constexpr BYTE bytes[] = { Bytes..., 0 };
+		return n < (int)sizeof...(Bytes) ? bytes[n] : 0;
+	}
+};
+
+// the x87 constants of 4klang.asm, with the same float rounding
+static const float c_i128 = 0.0078125f;
+static const float c_i12 = 0x1.555554p-4f;		// 0x3DAAAAAA
+static const float c_dc_const = 0.99609375f;
+static const float DLL_DEPTH = 1024.0f;
+
+// unit workspace slots, see the go4k*_wrk structs in 4klang.inc
+enum { ENV_WRK_STATE, ENV_WRK_LEVEL, ENV_WRK_GM, ENV_WRK_AM, ENV_WRK_DM, ENV_WRK_SM, ENV_WRK_RM };
+enum { VCO_WRK_PHASE, VCO_WRK_TM, VCO_WRK_DM, VCO_WRK_FM, VCO_WRK_PM, VCO_WRK_CM, VCO_WRK_SM, VCO_WRK_GM, VCO_WRK_PHASE2 };
+enum { VCF_WRK_LOW, VCF_WRK_HIGH, VCF_WRK_BAND, VCF_WRK_FREQ, VCF_WRK_FM, VCF_WRK_RM, VCF_WRK_LOW2 };
+enum { DST_WRK_OUT, DST_WRK_SNHPHASE, DST_WRK_DM, DST_WRK_SM, DST_WRK_OUT2 };
+enum { DLL_WRK2_PM, DLL_WRK2_FM, DLL_WRK2_IM, DLL_WRK2_DM, DLL_WRK2_SM, DLL_WRK2_AM };
+enum { GLITCH_WRK2_AM, GLITCH_WRK2_DM, GLITCH_WRK2_SM, GLITCH_WRK2_PM };
+enum { PAN_WRK_PM };
+enum { OUT_WRK_AM, OUT_WRK_GM };
+enum { FLD_WRK_VM };
+
+// bottom of the value stack, so that an unbalanced unit chain reads zeros instead of running off the stack
+#define STACK_GUARD		8
+
+/////////////////////////////////////////////////////////////////////////////////////
+// helpers
+/////////////////////////////////////////////////////////////////////////////////////
+
+// some workspace slots hold integers (envelope state, delay indices)
+static inline DWORD GetDword(const float *slot)
+{
+	DWORD value;
+	memcpy(&value, slot, 4);
+	return value;
+}
+
+static inline void SetDword(float *slot, DWORD value)
+{
+	memcpy(slot, &value, 4);
+}
+
+static inline void Push(Go4kEngineP engine, double value)
+{
+	if (engine->sp < (int)(sizeof(engine->stack) / sizeof(engine->stack[0])))
+		engine->stack[engine->sp++] = value;
+}
+
+static inline double Pop(Go4kEngineP engine)
+{
+	double value = engine->stack[engine->sp - 1];
+	if (engine->sp > STACK_GUARD)
+		engine->sp--;
+	return value;
+}
+
+static inline double &Top(Go4kEngineP engine, int depth = 0)
+{
+	return engine->stack[engine->sp - 1 - depth];
+}
+
+// go4kTransformValues: unit bytes to 0..1 (byte/128), without the unit id
+template <class U>
+static inline void Transform(U unit, int count, float *values)
+{
+	for (int i = 0; i < count; i++)
+		values[i] = unit[i + 1] * c_i128;
+}
+
+static inline double Power(double exponent)
+{
+	return exp2(exponent);
+}
+
+static inline int RoundToInt(double value)
+{
+	return (int)lrint(value);
+}
+
+static inline double Waveshaper(double in, double amount)
+{
+	if (!(in < 1))
+		in = 1;
+	else if (!(in > -1))
+		in = -1;
+	double a = (amount - 0.5) * 2;
+	double k = 2 * a / (1 - (float)a);
+	return (1 + k) * in / (1 + k * fabs(in));
+}
+
+static inline float *DelayLine(Go4kEngineP engine)
+{
+	return engine->delaybuffer + engine->delayoffsets[engine->delaycursor];
+}
+
+// reads a delay line sample, silent beyond the end of the line
+static inline double DelayRead(const float *line, int index)
+{
+	return (unsigned)index < GetDword(&line[DELAY_WRK_LENGTH]) ? line[DELAY_WRK_BUFFER + index] : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// units
+/////////////////////////////////////////////////////////////////////////////////////
+
+static inline double ENVMap(const float *values, const float *wrk, int state)
+{
+	return Power(-((values[state] + wrk[ENV_WRK_AM + state]) * 24.0));
+}
+
+template <class U>
+static void Go4kENV(Go4kEngineP engine, U unit, float *wrk, InstrumentWorkspaceP voice)
+{
+	float v[5];
+	Transform(unit, 5, v);
+	if (voice->note == 0)
+	{
+		Push(engine, 0);
+		return;
+	}
+	if (voice->release)
+		SetDword(&wrk[ENV_WRK_STATE], ENV_STATE_RELEASE);
+
+	BYTE state = (BYTE)GetDword(&wrk[ENV_WRK_STATE]);
+	double level = wrk[ENV_WRK_LEVEL];
+	if (state != ENV_STATE_SUSTAIN)
+	{
+		bool statechange = false;
+		if (state == ENV_STATE_ATTAC)
+		{
+			level += ENVMap(v, wrk, state);
+			if (level >= 1)
+			{
+				level = 1;
+				statechange = true;
+			}
+		}
+		else if (state == ENV_STATE_DECAY)
+		{
+			level -= ENVMap(v, wrk, state);
+			if (v[2] >= level)
+			{
+				level = v[2];
+				statechange = true;
+			}
+		}
+		else if (state == ENV_STATE_RELEASE)
+		{
+			level -= ENVMap(v, wrk, state);
+			if (level <= 0)
+			{
+				level = 0;
+				statechange = true;
+			}
+		}
+		// in any other state the asm drops the value below the level
+		else if (engine->sp > STACK_GUARD)
+			Pop(engine);
+		if (statechange)
+			SetDword(&wrk[ENV_WRK_STATE], GetDword(&wrk[ENV_WRK_STATE]) + 1);
+		wrk[ENV_WRK_LEVEL] = (float)level;
+	}
+	Push(engine, level * (v[4] + wrk[ENV_WRK_GM]));
+}
+
+template <class U>
+static double VCOGate(float *wrk, U unit, double p)
+{
+	WORD gatebits = unit[4] | (unit[5] << 8);
+	double x = (gatebits >> (RoundToInt(p * 16) & 15)) & 1 ? 1 : 0;
+	x = x + (wrk[VCO_WRK_CM] - x) * c_dc_const;
+	wrk[VCO_WRK_CM] = (float)x;
+	return x;
+}
+
+template <class U>
+static void Go4kVCO(Go4kEngineP engine, U unit, float *wrk, InstrumentWorkspaceP voice)
+{
+	float v[8];
+	Transform(unit, 8, v);
+	BYTE flags = unit[8];
+	if (voice->note == 0)
+	{
+		if (flags & VCO_STEREO)
+			Push(engine, 0);
+		Push(engine, 0);
+		return;
+	}
+
+	// a stereo vco runs twice, the first time with the second phase and negated detune
+	if (flags & VCO_STEREO)
+	{
+		float phase = wrk[VCO_WRK_PHASE];
+		wrk[VCO_WRK_PHASE] = wrk[VCO_WRK_PHASE2];
+		wrk[VCO_WRK_PHASE2] = phase;
+	}
+	for (;;)
+	{
+		double detune = (v[1] - 0.5) * 2;
+		if (flags & VCO_STEREO)
+			detune = -detune;
+		double x = (v[0] - 0.5 + wrk[VCO_WRK_TM]) / c_i128 + detune + wrk[VCO_WRK_DM];
+		if (!(flags & VCO_LFO))
+			x += voice->note;
+		double freq = Power(x * c_i12) * ((flags & VCO_LFO) ? DEF_LFO_NORMALIZE : FREQ_NORMALIZE);
+
+		double phase = fmod(freq + wrk[VCO_WRK_PHASE] + wrk[VCO_WRK_FM] + 1, 1);
+		wrk[VCO_WRK_PHASE] = (float)phase;
+		double p = fmod(phase + wrk[VCO_WRK_PM] + v[2] + 1, 1);
+		double c = v[4] + wrk[VCO_WRK_CM];
+
+		double out;
+		if (flags & VCO_SINE)
+			out = c >= p ? sin(2 * M_PI * (p / c)) : 0;
+		else if (flags & VCO_TRISAW)
+			out = (c >= p ? p / c : (1 - p) / (1 - c)) * 2 - 1;
+		else if (flags & VCO_PULSE)
+			out = c >= p ? 1 : -1;
+		else if (flags & VCO_GATE)
+			out = VCOGate(wrk, unit, p);
+		else if (flags & VCO_NOISE)
+		{
+			engine->randseed = (int)((DWORD)engine->randseed * 16007);
+			out = engine->randseed / 2147483648.0;
+		}
+		// no waveform leaves the phase on the stack, as the asm does
+		else
+		{
+			Push(engine, p);
+			out = c;
+		}
+
+		out = Waveshaper(out, v[5] + wrk[VCO_WRK_SM]);
+		Push(engine, out * (v[6] + wrk[VCO_WRK_GM]));
+
+		if (!(flags & VCO_STEREO))
+			break;
+		flags &= ~VCO_STEREO;
+		float phase2 = wrk[VCO_WRK_PHASE];
+		wrk[VCO_WRK_PHASE] = wrk[VCO_WRK_PHASE2];
+		wrk[VCO_WRK_PHASE2] = phase2;
+	}
+}
+
+static inline double VCFProcess(double in, float *wrk, float res, float freq, BYTE type)
+{
+	double low = freq * wrk[VCF_WRK_BAND] + wrk[VCF_WRK_LOW];
+	wrk[VCF_WRK_LOW] = (float)low;
+	double high = (in - low) - res * wrk[VCF_WRK_BAND];
+	wrk[VCF_WRK_HIGH] = (float)high;
+	wrk[VCF_WRK_BAND] = (float)(high * freq + wrk[VCF_WRK_BAND]);
+
+	double out = 0;
+	if (type & VCF_LOWPASS)
+		out += wrk[VCF_WRK_LOW];
+	if (type & VCF_HIGHPASS)
+		out += wrk[VCF_WRK_HIGH];
+	if (type & VCF_BANDPASS)
+		out += wrk[VCF_WRK_BAND];
+	if (type & VCF_PEAK)
+	{
+		out += wrk[VCF_WRK_LOW];
+		out -= wrk[VCF_WRK_HIGH];
+	}
+	return out;
+}
+
+template <class U>
+static void Go4kVCF(Go4kEngineP engine, U unit, float *wrk, InstrumentWorkspaceP voice)
+{
+	float v[3];
+	Transform(unit, 3, v);
+	if (voice->note == 0)
+		return;
+	BYTE type = unit[3];
+	float res = v[1] + wrk[VCF_WRK_RM];
+	double f = v[0] + wrk[VCF_WRK_FM];
+	float freq = (float)(f * f);
+
+	if (type & VCF_STEREO)
+		Top(engine, 1) = VCFProcess(Top(engine, 1), wrk + VCF_WRK_LOW2, res, freq, type);
+	Top(engine) = VCFProcess(Top(engine), wrk, res, freq, type);
+}
+
+template <class U>
+static void Go4kDST(Go4kEngineP engine, U unit, float *wrk, InstrumentWorkspaceP voice)
+{
+	float v[3];
+	Transform(unit, 3, v);
+	if (voice->note == 0)
+		return;
+	BYTE stereo = unit[3] & VCF_STEREO;
+
+	double snh = v[1] + wrk[DST_WRK_SM];
+	snh = wrk[DST_WRK_SNHPHASE] - snh * snh;
+	wrk[DST_WRK_SNHPHASE] = (float)snh;
+	if (0 < snh)
+	{
+		Pop(engine);
+		if (stereo)
+		{
+			Pop(engine);
+			Push(engine, wrk[DST_WRK_OUT2]);
+		}
+		Push(engine, wrk[DST_WRK_OUT]);
+		return;
+	}
+	wrk[DST_WRK_SNHPHASE] = 1 + (float)snh;
+
+	if (stereo)
+	{
+		Top(engine, 1) = Waveshaper(Top(engine, 1), v[0] + wrk[DST_WRK_DM]);
+		wrk[DST_WRK_OUT2] = (float)Top(engine, 1);
+	}
+	Top(engine) = Waveshaper(Top(engine), v[0] + wrk[DST_WRK_DM]);
+	wrk[DST_WRK_OUT] = (float)Top(engine);
+}
+
+template <class U>
+static void Go4kDLL(Go4kEngineP engine, U unit, float *wrk, InstrumentWorkspaceP voice)
+{
+	float v[8];
+	Transform(unit, 8, v);
+	int delayindex = unit[7];
+	int count = unit[8];
+
+	// note sync (karplus strong) sets the first delay time to the period of the note
+	if (delayindex == 0)
+	{
+		long period = lrint(1 / (Power(voice->note * c_i12) * FREQ_NORMALIZE));
+		engine->delay_times[0] = (WORD)(period < -32768 || period > 32767 ? 0x8000 : period);
+	}
+
+	double in = Top(engine);
+	double out = in * (v[1] + wrk[DLL_WRK2_IM]);
+	double pregain = v[0] + wrk[DLL_WRK2_PM];
+	in = in * (pregain * pregain);
+
+	// chorus/flanger lfo
+	float *line = DelayLine(engine);
+	DWORD length;
+	double freq = v[4] + wrk[DLL_WRK2_SM];
+	freq = freq * freq;
+	freq = freq * freq;
+	double phase = fmod(freq / DLL_DEPTH + line[DELAY_WRK_PHASE] + 1, 1);
+	line[DELAY_WRK_PHASE] = (float)phase;
+	double depth = v[5] + wrk[DLL_WRK2_AM];
+	depth = depth * depth;
+	depth = depth * depth;
+	int offset = RoundToInt((1 + sin(2 * M_PI * phase)) * (depth * DLL_DEPTH));
+
+	do
+	{
+		line = DelayLine(engine);
+		length = GetDword(&line[DELAY_WRK_LENGTH]);
+		int size = engine->delay_times[delayindex & (MAX_DELAY_TIMES - 1)];
+		int index = (int)GetDword(&line[DELAY_WRK_INDEX]);
+		int readindex = index + offset;
+		if (readindex >= size)
+			readindex -= size;
+		double cout = DelayRead(line, readindex);
+		out += cout;
+
+		double store = cout * ((1 - v[3]) - wrk[DLL_WRK2_DM]) + (v[3] + wrk[DLL_WRK2_DM]) * line[DELAY_WRK_STORE];
+		line[DELAY_WRK_STORE] = (float)store;
+		line[DELAY_WRK_BUFFER + index] = (float)(store * (v[2] + wrk[DLL_WRK2_FM]) + in);
+
+		index++;
+		if (index >= size)
+			index -= size;
+		// an empty delay time would run off the delay line
+		if ((unsigned)index >= length)
+			index = 0;
+		SetDword(&line[DELAY_WRK_INDEX], index);
+
+		delayindex++;
+		engine->delaycursor++;
+	} while (--count > 0);
+
+	// dc filter on the last delay line: y(n) = x(n) - x(n-1) + R * y(n-1)
+	double dc = line[DELAY_WRK_DCOUT] * c_dc_const - line[DELAY_WRK_DCIN];
+	line[DELAY_WRK_DCIN] = (float)out;
+	out = out + dc;
+	out = (out + 0.5) - 0.5;
+	line[DELAY_WRK_DCOUT] = (float)out;
+	Top(engine) = out;
+}
+
+template <class U>
+static void Go4kGLITCH(Go4kEngineP engine, U unit, float *wrk)
+{
+	float v[5];
+	Transform(unit, 5, v);
+	float *line = DelayLine(engine);
+	engine->delaycursor++;
+
+	if (!(0 < v[0] + wrk[GLITCH_WRK2_AM]))
+	{
+		// mark as uninitialized again
+		SetDword(&line[GLITCH_WRK_SLIZESIZE], 0);
+		return;
+	}
+	if (GetDword(&line[GLITCH_WRK_SLIZESIZE]) == 0)
+	{
+		SetDword(&line[DELAY_WRK_INDEX], 0);
+		SetDword(&line[DELAY_WRK_STORE], 0);
+		line[GLITCH_WRK_SLIZESIZE] = engine->delay_times[unit[5]];
+		line[GLITCH_WRK_SLICEPITCH] = 1;
+	}
+
+	// fill the buffer until it is full
+	float in = (float)Top(engine);
+	DWORD store = GetDword(&line[DELAY_WRK_STORE]);
+	if (store < MAX_DELAY)
+	{
+		line[DELAY_WRK_BUFFER + store] = in;
+		SetDword(&line[DELAY_WRK_STORE], store + 1);
+	}
+
+	double index = line[DELAY_WRK_INDEX];
+	double out = DelayRead(line, RoundToInt(index));
+	index += line[GLITCH_WRK_SLICEPITCH];
+	line[DELAY_WRK_INDEX] = (float)index;
+
+	// slice done, change size and pitch for the next one
+	if (!(index < line[GLITCH_WRK_SLIZESIZE]))
+	{
+		SetDword(&line[DELAY_WRK_INDEX], 0);
+		line[GLITCH_WRK_SLIZESIZE] = (float)(Power((v[2] + wrk[GLITCH_WRK2_SM] - 0.5) * 0.5) * line[GLITCH_WRK_SLIZESIZE]);
+		line[GLITCH_WRK_SLICEPITCH] = (float)(Power((v[3] + wrk[GLITCH_WRK2_PM] - 0.5) * 0.5) * line[GLITCH_WRK_SLICEPITCH]);
+	}
+
+	double dry = v[1] + wrk[GLITCH_WRK2_DM];
+	Top(engine) = out * (1 - dry) + dry * in;
+}
+
+template <class U>
+static void Go4kFOP(Go4kEngineP engine, U unit, InstrumentWorkspaceP voice)
+{
+	double a, b;
+	switch (unit[1])
+	{
+	case FOP_POP:
+		Pop(engine);
+		break;
+	case FOP_ADDP:
+		a = Pop(engine);
+		Top(engine) += a;
+		break;
+	case FOP_MULP:
+		a = Pop(engine);
+		Top(engine) *= a;
+		break;
+	case FOP_PUSH:
+		Push(engine, Top(engine));
+		break;
+	case FOP_XCH:
+		a = Top(engine);
+		Top(engine) = Top(engine, 1);
+		Top(engine, 1) = a;
+		break;
+	case FOP_ADD:
+		Top(engine) += Top(engine, 1);
+		break;
+	case FOP_MUL:
+		Top(engine) *= Top(engine, 1);
+		break;
+	case FOP_ADDP2:
+		a = Pop(engine);
+		b = Pop(engine);
+		Top(engine) += a;
+		Top(engine, 1) += b;
+		break;
+	case FOP_LOADNOTE:
+		Push(engine, voice->note * c_i128);
+		break;
+	case FOP_MULP2:
+		a = Pop(engine);
+		b = Pop(engine);
+		Top(engine) *= a;
+		Top(engine, 1) *= b;
+		break;
+	}
+}
+
+template <class U>
+static void Go4kFST(Go4kEngineP engine, U unit, float *dest)
+{
+	BYTE type = unit[2];
+	double value = (unit[1] * c_i128 - 0.5) * 2 * Top(engine);
+	if (dest != NULL)
+	{
+		if (type & FST_ADD)
+			value += *dest;
+		*dest = (float)value;
+	}
+	if (type & FST_POP)
+		Pop(engine);
+}
+
+// FSTG: stores into the workspace of another instrument, for all of its voices
+template <class U>
+static void Go4kFSTG(Go4kEngineP engine, U unit, InstrumentWorkspaceP voice)
+{
+	SynthObjectP synth = engine->synth;
+	int stack = (char)unit[3];
+	int destunit = (char)unit[4];
+	int slot = destunit * MAX_UNIT_SLOTS + (char)unit[5];
+	if (voice->note == 0 || destunit < 0 || slot >= MAX_UNITS * MAX_UNIT_SLOTS)
+	{
+		Go4kFST(engine, unit, NULL);
+		return;
+	}
+	if (stack == MAX_INSTRUMENTS)
+	{
+		Go4kFST(engine, unit, &synth->GlobalWork.workspace[slot]);
+		return;
+	}
+
+	InstrumentWorkspaceP target = &synth->InstrumentWork[stack * MAX_POLYPHONY];
+	BYTE type = unit[2];
+	double value = (unit[1] * c_i128 - 0.5) * 2 * Top(engine);
+	if (type & FST_ADD)
+		value += target->workspace[slot];
+	for (int i = 0; i < engine->polyphony; i++)
+		target[i].workspace[slot] = (float)value;
+	if (type & FST_POP)
+		Pop(engine);
+}
+
+template <class U>
+static void Go4kPAN(Go4kEngineP engine, U unit, float *wrk)
+{
+	float v[1];
+	Transform(unit, 1, v);
+	double in = Top(engine);
+	double r = in * (v[0] + wrk[PAN_WRK_PM]);
+	Top(engine) = r;
+	Push(engine, in - r);
+}
+
+template <class U>
+static void Go4kOUT(Go4kEngineP engine, U unit, float *wrk, InstrumentWorkspaceP voice)
+{
+	float v[2];
+	Transform(unit, 2, v);
+	double l = Pop(engine);
+	double r = Pop(engine);
+	double aux = v[1] + wrk[OUT_WRK_AM];
+	double gain = v[0] + wrk[OUT_WRK_GM];
+	voice->dlloutl = (float)(l * aux);
+	voice->dlloutr = (float)(r * aux);
+	voice->outl = (float)(l * gain);
+	voice->outr = (float)(r * gain);
+}
+
+template <class U>
+static void Go4kACC(Go4kEngineP engine, U unit)
+{
+	double l = 0;
+	double r = 0;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+	{
+		for (int j = 0; j < engine->polyphony; j++)
+		{
+			InstrumentWorkspaceP voice = &engine->synth->InstrumentWork[i * MAX_POLYPHONY + j];
+			l += unit[1] == ACC_AUX ? voice->dlloutl : voice->outl;
+			r += unit[1] == ACC_AUX ? voice->dlloutr : voice->outr;
+		}
+	}
+	Push(engine, r);
+	Push(engine, l);
+}
+
+template <class U>
+static void Go4kFLD(Go4kEngineP engine, U unit, float *wrk)
+{
+	float v[1];
+	Transform(unit, 1, v);
+	Push(engine, (v[0] - 0.5) * 2 + wrk[FLD_WRK_VM]);
+}
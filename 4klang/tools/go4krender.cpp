@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "./go4kengine.h"
+
+// Renders .4ki instruments with the native engine, playing the same pattern on every instrument.
+// Writes raw stereo float samples to stdout like 4klangrender, or compares them with a
+// reference render of 4klang.asm (see nulltest.sh).
+
+void usage()
+{
+	fprintf(stderr, "USAGE: go4krender [-s samplespertick] [-t ticks] [-p pattern] [-v voices] [-m scalar|lanes] [-O]\n");
+	fprintf(stderr, "                  [-k instruments.so] [-j threads] [-S stemprefix | -x previewprefix] [-c reference.raw] [-e tolerance]\n");
+	fprintf(stderr, "                  instrument.4ki [instrument.4ki ...]\n");
+	fprintf(stderr, "  -p comma separated pattern bytes, one per tick and repeated (0 = release, 1 = hold, 60 = c4)\n");
+	fprintf(stderr, "  -m lanes runs the voices of instruments with the same unit chain together, see Go4kEngine_PlanLanes\n");
+	fprintf(stderr, "  -k runs the unit chains compiled from instrumentdisassembler -cpp output instead of interpreting them\n");
+	fprintf(stderr, "  -O removes units without effect and folds constants after loading, see Go4kVSTi_OptimizeInstrument\n");
+	fprintf(stderr, "  -j renders the instruments that don't depend on each other on threads, see Go4kEngine_PlanStems\n");
+	fprintf(stderr, "  -S writes the out bus of every instrument to stemprefix<n>.raw, with the mixdown as usual\n");
+	fprintf(stderr, "  -x renders every instrument alone, with an engine of its own, to previewprefix<n>.raw, -j at once\n");
+	fprintf(stderr, "  -c null test against raw stereo float samples instead of writing to stdout\n");
+}
+
+int parsePattern(const char *str, std::vector<BYTE> &pattern)
+{
+	pattern.clear();
+	while (*str)
+	{
+		pattern.push_back((BYTE)strtol(str, (char **)&str, 10));
+		if (*str == ',')
+			str++;
+		else if (*str)
+			return 0;
+	}
+	return (int)pattern.size();
+}
+
+// compares the render with the reference and prints the difference, returns false if it exceeds tolerance
+bool nullTest(const std::vector<float> &samples, const char *filename, double tolerance)
+{
+	FILE *file = fopen(filename, "rb");
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open file %s\n", filename);
+		return false;
+	}
+	std::vector<float> reference(samples.size() + 1);
+	size_t count = fread(&reference[0], sizeof(float), reference.size(), file);
+	fclose(file);
+	if (count != samples.size())
+	{
+		fprintf(stderr, "FAIL: rendered %d samples, the reference has %d\n", (int)samples.size(), (int)count);
+		return false;
+	}
+
+	double peak = 0;
+	int peakindex = 0;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		double difference = fabs((double)samples[i] - reference[i]);
+		if (!(difference <= peak))
+		{
+			peak = difference;
+			peakindex = (int)i;
+		}
+	}
+	bool passed = peak <= tolerance;
+	fprintf(stderr, "%s: peak difference %g (%.1f dB) at frame %d, tolerance %g\n", passed ? "PASS" : "FAIL",
+		peak, peak > 0 ? 20 * log10(peak) : -INFINITY, peakindex / 2, tolerance);
+	return passed;
+}
+
+// loads the unit chains generated by instrumentdisassembler -cpp and built as shared object
+bool loadCompiled(Go4kEngineP engine, const char *filename)
+{
+	void *library = dlopen(filename, RTLD_NOW);
+	if (!library)
+	{
+		fprintf(stderr, "Unable to load %s: %s\n", filename, dlerror());
+		return false;
+	}
+	typedef void (*CompiledInstruments)(Go4kVoiceFunction functions[MAX_INSTRUMENTS]);
+	CompiledInstruments compiledInstruments = (CompiledInstruments)dlsym(library, "go4k_compiled_instruments");
+	if (!compiledInstruments)
+	{
+		fprintf(stderr, "%s has no go4k_compiled_instruments\n", filename);
+		return false;
+	}
+	compiledInstruments(engine->compiled);
+	return true;
+}
+
+// renders every instrument as a song of its own, with its own SynthObject and engine, up to threads
+// of them at once in this process, to previewprefix<n>.raw
+bool renderPreviews(char *filenames[], int instruments, const char *previewprefix, int threads, bool optimize,
+	int voices, int samplespertick, int ticks, const std::vector<BYTE> &pattern)
+{
+	std::atomic<int> next(0);
+	std::atomic<int> failed(0);
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++)
+	{
+		pool.push_back(std::thread([&]()
+		{
+			for (int i; (i = next++) < instruments; )
+			{
+				SynthObjectP synth = (SynthObjectP)calloc(1, sizeof(SynthObject));
+				Go4kEngine engine;
+				bool rendered = synth && Go4kVSTi_LoadInstrumentFile(synth, filenames[i], 0);
+				if (rendered && optimize)
+				{
+					Go4kOptimizeReport report;
+					Go4kVSTi_OptimizeInstrument(synth, 0, &report);
+				}
+				if (rendered && Go4kEngine_Init(&engine, synth, voices))
+				{
+					std::vector<float> samples((size_t)ticks * samplespertick * 2);
+					BYTE notes[MAX_INSTRUMENTS];
+					for (int tick = 0; tick < ticks; tick++)
+					{
+						memset(notes, HLD, sizeof(notes));
+						notes[0] = pattern[tick % pattern.size()];
+						Go4kEngine_Tick(&engine, notes);
+						Go4kEngine_Render(&engine, &samples[(size_t)tick * samplespertick * 2], samplespertick);
+					}
+					Go4kEngine_Free(&engine);
+					char filename[1024];
+					snprintf(filename, sizeof(filename), "%s%d.raw", previewprefix, i);
+					FILE *file = fopen(filename, "wb");
+					rendered = file && fwrite(&samples[0], sizeof(float), samples.size(), file) == samples.size();
+					if (file)
+						fclose(file);
+				}
+				else
+					rendered = false;
+				if (!rendered)
+				{
+					fprintf(stderr, "Unable to render a preview of %s\n", filenames[i]);
+					failed++;
+				}
+				free(synth);
+			}
+		}));
+	}
+	for (size_t t = 0; t < pool.size(); t++)
+		pool[t].join();
+	return !failed;
+}
+
+int main(int argc, char *argv[])
+{
+	int samplespertick = 5512;	// 120 bpm, 16 ticks per pattern, 4 beats per pattern
+	int ticks = 64;
+	int voices = 1;				// MAX_VOICES in the generated 4klang.inc
+	const char *mode = "scalar";
+	const char *compiled = NULL;
+	int threads = 0;
+	const char *stemprefix = NULL;
+	const char *previewprefix = NULL;
+	bool optimize = false;
+	const char *reference = NULL;
+	double tolerance = 1.0e-4;
+	std::vector<BYTE> pattern;
+	parsePattern("60,1,1,1,1,1,1,1,0,0,0,0,67,1,0,0", pattern);
+
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg++)
+	{
+		if (strcmp(argv[arg], "-O") == 0)
+		{
+			optimize = true;
+			continue;
+		}
+		if (arg + 1 >= argc)
+		{
+			usage();
+			return 1;
+		}
+		const char *value = argv[++arg];
+		switch (argv[arg - 1][1])
+		{
+		case 's': samplespertick = atoi(value); break;
+		case 't': ticks = atoi(value); break;
+		case 'v': voices = atoi(value); break;
+		case 'm': mode = value; break;
+		case 'k': compiled = value; break;
+		case 'j': threads = atoi(value); break;
+		case 'S': stemprefix = value; break;
+		case 'x': previewprefix = value; break;
+		case 'c': reference = value; break;
+		case 'e': tolerance = atof(value); break;
+		case 'p':
+			if (!parsePattern(value, pattern))
+			{
+				fprintf(stderr, "Invalid pattern %s\n", value);
+				return 1;
+			}
+			break;
+		default:
+			usage();
+			return 1;
+		}
+	}
+	int instruments = argc - arg;
+	bool lanes = strcmp(mode, "lanes") == 0;
+	// -x is not limited to MAX_INSTRUMENTS, every preview is a song of its own
+	if (instruments < 1 || (instruments > MAX_INSTRUMENTS && !previewprefix) || samplespertick < 1 || ticks < 1 || (!lanes && strcmp(mode, "scalar")))
+	{
+		usage();
+		return 1;
+	}
+	if (previewprefix)
+	{
+		if (compiled || stemprefix || reference || lanes)
+		{
+			usage();
+			return 1;
+		}
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (threads < 1)
+			threads = (int)std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : 1;
+		if (threads > instruments)
+			threads = instruments;
+		bool rendered = renderPreviews(argv + arg, instruments, previewprefix, threads, optimize, voices, samplespertick, ticks, pattern);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		fprintf(stderr, "rendered %d previews of %.2f s in %.3f s on %d threads\n", instruments, (double)ticks * samplespertick / 44100,
+			(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9, threads);
+		return rendered ? 0 : 1;
+	}
+	for (int i = 0; i < instruments; i++)
+	{
+		if (!Go4kVSTi_LoadInstrument(argv[arg + i], (char)i))
+			return 1;
+	}
+	for (int i = 0; optimize && i < instruments; i++)
+	{
+		Go4kOptimizeReport report;
+		Go4kVSTi_OptimizeInstrument(&SynthObj, (char)i, &report);
+		fprintf(stderr, "%s: %d units removed, %d constants folded, ~%d cycles per voice and sample saved\n",
+			argv[arg + i], report.removed, report.folded, report.cyclessaved);
+	}
+
+	Go4kEngine engine;
+	if (!Go4kEngine_Init(&engine, &SynthObj, voices))
+	{
+		fprintf(stderr, "Unable to allocate %d delay lines\n", engine.delaylines);
+		return 1;
+	}
+	if (engine.delaylines)
+		fprintf(stderr, "%d delay lines in %.2f MB instead of %.2f MB with MAX_DELAY per line\n", engine.delaylines,
+			engine.delaysamples * sizeof(float) / 1048576.0, (double)engine.delaylines * (DELAY_WRK_BUFFER + MAX_DELAY) * sizeof(float) / 1048576.0);
+	if (compiled)
+	{
+		if (!loadCompiled(&engine, compiled))
+			return 1;
+		mode = "compiled";
+	}
+	int lanevoices = lanes ? Go4kEngine_PlanLanes(&engine) : 0;
+	if (lanevoices < 0)
+	{
+		fprintf(stderr, "Unable to allocate the lanes\n");
+		return 1;
+	}
+	int steminstruments = threads > 0 ? Go4kEngine_PlanStems(&engine, threads) : 0;
+
+	std::vector<float> samples((size_t)ticks * samplespertick * 2);
+	std::vector<std::vector<float> > stems(stemprefix ? instruments : 0);
+	float *stembuffers[MAX_INSTRUMENTS] = {};
+	for (size_t i = 0; i < stems.size(); i++)
+		stems[i].resize(samples.size());
+	BYTE notes[MAX_INSTRUMENTS];
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int tick = 0; tick < ticks; tick++)
+	{
+		memset(notes, HLD, sizeof(notes));
+		memset(notes, pattern[tick % pattern.size()], instruments);
+		for (size_t i = 0; i < stems.size(); i++)
+			stembuffers[i] = &stems[i][(size_t)tick * samplespertick * 2];
+		Go4kEngine_Tick(&engine, notes);
+		Go4kEngine_RenderStems(&engine, &samples[(size_t)tick * samplespertick * 2], stembuffers, samplespertick);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+	int stemtasks = engine.stemtasks;
+	Go4kEngine_Free(&engine);
+	fprintf(stderr, "rendered %.2f s in %.3f s (%s, %d voices in lanes, %d instruments in %d tasks on %d threads)\n",
+		(double)ticks * samplespertick / 44100, seconds, mode, lanevoices, steminstruments, stemtasks, threads > 0 ? threads : 1);
+
+	for (size_t i = 0; i < stems.size(); i++)
+	{
+		char filename[1024];
+		snprintf(filename, sizeof(filename), "%s%d.raw", stemprefix, (int)i);
+		FILE *file = fopen(filename, "wb");
+		if (!file)
+		{
+			fprintf(stderr, "Unable to open file %s\n", filename);
+			return 1;
+		}
+		fwrite(&stems[i][0], sizeof(float), stems[i].size(), file);
+		fclose(file);
+	}
+
+	if (reference)
+		return nullTest(samples, reference, tolerance) ? 0 : 1;
+
+	FILE *out = fdopen(fileno(stdout), "wb");
+	fwrite(&samples[0], sizeof(float), samples.size(), out);
+	fclose(out);
+	return 0;
+}
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <string.h>
+#include "./instrumentdisassembler.h"
+
+// Cost model of the units in 4klang.asm: the cycles per voice and sample of every unit variant,
+// a base and, for DLL units, a cost per delay line. The defaults are rough counts of the asm,
+// Go4kCost_Fit replaces them with the cycles a profiling build of 4klangrender measured.
+
+const char *Go4kCostVariantNames[COST_VARIANTS] = {
+	"NONE", "ENV", "VCO", "VCO_STEREO", "VCO_NOISE", "VCF", "VCF_STEREO", "DST", "DST_STEREO",
+	"DLL", "FOP", "FST", "FSTG", "PAN", "OUT", "ACC", "FLD", "GLITCH"
+};
+
+static const float defaultBase[COST_VARIANTS] = {
+	0, 60, 150, 300, 150, 40, 80, 60, 120, 80, 5, 10, 10, 15, 20, 10 * MAX_INSTRUMENTS, 8, 80
+};
+
+void Go4kCost_Init(Go4kCostModelP model)
+{
+	memset(model, 0, sizeof(Go4kCostModel));
+	memcpy(model->base, defaultBase, sizeof(defaultBase));
+	model->perline[COST_DLL] = 30;
+}
+
+int Go4kCost_Variant(const BYTE *unit, int instrument, int *lines)
+{
+	*lines = 0;
+	switch (unit[0])
+	{
+	case M_ENV:		return COST_ENV;
+	case M_VCO:
+	{
+		BYTE flags = ((VCO_valP)unit)->flags;
+		return flags & VCO_NOISE ? COST_VCO_NOISE : flags & VCO_STEREO ? COST_VCO_STEREO : COST_VCO;
+	}
+	case M_VCF:		return ((VCF_valP)unit)->type & VCF_STEREO ? COST_VCF_STEREO : COST_VCF;
+	case M_DST:		return ((DST_valP)unit)->stereo & VCF_STEREO ? COST_DST_STEREO : COST_DST;
+	case M_DLL:
+		// a count of 0 runs one line, like the delay lines of assembleBytecode
+		*lines = ((DLL_valP)unit)->count ? ((DLL_valP)unit)->count : 1;
+		return COST_DLL;
+	case M_FOP:		return COST_FOP;
+	case M_FST:
+	{
+		int dest = ((FST_valP)unit)->dest_stack;
+		return dest == -1 || dest == instrument || instrument < 0 ? COST_FST : COST_FSTG;
+	}
+	case M_PAN:		return COST_PAN;
+	case M_OUT:		return COST_OUT;
+	case M_ACC:		return COST_ACC;
+	case M_FLD:		return COST_FLD;
+	case M_GLITCH:	return COST_GLITCH;
+	}
+	return COST_NONE;
+}
+
+static Go4kCostModel DefaultCostModel()
+{
+	Go4kCostModel model;
+	Go4kCost_Init(&model);
+	return model;
+}
+
+float Go4kCost_Unit(Go4kCostModelP model, const BYTE *unit, int instrument)
+{
+	// initialized once, also when several threads estimate at the same time
+	static Go4kCostModel defaults = DefaultCostModel();
+	if (!model)
+		model = &defaults;
+	int lines;
+	int variant = Go4kCost_Variant(unit, instrument, &lines);
+	return model->base[variant] + model->perline[variant] * lines;
+}
+
+// per call cycles of every variant, weighted by the calls. the DLL cost is a line through the
+// line counts measured, with the default cost per line if they were all the same
+int Go4kCost_Fit(Go4kCostModelP model, const Go4kCostSample *samples, int count)
+{
+	double calls[COST_VARIANTS] = {}, cycles[COST_VARIANTS] = {};
+	double x[COST_VARIANTS] = {}, xx[COST_VARIANTS] = {}, xy[COST_VARIANTS] = {};
+	int fitted = 0;
+	for (int s = 0; s < count; s++)
+	{
+		const Go4kCostSample *sample = &samples[s];
+		if (!sample->calls || sample->variant <= COST_NONE || sample->variant >= COST_VARIANTS)
+			continue;
+		int v = sample->variant;
+		double percall = (double)sample->cycles / sample->calls;
+		calls[v] += sample->calls;
+		cycles[v] += sample->cycles;
+		x[v] += (double)sample->calls * sample->lines;
+		xx[v] += (double)sample->calls * sample->lines * sample->lines;
+		xy[v] += sample->calls * sample->lines * percall;
+		model->samples[v]++;
+		fitted++;
+	}
+	for (int v = COST_NONE + 1; v < COST_VARIANTS; v++)
+	{
+		if (!calls[v])
+			continue;
+		double meanx = x[v] / calls[v], meany = cycles[v] / calls[v];
+		double variance = xx[v] / calls[v] - meanx * meanx;
+		if (v == COST_DLL && variance > 1e-6)
+			model->perline[v] = (float)((xy[v] / calls[v] - meanx * meany) / variance);
+		model->base[v] = (float)(meany - model->perline[v] * meanx);
+	}
+	return fitted;
+}
+
+bool Go4kCost_Load(Go4kCostModelP model, const char *filename)
+{
+	FILE *file = fopen(filename, "r");
+	if (!file)
+		return false;
+	Go4kCost_Init(model);
+	char line[256], name[64];
+	float base, perline;
+	int samples;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#' || sscanf(line, "%63s %f %f %d", name, &base, &perline, &samples) != 4)
+			continue;
+		for (int v = COST_NONE + 1; v < COST_VARIANTS; v++)
+		{
+			if (strcmp(name, Go4kCostVariantNames[v]) == 0)
+			{
+				model->base[v] = base;
+				model->perline[v] = perline;
+				model->samples[v] = samples;
+			}
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+bool Go4kCost_Save(Go4kCostModelP model, FILE *file)
+{
+	fprintf(file, "# unit variant, cycles per voice and sample, per DLL delay line, units measured (0 for the default)\n");
+	for (int v = COST_NONE + 1; v < COST_VARIANTS; v++)
+		fprintf(file, "%-12s %10.2f %10.2f %6d\n", Go4kCostVariantNames[v], model->base[v], model->perline[v], model->samples[v]);
+	return !ferror(file);
+}
@@ -1,28 +1,118 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <string>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <iostream>
 #include "./instrumentdisassembler.h"
+#include "./go4kbytecode.h"
 
 using namespace std;
 
-DWORD versiontag10 = 0x30316b34; // 4k10
-DWORD versiontag11 = 0x31316b34; // 4k11
-//DWORD versiontag12 = 0x346b3132; // 4k12
-DWORD versiontag12 = 0x32316b34; // 4k12
-DWORD versiontag13 = 0x33316b34; // 4k13
-DWORD versiontag   = 0x34316b34; // 4k14
+// the delay times 4klang_inc.make.js emits, with 0 beyond the table
+static WORD defaultDelayTime(int index) {
+	return index < GO4K_DEFAULT_DELAY_TIMES ? Go4kDefaultDelayTimes[index] : 0;
+}
 
-SynthObject SynthObj;
+// plans the delay time table of the DLL and GLITCH units. every unit uses the run of count
+// times starting at its delay index, the runs are placed longest first, reusing equal runs
+// and overlapping the tail of the table. delay_indices maps the delay index of a unit to the
+// start of its run, -1 for unused ones. the first time is the note sync period, written by the
+// DLL units before they run, so runs starting there stay at 0. without a global chain the one of
+// 4klang_inc.make.js keeps its reverb at DELAY(0) and DELAY(8).
+// without compact, the table is the one of 4klang_inc.make.js and the indices stay as they are.
+static void planDelayTimes(SynthObjectP synth, std::vector<WORD> &delay_times, std::vector<int> &delay_indices, const bool *used, bool compact) {
+	int runs[256];
+	memset(runs, 0, sizeof(runs));
+	bool defaultGlobal = true;
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++) {
+		if (i < MAX_INSTRUMENTS && !used[i])
+			continue;
+		BYTE (*units)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		for (int u = 0; u < MAX_UNITS; u++) {
+			int count = 0;
+			if (units[u][0] == M_DLL)
+				count = ((DLL_valP)units[u])->count > 1 ? ((DLL_valP)units[u])->count : 1;
+			if (units[u][0] == M_GLITCH)
+				count = 1;
+			if (i == MAX_INSTRUMENTS && units[u][0] != M_NONE)
+				defaultGlobal = false;
+			int delay = units[u][0] == M_GLITCH ? ((GLITCH_valP)units[u])->delay : ((DLL_valP)units[u])->delay;
+			if (count > runs[delay])
+				runs[delay] = count;
+		}
+	}
 
-void disassembleInstruments() {
-	FILE *file = fdopen(fileno(stdout), "w");
-	/*fprintf(file, "%%ifdef USE_SECTIONS\n");
-	fprintf(file, "section .g4kmuc3 data align=1\n");
-	fprintf(file, "%%else\n");
-	fprintf(file, "section .data\n");
-	fprintf(file, "%%endif\n");
-	fprintf(file, "go4k_synth_instructions\n");*/
+	delay_times.clear();
+	delay_indices.assign(256, -1);
+	if (!compact) {
+		for (int d = 0; d < GO4K_DEFAULT_DELAY_TIMES; d++) {
+			delay_times.push_back(Go4kDefaultDelayTimes[d]);
+			delay_indices[d] = d;
+		}
+		return;
+	}
+
+	delay_times.push_back(0);
+	if (defaultGlobal) {
+		for (int d = 1; d < 16; d++)
+			delay_times.push_back(defaultDelayTime(d));
+		runs[0] = runs[0] > 8 ? runs[0] : 8;
+		runs[8] = runs[8] > 8 ? runs[8] : 8;
+	}
+	for (;;) {
+		// the pinned runs first, then the longest
+		int next = -1;
+		for (int d = 0; d < 256; d++) {
+			if (!runs[d] || delay_indices[d] >= 0)
+				continue;
+			bool pinned = d == 0 || (defaultGlobal && d == 8);
+			bool nextPinned = next == 0 || (defaultGlobal && next == 8);
+			if (next < 0 || (pinned && !nextPinned) || (pinned == nextPinned && runs[d] > runs[next]))
+				next = d;
+		}
+		if (next < 0)
+			break;
+
+		int count = runs[next];
+		int position = next;
+		if (!(next == 0 || (defaultGlobal && next == 8))) {
+			for (position = 1; position < (int)delay_times.size(); position++) {
+				int k = 0;
+				while (k < count && position + k < (int)delay_times.size() && delay_times[position + k] == defaultDelayTime(next + k))
+					k++;
+				if (k == count || position + k == (int)delay_times.size())
+					break;
+			}
+		}
+		for (int k = 0; k < count; k++) {
+			if (position + k >= (int)delay_times.size())
+				delay_times.push_back(defaultDelayTime(next + k));
+		}
+		delay_indices[next] = position;
+	}
+}
+
+// disassembles the instruments of synth to out, with compactDelays as a song of them named after filenames
+void disassembleInstruments(SynthObjectP synth, std::string &out, bool compactDelays, char *filenames[]) {
+	/*out += "%%ifdef USE_SECTIONS\n";
+	out += "section .g4kmuc3 data align=1\n";
+	out += "%%else\n";
+	out += "section .data\n";
+	out += "%%endif\n";
+	out += "go4k_synth_instructions\n";*/
 	char comstr[1024];
 	std::string CommandString;
 
@@ -34,9 +124,21 @@ void disassembleInstruments() {
 	int maxinst = 1;
 	bool InstrumentUsed[MAX_INSTRUMENTS];
 	int InstrumentIndex[MAX_INSTRUMENTS];
+	int usedInstruments = 0;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++)
+	{
+		InstrumentUsed[i] = false;
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			if (synth->InstrumentValues[i][u][0] != M_NONE)
+				InstrumentUsed[i] = true;
+		}
+		InstrumentIndex[i] = InstrumentUsed[i] ? usedInstruments++ : -1;
+	}
+	planDelayTimes(synth, delay_times, delay_indices, InstrumentUsed, compactDelays);
 #ifdef _8KLANG
 	// add primary plugin commands first
-	fprintf(file, "%s", mergeCommandString.c_str());
+	out += mergeCommandString;
 #endif
 	for (int i = 0; i < MAX_INSTRUMENTS; i++)
 	{
@@ -46,23 +148,23 @@ void disassembleInstruments() {
 		{
 			comstr[0] = 0;
 
-			// cout << "CMD " << i << " " << u << " " << (int)SynthObj.InstrumentValues[i][u][0] << endl;
+			// cout << "CMD " << i << " " << u << " " << (int)synth->InstrumentValues[i][u][0] << endl;
 			
-			if (SynthObj.InstrumentValues[i][u][0] == M_ENV)
+			if (synth->InstrumentValues[i][u][0] == M_ENV)
 				sprintf(comstr, "\tdb GO4K_ENV_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_VCO)
+			if (synth->InstrumentValues[i][u][0] == M_VCO)
 				sprintf(comstr, "\tdb GO4K_VCO_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_VCF)
+			if (synth->InstrumentValues[i][u][0] == M_VCF)
 				sprintf(comstr, "\tdb GO4K_VCF_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_DST)
+			if (synth->InstrumentValues[i][u][0] == M_DST)
 				sprintf(comstr, "\tdb GO4K_DST_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_DLL)
+			if (synth->InstrumentValues[i][u][0] == M_DLL)
 				sprintf(comstr, "\tdb GO4K_DLL_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_FOP)
+			if (synth->InstrumentValues[i][u][0] == M_FOP)
 				sprintf(comstr, "\tdb GO4K_FOP_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_FST)
+			if (synth->InstrumentValues[i][u][0] == M_FST)
 			{
-				FST_valP v = (FST_valP)(SynthObj.InstrumentValues[i][u]);
+				FST_valP v = (FST_valP)(synth->InstrumentValues[i][u]);
 				// local storage
 				if (v->dest_stack == -1 || v->dest_stack == i)
 					sprintf(comstr, "\tdb GO4K_FST_ID\n"); 
@@ -70,15 +172,15 @@ void disassembleInstruments() {
 				else
 					sprintf(comstr, "\tdb GO4K_FSTG_ID\n"); 
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_PAN)
+			if (synth->InstrumentValues[i][u][0] == M_PAN)
 				sprintf(comstr, "\tdb GO4K_PAN_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_OUT)
+			if (synth->InstrumentValues[i][u][0] == M_OUT)
 				sprintf(comstr, "\tdb GO4K_OUT_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_ACC)
+			if (synth->InstrumentValues[i][u][0] == M_ACC)
 				sprintf(comstr, "\tdb GO4K_ACC_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_FLD)
+			if (synth->InstrumentValues[i][u][0] == M_FLD)
 				sprintf(comstr, "\tdb GO4K_FLD_ID\n"); 
-			if (SynthObj.InstrumentValues[i][u][0] == M_GLITCH)
+			if (synth->InstrumentValues[i][u][0] == M_GLITCH)
 				sprintf(comstr, "\tdb GO4K_GLITCH_ID\n"); 
 
 			CommandString += comstr;
@@ -87,76 +189,98 @@ void disassembleInstruments() {
 	};
 	//fprintf(file, "%s", CommandString.c_str());
 
-	// fprintf(file, "GO4K_BEGIN_CMDDEF(Global)\n");
+	// out += "GO4K_BEGIN_CMDDEF(Global)\n";
 	for (int u = 0; u < MAX_UNITS; u++)
 	{
-		if (SynthObj.GlobalValues[u][0] == M_ENV)
-			fprintf(file, "\tdb GO4K_ENV_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_VCO)
-			fprintf(file, "\tdb GO4K_VCO_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_VCF)
-			fprintf(file, "\tdb GO4K_VCF_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_DST)
-			fprintf(file, "\tdb GO4K_DST_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_DLL)
-			fprintf(file, "\tdb GO4K_DLL_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_FOP)
-			fprintf(file, "\tdb GO4K_FOP_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_FST)
+		if (synth->GlobalValues[u][0] == M_ENV)
+			out += "\tdb GO4K_ENV_ID\n";
+		if (synth->GlobalValues[u][0] == M_VCO)
+			out += "\tdb GO4K_VCO_ID\n";
+		if (synth->GlobalValues[u][0] == M_VCF)
+			out += "\tdb GO4K_VCF_ID\n";
+		if (synth->GlobalValues[u][0] == M_DST)
+			out += "\tdb GO4K_DST_ID\n";
+		if (synth->GlobalValues[u][0] == M_DLL)
+			out += "\tdb GO4K_DLL_ID\n";
+		if (synth->GlobalValues[u][0] == M_FOP)
+			out += "\tdb GO4K_FOP_ID\n";
+		if (synth->GlobalValues[u][0] == M_FST)
 		{
-			FST_valP v = (FST_valP)(SynthObj.GlobalValues[u]);
+			FST_valP v = (FST_valP)(synth->GlobalValues[u]);
 			// local storage
 			if (v->dest_stack == -1 || v->dest_stack == MAX_INSTRUMENTS)
-				fprintf(file, "\tdb GO4K_FST_ID\n");
+				out += "\tdb GO4K_FST_ID\n";
 			// global storage
 			else
-				fprintf(file, "\tdb GO4K_FSTG_ID\n");
+				out += "\tdb GO4K_FSTG_ID\n";
 		}
-		if (SynthObj.GlobalValues[u][0] == M_PAN)
-			fprintf(file, "\tdb GO4K_PAN_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_OUT)
-			fprintf(file, "\tdb GO4K_OUT_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_ACC)
-			fprintf(file, "\tdb GO4K_ACC_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_FLD)
-			fprintf(file, "\tdb GO4K_FLD_ID\n");
-		if (SynthObj.GlobalValues[u][0] == M_GLITCH)
-			fprintf(file, "\tdb GO4K_GLITCH_ID\n");
-	}
-	// fprintf(file, "GO4K_END_CMDDEF\n");
-	// fprintf(file, "go4k_synth_instructions_end\n");
+		if (synth->GlobalValues[u][0] == M_PAN)
+			out += "\tdb GO4K_PAN_ID\n";
+		if (synth->GlobalValues[u][0] == M_OUT)
+			out += "\tdb GO4K_OUT_ID\n";
+		if (synth->GlobalValues[u][0] == M_ACC)
+			out += "\tdb GO4K_ACC_ID\n";
+		if (synth->GlobalValues[u][0] == M_FLD)
+			out += "\tdb GO4K_FLD_ID\n";
+		if (synth->GlobalValues[u][0] == M_GLITCH)
+			out += "\tdb GO4K_GLITCH_ID\n";
+	}
+	// out += "GO4K_END_CMDDEF\n";
+	// out += "go4k_synth_instructions_end\n";
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// the instrument data
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-	/*fprintf(file, "%%ifdef USE_SECTIONS\n");
-	fprintf(file, "section .g4kmuc4 data align=1\n");
-	fprintf(file, "%%else\n");
-	fprintf(file, "section .data\n");
-	fprintf(file, "%%endif\n");
-	fprintf(file, "go4k_synth_parameter_values\n");*/
+	/*out += "%%ifdef USE_SECTIONS\n";
+	out += "section .g4kmuc4 data align=1\n";
+	out += "%%else\n";
+	out += "section .data\n";
+	out += "%%endif\n";
+	out += "go4k_synth_parameter_values\n";*/
 	int delayindex = 0;
 	char valstr[1024];
 	std::string ValueString;
 #ifdef _8KLANG
 	// add primary plugin values first
-	fprintf(file, "%s", mergeValueString.c_str());
+	out += mergeValueString;
 #endif
+	if (compactDelays)
+	{
+		ValueString += "setDelayTimes([";
+		for (size_t d = 0; d < delay_times.size(); d++)
+		{
+			sprintf(valstr, "%s%d", d ? ", " : "", delay_times[d]); ValueString += valstr;
+		}
+		sprintf(valstr, "]); // %d delay times instead of %d\n", (int)delay_times.size(), GO4K_DEFAULT_DELAY_TIMES); ValueString += valstr;
+	}
 	for (int i = 0; i < MAX_INSTRUMENTS; i++)
 	{
 		if (!InstrumentUsed[i]) continue;
 		// sprintf(valstr, "GO4K_BEGIN_PARAMDEF(Instrument%d)\n", i + mergeMaxInst); ValueString += valstr;
+		if (compactDelays)
+		{
+			// named after the file, without path and extension
+			std::string name = filenames[i];
+			name = name.substr(name.find_last_of('/') + 1);
+			name = name.substr(0, name.find_last_of('.'));
+			for (size_t c = 0; c < name.size(); c++)
+			{
+				if (!isalnum((unsigned char)name[c]))
+					name[c] = '_';
+			}
+			ValueString += "addInstrument('" + name + "', `\n";
+		}
 		for (int u = 0; u < MAX_UNITS; u++)
 		{
 			valstr[0] = 0;
 
-			if (SynthObj.InstrumentValues[i][u][0] == M_ENV)
+			if (synth->InstrumentValues[i][u][0] == M_ENV)
 			{
-				ENV_valP v = (ENV_valP)(SynthObj.InstrumentValues[i][u]);
+				ENV_valP v = (ENV_valP)(synth->InstrumentValues[i][u]);
 				sprintf(valstr, "\tGO4K_ENV\tATTAC(%d),DECAY(%d),SUSTAIN(%d),RELEASE(%d),GAIN(%d)\n", v->attac, v->decay, v->sustain, v->release, v->gain);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_VCO)
+			if (synth->InstrumentValues[i][u][0] == M_VCO)
 			{
-				VCO_valP v = (VCO_valP)(SynthObj.InstrumentValues[i][u]);
+				VCO_valP v = (VCO_valP)(synth->InstrumentValues[i][u]);
 				char type[16]; type[0] = 0;
 				char lfo[16]; lfo[0] = 0;
 				char stereo[16]; stereo[0] = 0;
@@ -176,9 +300,9 @@ void disassembleInstruments() {
 					sprintf(stereo, "|VCO_STEREO");
 				sprintf(valstr, "\tGO4K_VCO\tTRANSPOSE(%d),DETUNE(%d),PHASE(%d),GATES(%d),COLOR(%d),SHAPE(%d),GAIN(%d),FLAGS(%s%s%s)\n", v->transpose, v->detune, v->phaseofs, v->gate, v->color, v->shape, v->gain, type, lfo, stereo);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_VCF)
+			if (synth->InstrumentValues[i][u][0] == M_VCF)
 			{
-				VCF_valP v = (VCF_valP)(SynthObj.InstrumentValues[i][u]);
+				VCF_valP v = (VCF_valP)(synth->InstrumentValues[i][u]);
 				char type[16]; type[0] = 0;
 				char stereo[16]; stereo[0] = 0;
 				int t = v->type & ~VCF_STEREO;
@@ -198,15 +322,15 @@ void disassembleInstruments() {
 					sprintf(stereo, "|STEREO");
 				sprintf(valstr, "\tGO4K_VCF\tFREQUENCY(%d),RESONANCE(%d),VCFTYPE(%s%s)\n", v->freq, v->res, type, stereo);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_DST)
+			if (synth->InstrumentValues[i][u][0] == M_DST)
 			{
-				DST_valP v = (DST_valP)(SynthObj.InstrumentValues[i][u]);
+				DST_valP v = (DST_valP)(synth->InstrumentValues[i][u]);
 				sprintf(valstr, "\tGO4K_DST\tDRIVE(%d), SNHFREQ(%d), FLAGS(%s)\n", v->drive, v->snhfreq, v->stereo & VCF_STEREO ? "STEREO" : "0");
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_DLL)
+			if (synth->InstrumentValues[i][u][0] == M_DLL)
 			{
-				DLL_valP v = (DLL_valP)(SynthObj.InstrumentValues[i][u]);
-				if (v->delay < delay_indices.size())
+				DLL_valP v = (DLL_valP)(synth->InstrumentValues[i][u]);
+				if (v->delay < delay_indices.size() && delay_indices[v->delay] >= 0)
 				{
 					sprintf(valstr, "\tGO4K_DLL\tPREGAIN(%d),DRY(%d),FEEDBACK(%d),DAMP(%d),FREQUENCY(%d),DEPTH(%d),DELAY(%d),COUNT(%d)\n", 
 						v->pregain, v->dry, v->feedback, v->damp, v->freq, v->depth, delay_indices[v->delay], v->count);	
@@ -218,9 +342,9 @@ void disassembleInstruments() {
 						v->pregain, v->dry, v->feedback, v->damp, v->freq, v->depth, v->delay, v->count);
 				}
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_FOP)
+			if (synth->InstrumentValues[i][u][0] == M_FOP)
 			{
-				FOP_valP v = (FOP_valP)(SynthObj.InstrumentValues[i][u]);
+				FOP_valP v = (FOP_valP)(synth->InstrumentValues[i][u]);
 				char type[16]; type[0] = 0;
 				if (v->flags == FOP_POP)
 					sprintf(type, "FOP_POP");
@@ -244,9 +368,9 @@ void disassembleInstruments() {
 					sprintf(type, "FOP_MULP2");
 				sprintf(valstr, "\tGO4K_FOP\tOP(%s)\n", type);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_FST)
+			if (synth->InstrumentValues[i][u][0] == M_FST)
 			{
-				FST_valP v = (FST_valP)(SynthObj.InstrumentValues[i][u]);
+				FST_valP v = (FST_valP)(synth->InstrumentValues[i][u]);
 				// local storage
 				if (v->dest_stack == -1 || v->dest_stack == i)
 				{
@@ -254,7 +378,7 @@ void disassembleInstruments() {
 					int emptySkip = 0;
 					for (int e = 0; e < v->dest_unit; e++)
 					{
-						if (SynthObj.InstrumentValues[i][e][0] == M_NONE)
+						if (synth->InstrumentValues[i][e][0] == M_NONE)
 							emptySkip++;
 					}
 					std::string modes;
@@ -281,12 +405,12 @@ void disassembleInstruments() {
 					{
 						if (v->dest_stack == MAX_INSTRUMENTS)
 						{
-							if (SynthObj.GlobalValues[e][0] == M_NONE)
+							if (synth->GlobalValues[e][0] == M_NONE)
 								emptySkip++;
 						}
 						else
 						{
-							if (SynthObj.InstrumentValues[v->dest_stack][e][0] == M_NONE)
+							if (synth->InstrumentValues[v->dest_stack][e][0] == M_NONE)
 								emptySkip++;
 						}
 					}
@@ -309,33 +433,33 @@ void disassembleInstruments() {
 					}
 				}
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_PAN)
+			if (synth->InstrumentValues[i][u][0] == M_PAN)
 			{
-				PAN_valP v = (PAN_valP)(SynthObj.InstrumentValues[i][u]);
+				PAN_valP v = (PAN_valP)(synth->InstrumentValues[i][u]);
 				sprintf(valstr, "\tGO4K_PAN\tPANNING(%d)\n", v->panning);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_OUT)
+			if (synth->InstrumentValues[i][u][0] == M_OUT)
 			{
-				OUT_valP v = (OUT_valP)(SynthObj.InstrumentValues[i][u]);
+				OUT_valP v = (OUT_valP)(synth->InstrumentValues[i][u]);
 				sprintf(valstr, "\tGO4K_OUT\tGAIN(%d), AUXSEND(%d)\n", v->gain, v->auxsend);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_ACC)
+			if (synth->InstrumentValues[i][u][0] == M_ACC)
 			{
-				ACC_valP v = (ACC_valP)(SynthObj.InstrumentValues[i][u]);
+				ACC_valP v = (ACC_valP)(synth->InstrumentValues[i][u]);
 				if (v->flags == ACC_OUT)
 					sprintf(valstr, "\tGO4K_ACC\tACCTYPE(OUTPUT)\n");
 				else
 					sprintf(valstr, "\tGO4K_ACC\tACCTYPE(AUX)\n");
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_FLD)
+			if (synth->InstrumentValues[i][u][0] == M_FLD)
 			{
-				FLD_valP v = (FLD_valP)(SynthObj.InstrumentValues[i][u]);
+				FLD_valP v = (FLD_valP)(synth->InstrumentValues[i][u]);
 				sprintf(valstr, "\tGO4K_FLD\tVALUE(%d)\n", v->value);
 			}
-			if (SynthObj.InstrumentValues[i][u][0] == M_GLITCH)
+			if (synth->InstrumentValues[i][u][0] == M_GLITCH)
 			{
-				GLITCH_valP v = (GLITCH_valP)(SynthObj.InstrumentValues[i][u]);
-				if (v->delay < delay_indices.size())
+				GLITCH_valP v = (GLITCH_valP)(synth->InstrumentValues[i][u]);
+				if (v->delay < delay_indices.size() && delay_indices[v->delay] >= 0)
 				{
 					sprintf(valstr, "\tGO4K_GLITCH\tACTIVE(%d),DRY(%d),SLICEFACTOR(%d),PITCHFACTOR(%d),SLICESIZE(%d)\n", 
 						v->active, v->dry, v->dsize, v->dpitch, delay_indices[v->delay]);	
@@ -351,94 +475,712 @@ void disassembleInstruments() {
 			ValueString += valstr;
 		}
 		// sprintf(valstr, "GO4K_END_PARAMDEF\n"); ValueString += valstr;
+		if (compactDelays)
+			ValueString += "`);\n";
 	}
-	fprintf(file, "%s", ValueString.c_str());
+	out += ValueString;
 }
 
-// load instrumen data to specified channel
-bool Go4kVSTi_LoadInstrument(char* filename, char channel)
-{
-	FILE *file = fopen(filename, "rb");
-	if (file)
-	{
+// bytecode backend: the command and parameter streams 4klang.inc assembles for a song of the
+// loaded instruments (see -song), for 4klangrender to load without yasm, see go4kbytecode.h
 
-		DWORD version = 0;
-		bool version10 = false;
-		bool version11 = false;
-		bool version12 = false;
-		bool version13 = false;
-		fread(&version, 1, 4, file);		
-		// printf("%2x %2x\n", (int)version, (int)versiontag);
-		if (versiontag != version) // 4k10
-		{
-			// version 1.3 file
-			if (version == versiontag13)
-			{
-				// only mulp2 unit added and layout for instruments changed, no need for message
-				//MessageBox(0,"Autoconvert. Please save file again", "1.3 File Format", MB_OK | MB_SETFOREGROUND);
-				version13 = true;
-			}
-			// version 1.2 file
-			else if (version == versiontag12)
-			{
-				// only fld unit added, no need for message
-				//MessageBox(0,"Autoconvert. Please save file again", "1.2 File Format", MB_OK | MB_SETFOREGROUND);
-				version12 = true;
-				version13 = true;
-			}
-			// version 1.1 file
-			else if (version == versiontag11)
-			{
-				version11 = true;
-				version12 = true;
-				version13 = true;
+// the global chain of 4klang_inc.make.js, for instruments without one
+static const BYTE defaultGlobalUnits[][MAX_UNIT_SLOTS] = {
+	{ M_ACC, ACC_AUX },
+	{ M_DLL, 55, 70, 100, 64, 0, 0, 0, 8 },
+	{ M_FOP, FOP_XCH },
+	{ M_DLL, 55, 70, 100, 64, 0, 0, 8, 8 },
+	{ M_FOP, FOP_XCH },
+	{ M_ACC, ACC_OUT },
+	{ M_FOP, FOP_ADDP2 },
+	{ M_OUT, 128, 0 },
+};
+
+// the db/dw of a GO4K_ macro, with the FST and FSTG destinations as 4klang.asm addresses them
+static void assembleUnit(SynthObjectP synth, const BYTE (*units)[MAX_UNIT_SLOTS], int i, int u,
+		const std::vector<int> &delay_indices, const int *InstrumentIndex, int usedInstruments,
+		std::string &commands, std::string &values) {
+	const BYTE *unit = units[u];
+	BYTE id = unit[0];
+	int bytes = 0;
+	BYTE b[8];
+	switch (id) {
+	case M_ENV:
+	case M_GLITCH:
+		memcpy(b, unit + 1, 5);
+		bytes = 5;
+		break;
+	case M_VCO: {
+		VCO_valP v = (VCO_valP)unit;
+		// the waveform the macros keep, see disassembleInstruments
+		static const BYTE types[] = { VCO_SINE, VCO_TRISAW, VCO_PULSE, VCO_NOISE, VCO_GATE };
+		BYTE type = 0;
+		for (int t = 0; t < 5; t++) {
+			if (v->flags & types[t])
+				type = types[t];
+		}
+		BYTE vco[8] = { v->transpose, v->detune, v->phaseofs, v->gate, v->color, v->shape, v->gain,
+			(BYTE)(type | (v->flags & (VCO_LFO | VCO_STEREO))) };
+		memcpy(b, vco, 8);
+		bytes = 8;
+		break;
+	}
+	case M_VCF:
+	case M_DST:
+		memcpy(b, unit + 1, 3);
+		if (id == M_DST)
+			b[2] = unit[3] & VCF_STEREO ? 0x10 : 0;
+		bytes = 3;
+		break;
+	case M_DLL:
+		memcpy(b, unit + 1, 8);
+		bytes = 8;
+		break;
+	case M_FOP:
+	case M_PAN:
+	case M_FLD:
+		b[0] = unit[1];
+		bytes = 1;
+		break;
+	case M_OUT:
+		memcpy(b, unit + 1, 2);
+		bytes = 2;
+		break;
+	case M_ACC:
+		b[0] = ((ACC_valP)unit)->flags == ACC_OUT ? 0 : 8;
+		bytes = 1;
+		break;
+	case M_FST: {
+		FST_valP v = (FST_valP)unit;
+		bool local = v->dest_stack == -1 || v->dest_stack == i;
+		const BYTE (*target)[MAX_UNIT_SLOTS] = local ? units : v->dest_stack == MAX_INSTRUMENTS ? synth->GlobalValues : synth->InstrumentValues[(int)v->dest_stack];
+		int emptySkip = 0;
+		for (int e = 0; e < v->dest_unit; e++) {
+			if (target[e][0] == M_NONE)
+				emptySkip++;
+		}
+		int dest = (v->dest_unit - emptySkip) * MAX_UNIT_SLOTS + v->dest_slot;
+		if (v->type & FST_ADD)
+			dest += 0x4000;
+		if (v->type & FST_POP)
+			dest += 0x8000;
+		b[0] = v->amount;
+		if (!local) {
+			// dword in go4k_synth_wrk: (instrument*go4k_instrument.size*MAX_VOICES/4)+unit slot+(go4k_instrument.workspace/4)
+			int stack = v->dest_stack == MAX_INSTRUMENTS ? usedInstruments : InstrumentIndex[(int)v->dest_stack];
+			dest += stack * (int)(sizeof(InstrumentWorkspace) / 4) + 2;
+			id = GO4K_BYTECODE_FSTG;
+			// invalid store target, possibly due non usage of the target instrument
+			if (stack < 0) {
+				b[0] = 0;
+				dest = 7 * 4 + 8;
 			}
-			// version 1.0 file
-			else if (version == versiontag10)
-			{
-				version10 = true;
-				version11 = true;
-				version12 = true;
-				version13 = true;
+		}
+		b[1] = dest & 0xff;
+		b[2] = (dest >> 8) & 0xff;
+		bytes = 3;
+		break;
+	}
+	default:
+		return;
+	}
+	if (id == M_DLL || id == M_GLITCH) {
+		int delay = id == M_DLL ? ((DLL_valP)unit)->delay : ((GLITCH_valP)unit)->delay;
+		if (delay_indices[delay] >= 0)
+			b[id == M_DLL ? 6 : 4] = (BYTE)delay_indices[delay];
+	}
+	commands += (char)id;
+	values.append((const char *)b, bytes);
+}
+
+// writes the bytecode of the loaded instruments to out, returns the number of delay lines
+int assembleBytecode(SynthObjectP synth, std::string &out) {
+	bool InstrumentUsed[MAX_INSTRUMENTS];
+	int InstrumentIndex[MAX_INSTRUMENTS];
+	int usedInstruments = 0;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++) {
+		InstrumentUsed[i] = false;
+		for (int u = 0; u < MAX_UNITS; u++) {
+			if (synth->InstrumentValues[i][u][0] != M_NONE)
+				InstrumentUsed[i] = true;
+		}
+		InstrumentIndex[i] = InstrumentUsed[i] ? usedInstruments++ : -1;
+	}
+	std::vector<WORD> delay_times;
+	std::vector<int> delay_indices;
+	planDelayTimes(synth, delay_times, delay_indices, InstrumentUsed, true);
+
+	bool defaultGlobal = true;
+	for (int u = 0; u < MAX_UNITS; u++) {
+		if (synth->GlobalValues[u][0] != M_NONE)
+			defaultGlobal = false;
+	}
+	std::string commands, values;
+	int delaylines = 0;
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++) {
+		if (i < MAX_INSTRUMENTS && !InstrumentUsed[i])
+			continue;
+		const BYTE (*units)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		int count = MAX_UNITS;
+		if (i == MAX_INSTRUMENTS && defaultGlobal) {
+			units = defaultGlobalUnits;
+			count = sizeof(defaultGlobalUnits) / sizeof(defaultGlobalUnits[0]);
+		}
+		for (int u = 0; u < count; u++) {
+			assembleUnit(synth, units, i, u, delay_indices, InstrumentIndex, usedInstruments, commands, values);
+			if (units[u][0] == M_DLL)
+				delaylines += ((DLL_valP)units[u])->count ? ((DLL_valP)units[u])->count : 1;
+			if (units[u][0] == M_GLITCH)
+				delaylines++;
+		}
+		// GO4K_END_CMDDEF
+		commands += (char)0;
+	}
+
+	Go4kBytecodeHeader header;
+	memcpy(header.magic, GO4K_BYTECODE_MAGIC, 4);
+	header.version = GO4K_BYTECODE_VERSION;
+	header.instruments = (unsigned short)usedInstruments;
+	header.delaylines = (unsigned short)delaylines;
+	header.delaytimes = (unsigned short)delay_times.size();
+	header.commands = (unsigned int)commands.size();
+	header.values = (unsigned int)values.size();
+	out.assign((const char *)&header, sizeof(header));
+	out += commands;
+	out += values;
+	out.append((const char *)&delay_times[0], delay_times.size() * sizeof(WORD));
+	return delaylines;
+}
+
+// cost estimate: the units of an instrument in the order of its command stream, for the global
+// chain the one of 4klang_inc.make.js if it has no units
+static void costUnits(SynthObjectP synth, int i, std::vector<const BYTE *> &units) {
+	const BYTE (*values)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+	int count = MAX_UNITS;
+	units.clear();
+	for (int u = 0; u < count; u++) {
+		if (values[u][0] != M_NONE && values[u][0] < NUM_MODULES)
+			units.push_back(values[u]);
+	}
+	if (i == MAX_INSTRUMENTS && units.empty()) {
+		for (size_t u = 0; u < sizeof(defaultGlobalUnits) / sizeof(defaultGlobalUnits[0]); u++)
+			units.push_back(defaultGlobalUnits[u]);
+	}
+}
+
+// prints the estimated cycles per sample of the loaded instruments, with voices each, and of the global chain
+static void printCost(SynthObjectP synth, Go4kCostModelP model, int instruments, char *filenames[], int voices) {
+	std::vector<const BYTE *> units;
+	double total = 0;
+	printf("%-40s %10s %7s %10s\n", "instrument", "per voice", "voices", "cycles");
+	for (int i = 0; i <= instruments; i++) {
+		int channel = i < instruments ? i : MAX_INSTRUMENTS;
+		int count = i < instruments ? voices : 1;
+		costUnits(synth, channel, units);
+		double cycles = 0;
+		for (size_t u = 0; u < units.size(); u++)
+			cycles += Go4kCost_Unit(model, units[u], channel);
+		total += cycles * count;
+		printf("%-40s %10.0f %7d %10.0f\n", i < instruments ? filenames[i] : "global", cycles, count, cycles * count);
+	}
+	printf("%-40s %10s %7s %10.0f  %.1f Mcycles per second at 44100 Hz\n", "total", "", "", total, total * 44100 / 1e6);
+}
+
+// fits the cost model to the unit cycles that a profiling build of 4klangrender wrote with -U, playing
+// the bytecode (or song) of the loaded instruments. the streams are the ones of assembleBytecode, without
+// the instruments that have no units, and the units that don't match them are left out
+static int calibrateCost(SynthObjectP synth, Go4kCostModelP model, const char *filename) {
+	FILE *file = fopen(filename, "r");
+	if (!file) {
+		fprintf(stderr, "Unable to open %s\n", filename);
+		return -1;
+	}
+	std::vector<int> channels;
+	for (int i = 0; i < MAX_INSTRUMENTS; i++) {
+		for (int u = 0; u < MAX_UNITS; u++) {
+			if (synth->InstrumentValues[i][u][0] != M_NONE) {
+				channels.push_back(i);
+				break;
 			}
-			// newer format than supported
+		}
+	}
+	channels.push_back(MAX_INSTRUMENTS);
+	std::vector<std::vector<const BYTE *> > streams(channels.size());
+	for (size_t s = 0; s < channels.size(); s++)
+		costUnits(synth, channels[s], streams[s]);
+
+	std::vector<Go4kCostSample> samples;
+	int stream, slot, command, mismatched = 0;
+	unsigned long long calls, cycles;
+	while (fscanf(file, "%d %d %d %llu %llu", &stream, &slot, &command, &calls, &cycles) == 5) {
+		if (stream < 0 || stream >= (int)streams.size() || slot < 0 || slot >= (int)streams[stream].size()) {
+			mismatched++;
+			continue;
+		}
+		Go4kCostSample sample;
+		const BYTE *unit = streams[stream][slot];
+		sample.variant = Go4kCost_Variant(unit, channels[stream], &sample.lines);
+		if (command != (sample.variant == COST_FSTG ? GO4K_BYTECODE_FSTG : unit[0])) {
+			mismatched++;
+			continue;
+		}
+		sample.calls = calls;
+		sample.cycles = cycles;
+		samples.push_back(sample);
+	}
+	fclose(file);
+	int fitted = Go4kCost_Fit(model, samples.empty() ? NULL : &samples[0], (int)samples.size());
+	fprintf(stderr, "%d units calibrated, %d don't match the instruments\n", fitted, mismatched);
+	return fitted;
+}
+
+// C++ backend: one function per loaded instrument, calling the unit kernels of go4kkernels.h
+// with the unit bytes as template arguments, so the compiler folds the parameters and flags
+static void generateInstrumentFunction(SynthObjectP synth, FILE *file, int i, const char *declaration) {
+	static const char *unitNames[NUM_MODULES] = { "", "ENV", "VCO", "VCF", "DST", "DLL", "FOP", "FST", "PAN", "OUT", "ACC", "FLD", "GLITCH" };
+	fprintf(file, "%s(Go4kEngineP engine, InstrumentWorkspaceP voice)\n{\n", declaration);
+	fprintf(file, "\tfloat *wrk = voice->workspace;\n");
+	fprintf(file, "\tengine->sp = STACK_GUARD;\n");
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		BYTE *unit = synth->InstrumentValues[i][u];
+		if (unit[0] == M_NONE || unit[0] >= NUM_MODULES)
+			continue;
+
+		// the kernels read up to byte 8, Go4kConstUnit fills in the trailing zeros
+		int last = 1;
+		for (int b = 0; b < MAX_UNIT_SLOTS; b++)
+		{
+			if (unit[b])
+				last = b;
+		}
+		std::string constUnit = "Go4kConstUnit<";
+		for (int b = 0; b <= last; b++)
+		{
+			char byte[8];
+			sprintf(byte, "%s%d", b ? ", " : "", unit[b]);
+			constUnit += byte;
+		}
+		constUnit += ">()";
+
+		char wrk[64];
+		sprintf(wrk, "wrk + %d * MAX_UNIT_SLOTS", u);
+		const char *args = "engine, %s, %s, voice";
+		char call[1024];
+		switch (unit[0])
+		{
+		case M_FOP:
+			sprintf(call, "Go4kFOP(engine, %s, voice)", constUnit.c_str());
+			break;
+		case M_ACC:
+			sprintf(call, "Go4kACC(engine, %s)", constUnit.c_str());
+			break;
+		case M_PAN:
+		case M_FLD:
+		case M_GLITCH:
+			sprintf(call, "Go4k%s(engine, %s, %s)", unitNames[unit[0]], constUnit.c_str(), wrk);
+			break;
+		case M_FST:
+		{
+			FST_valP v = (FST_valP)unit;
+			int slot = v->dest_unit * MAX_UNIT_SLOTS + v->dest_slot;
+			// global storage
+			if (v->dest_stack != -1 && v->dest_stack != i)
+				sprintf(call, "Go4kFSTG(engine, %s, voice)", constUnit.c_str());
+			// local storage, an invalid target only keeps the stack effect
+			else if (v->dest_unit >= 0 && slot < MAX_UNITS * MAX_UNIT_SLOTS)
+				sprintf(call, "Go4kFST(engine, %s, wrk + %d * MAX_UNIT_SLOTS + %d)", constUnit.c_str(), (int)v->dest_unit, (int)v->dest_slot);
 			else
-			{
-				printf("newer format than supported\n");
-				fclose(file);
-				return false;
-			}
+				sprintf(call, "Go4kFST(engine, %s, NULL)", constUnit.c_str());
+			break;
 		}
-		
-		if (channel < 16)
+		default:
+			sprintf(call, "Go4k%s(", unitNames[unit[0]]);
+			sprintf(call + strlen(call), args, constUnit.c_str(), wrk);
+			strcat(call, ")");
+			break;
+		}
+		fprintf(file, "\t%s;\n", call);
+	}
+	fprintf(file, "}\n");
+}
+
+void generateInstrumentsCpp(SynthObjectP synth, int instruments, char *filenames[]) {
+	FILE *file = fdopen(fileno(stdout), "w");
+	fprintf(file, "// generated by instrumentdisassembler -cpp, build with\n");
+	fprintf(file, "// g++ -O3 -march=native -fPIC -shared -I<4klang/tools> instruments.cpp -o instruments.so\n");
+	fprintf(file, "// (-ffp-contract=off renders bit-exact with the interpreter), and render with\n");
+	fprintf(file, "// go4krender -k instruments.so, loading the instruments in the same order\n");
+	fprintf(file, "#include \"go4kkernels.h\"\n");
+
+	for (int i = 0; i < instruments; i++)
+	{
+		char declaration[64];
+		sprintf(declaration, "static void Instrument%d", i);
+		fprintf(file, "\n// %s\n", filenames[i]);
+		generateInstrumentFunction(synth, file, i, declaration);
+	}
+
+	fprintf(file, "\nextern \"C\" void go4k_compiled_instruments(Go4kVoiceFunction functions[MAX_INSTRUMENTS])\n{\n");
+	for (int i = 0; i < instruments; i++)
+		fprintf(file, "\tfunctions[%d] = Instrument%d;\n", i, i);
+	fprintf(file, "}\n");
+	fflush(file);
+}
+
+// FNV-1a over the unit chain of an instrument and its channel, which decides local and global stores
+static unsigned long long hashInstrument(SynthObjectP synth, int channel) {
+	unsigned long long hash = 14695981039346656037ULL;
+	const BYTE *data = &synth->InstrumentValues[channel][0][0];
+	for (int b = -1; b < MAX_UNITS * MAX_UNIT_SLOTS; b++) {
+		hash ^= b < 0 ? (BYTE)channel : data[b];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// C++ backend with a build cache: every instrument goes to cachedir/go4k_<hash>.cpp, named after
+// the hash of its unit chain, unless cachedir/go4k_<hash>.o is there already. only the table of
+// go4k_compiled_instruments goes to stdout, see kernelbuild.sh
+void generateInstrumentsCppCached(SynthObjectP synth, int instruments, char *filenames[], const char *cachedir) {
+	std::vector<unsigned long long> hashes;
+	int cached = 0;
+	for (int i = 0; i < instruments; i++)
+	{
+		hashes.push_back(hashInstrument(synth, i));
+		char name[64], path[1024];
+		sprintf(name, "go4k_%016llx", hashes[i]);
+		snprintf(path, sizeof(path), "%s/%s.o", cachedir, name);
+		if (access(path, R_OK) == 0)
 		{
-			fread(SynthObj.InstrumentNames[channel], 1, 64, file);
-			
-			if (version13)
-			{
-				BYTE dummyBuf[16];
-				for (int j = 0; j < 32; j++) // 1.3 format had 32 units
-				{
-					fread(SynthObj.InstrumentValues[channel][j], 1, 16, file); // 1.3 format had 32 unit slots, but not fully used
-					fread(dummyBuf, 1, 16, file); // 1.3 read remaining block to dummy
+			cached++;
+			continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s.cpp", cachedir, name);
+		FILE *file = fopen(path, "w");
+		if (!file)
+		{
+			fprintf(stderr, "Unable to write %s\n", path);
+			continue;
+		}
+		fprintf(file, "// %s, generated by instrumentdisassembler -cpp -cache\n", filenames[i]);
+		fprintf(file, "#include \"go4kkernels.h\"\n\n");
+		std::string declaration = std::string("extern \"C\" void ") + name;
+		generateInstrumentFunction(synth, file, i, declaration.c_str());
+		fclose(file);
+	}
+
+	// the table needs no kernels, so it builds in no time
+	printf("// generated by instrumentdisassembler -cpp -cache %s\n", cachedir);
+	printf("struct Go4kEngine;\nstruct InstrumentWorkspace;\n");
+	printf("typedef void (*Go4kVoiceFunction)(struct Go4kEngine *engine, struct InstrumentWorkspace *voice);\n");
+	for (int i = 0; i < instruments; i++)
+		printf("extern \"C\" void go4k_%016llx(struct Go4kEngine *engine, struct InstrumentWorkspace *voice);\n", hashes[i]);
+	printf("\nextern \"C\" void go4k_compiled_instruments(Go4kVoiceFunction functions[%d])\n{\n", MAX_INSTRUMENTS);
+	for (int i = 0; i < instruments; i++)
+		printf("\tfunctions[%d] = go4k_%016llx;\t// %s\n", i, hashes[i], filenames[i]);
+	printf("}\n");
+	fprintf(stderr, "%d of %d instruments cached\n", cached, instruments);
+}
+
+// batch mode: the .4ki files of files, directories (searched recursively) and glob patterns
+static void collectFiles(const char *path, std::vector<std::string> &files) {
+	struct stat status;
+	if (stat(path, &status) != 0) {
+		glob_t matches;
+		if (glob(path, 0, NULL, &matches) == 0) {
+			for (size_t m = 0; m < matches.gl_pathc; m++)
+				collectFiles(matches.gl_pathv[m], files);
+		}
+		// no match, fails to load
+		else
+			files.push_back(path);
+		globfree(&matches);
+		return;
+	}
+	if (!S_ISDIR(status.st_mode)) {
+		files.push_back(path);
+		return;
+	}
+
+	DIR *dir = opendir(path);
+	if (!dir)
+		return;
+	std::vector<std::string> entries;
+	while (struct dirent *entry = readdir(dir)) {
+		std::string name = entry->d_name;
+		if (name == "." || name == "..")
+			continue;
+		std::string child = std::string(path) + "/" + name;
+		bool instrument = name.size() > 4 && strcasecmp(name.c_str() + name.size() - 4, ".4ki") == 0;
+		if (instrument || (stat(child.c_str(), &status) == 0 && S_ISDIR(status.st_mode)))
+			entries.push_back(child);
+	}
+	closedir(dir);
+	std::sort(entries.begin(), entries.end());
+	for (size_t e = 0; e < entries.size(); e++)
+		collectFiles(entries[e].c_str(), files);
+}
+
+// loads a .4ki file from a mapping of it to channel 0 of synth, in any of the layouts of the loader
+static bool loadMapped(SynthObjectP synth, const char *filename) {
+	bool loaded = false;
+	int fd = open(filename, O_RDONLY);
+	struct stat status;
+	if (fd >= 0 && fstat(fd, &status) == 0 && status.st_size > 0) {
+		void *data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			loaded = Go4kVSTi_LoadInstrumentData(synth, (const BYTE *)data, status.st_size, 0);
+			munmap(data, status.st_size);
+		}
+	}
+	if (fd >= 0)
+		close(fd);
+	return loaded;
+}
+
+// disassembles the files on a pool of threads, each with its own SynthObject, and writes them to
+// outdir/<name>.inc (like convertinstrs.sh) or, without outdir, all of them in order to stdout
+static int disassembleBatch(const std::vector<std::string> &files, const char *outdir, int threads, bool optimize) {
+	std::vector<std::string> outputs(outdir ? 0 : files.size());
+	std::atomic<int> next(0);
+	std::atomic<int> failed(0);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	std::vector<std::thread> pool;
+	for (int t = 0; t < threads; t++) {
+		pool.push_back(std::thread([&]() {
+			SynthObjectP synth = (SynthObjectP)calloc(1, sizeof(SynthObject));
+			for (int f; synth && (f = next++) < (int)files.size(); ) {
+				const char *filename = files[f].c_str();
+				if (!loadMapped(synth, filename)) {
+					fprintf(stderr, "Unable to load %s\n", filename);
+					failed++;
+					continue;
 				}
+				if (optimize) {
+					Go4kOptimizeReport report;
+					Go4kVSTi_OptimizeInstrument(synth, 0, &report);
+				}
+
+				std::string text;
+				disassembleInstruments(synth, text, false, NULL);
+				if (!outdir) {
+					outputs[f] = "; " + files[f] + "\n" + text;
+					continue;
+				}
+				std::string name = files[f].substr(files[f].find_last_of('/') + 1);
+				std::string outname = std::string(outdir) + "/" + name.substr(0, name.find_last_of('.')) + ".inc";
+				FILE *out = fopen(outname.c_str(), "w");
+				if (!out || fwrite(text.data(), 1, text.size(), out) != text.size()) {
+					fprintf(stderr, "Unable to write %s\n", outname.c_str());
+					failed++;
+				}
+				if (out)
+					fclose(out);
 			}
-			else
-				fread(SynthObj.InstrumentValues[channel], 1, MAX_UNITS*MAX_UNIT_SLOTS, file);	
-			
+			free(synth);
+		}));
+	}
+	for (size_t t = 0; t < pool.size(); t++)
+		pool[t].join();
+
+	for (size_t f = 0; f < outputs.size(); f++)
+		fputs(outputs[f].c_str(), stdout);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fprintf(stderr, "disassembled %d files in %.3f s on %d threads\n", (int)files.size() - (int)failed,
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9, threads);
+	return failed ? 1 : 0;
+}
+
+// packs the instruments into a library, in the current layout and named by their file names
+static int packLibrary(const char *libraryname, const std::vector<std::string> &files) {
+	SynthObjectP synth = (SynthObjectP)calloc(1, sizeof(SynthObject));
+	std::vector<Go4kPreset> presets;
+	std::vector<std::string> names;
+	int failed = 0;
+	for (size_t f = 0; synth && f < files.size(); f++) {
+		if (!loadMapped(synth, files[f].c_str())) {
+			fprintf(stderr, "Unable to load %s\n", files[f].c_str());
+			failed++;
+			continue;
 		}
-		
-		fclose(file);
-		return true;
-	} else {
-		printf("Unable to open file %s\n",filename);
-		return false;
+		Go4kPreset preset;
+		preset.versiontag = versiontag;
+		memcpy(preset.name, synth->InstrumentNames[0], sizeof(preset.name));
+		memcpy(preset.values, synth->InstrumentValues[0], sizeof(preset.values));
+		presets.push_back(preset);
+		std::string name = files[f].substr(files[f].find_last_of('/') + 1);
+		names.push_back(name.substr(0, name.find_last_of('.')));
+	}
+	free(synth);
+	std::vector<const char *> keys;
+	for (size_t n = 0; n < names.size(); n++)
+		keys.push_back(names[n].c_str());
+	int packed = Go4kLibrary_Write(libraryname, keys.empty() ? NULL : &keys[0], presets.empty() ? NULL : &presets[0], (int)presets.size());
+	if (packed < 0) {
+		fprintf(stderr, "Unable to write %s\n", libraryname);
+		return 1;
 	}
+	fprintf(stderr, "packed %d of %d instruments into %s\n", packed, (int)files.size(), libraryname);
+	return failed ? 1 : 0;
+}
+
+// lists the presets of a library whose names start with prefix: hash, name and instrument name
+static int listLibrary(const char *libraryname, const char *prefix) {
+	Go4kLibrary library;
+	if (!Go4kLibrary_Open(&library, libraryname)) {
+		fprintf(stderr, "Unable to open library %s\n", libraryname);
+		return 1;
+	}
+	size_t length = strlen(prefix);
+	for (int n = Go4kLibrary_LowerBound(&library, prefix); n < Go4kLibrary_Count(&library); n++) {
+		const Go4kLibraryEntry *entry = Go4kLibrary_Entry(&library, n);
+		if (strncmp(entry->name, prefix, length) != 0)
+			break;
+		const Go4kPreset *preset = Go4kLibrary_Preset(&library, entry);
+		printf("%016llx %.64s\t%.64s\n", entry->hash, entry->name, preset->name);
+	}
+	Go4kLibrary_Close(&library);
+	return 0;
 }
 
 int main( int argc, char *argv[] ) {
 	
-	if(Go4kVSTi_LoadInstrument(argv[1], 0)) {
-		disassembleInstruments();	
-	}	
-}
\ No newline at end of file
+	bool optimize = false;
+	bool cpp = false;
+	bool song = false;
+	bool batch = false;
+	const char *outdir = NULL;
+	const char *cachedir = NULL;
+	const char *bytecode = NULL;
+	bool cost = false;
+	const char *pack = NULL;
+	const char *list = NULL;
+	const char *calibrate = NULL;
+	const char *model = NULL;
+	int voices = 1;
+	int threads = (int)std::thread::hardware_concurrency();
+	int arg = 1;
+	for (; arg < argc && argv[arg][0] == '-'; arg++) {
+		if (strcmp(argv[arg], "-O") == 0)
+			optimize = true;
+		else if (strcmp(argv[arg], "-cpp") == 0)
+			cpp = true;
+		else if (strcmp(argv[arg], "-song") == 0)
+			song = true;
+		else if (strcmp(argv[arg], "-batch") == 0)
+			batch = true;
+		else if (strcmp(argv[arg], "-o") == 0 && arg + 1 < argc)
+			outdir = argv[++arg];
+		else if (strcmp(argv[arg], "-j") == 0 && arg + 1 < argc)
+			threads = atoi(argv[++arg]);
+		else if (strcmp(argv[arg], "-cache") == 0 && arg + 1 < argc)
+			cachedir = argv[++arg];
+		else if (strcmp(argv[arg], "-bytecode") == 0 && arg + 1 < argc)
+			bytecode = argv[++arg];
+		else if (strcmp(argv[arg], "-pack") == 0 && arg + 1 < argc)
+			pack = argv[++arg];
+		else if (strcmp(argv[arg], "-list") == 0 && arg + 1 < argc)
+			list = argv[++arg];
+		else if (strcmp(argv[arg], "-cost") == 0)
+			cost = true;
+		else if (strcmp(argv[arg], "-calibrate") == 0 && arg + 1 < argc)
+			calibrate = argv[++arg];
+		else if (strcmp(argv[arg], "-model") == 0 && arg + 1 < argc)
+			model = argv[++arg];
+		else if (strcmp(argv[arg], "-v") == 0 && arg + 1 < argc)
+			voices = atoi(argv[++arg]);
+	}
+	if (list && arg + 1 >= argc)
+		return listLibrary(list, arg < argc ? argv[arg] : "");
+	if (arg >= argc) {
+		fprintf(stderr, "USAGE: instrumentdisassembler [-O] [-cpp [-cache dir] | -song] instrument.4ki [instrument.4ki ...]\n");
+		fprintf(stderr, "       instrumentdisassembler [-O] -bytecode song.4kb instrument.4ki [instrument.4ki ...]\n");
+		fprintf(stderr, "       instrumentdisassembler -batch [-O] [-j threads] [-o outdir] file|directory|pattern [...]\n");
+		fprintf(stderr, "       instrumentdisassembler -pack library.4kl file|directory|pattern [...]\n");
+		fprintf(stderr, "       instrumentdisassembler -list library.4kl [prefix]\n");
+		fprintf(stderr, "       instrumentdisassembler [-O] -cost [-model cost.txt] [-v voices] instrument.4ki [instrument.4ki ...]\n");
+		fprintf(stderr, "       instrumentdisassembler -calibrate units.txt [-model cost.txt] instrument.4ki [instrument.4ki ...]\n");
+		fprintf(stderr, "  -O removes units without effect and folds constants first\n");
+		fprintf(stderr, "  -cpp emits C++ for go4krender -k instead of the GO4K_ macros of the first instrument\n");
+		fprintf(stderr, "  -cache writes the instruments not built yet to dir, named by content hash, see kernelbuild.sh\n");
+		fprintf(stderr, "  -song emits addInstrument calls for all instruments, with the delay times they use in setDelayTimes\n");
+		fprintf(stderr, "  -bytecode writes the instruments of that song as bytecode for 4klangrender, see go4kbytecode.h\n");
+		fprintf(stderr, "  -batch disassembles every instrument on its own, on all cores, to outdir/<name>.inc or to stdout\n");
+		fprintf(stderr, "  -pack writes the instruments to a library, in the current format and indexed by file name, any\n");
+		fprintf(stderr, "        instrument.4ki argument can then be a preset of the library as library.4kl:name or :#hash\n");
+		fprintf(stderr, "  -list prints the content hash, name and instrument name of the presets starting with prefix\n");
+		fprintf(stderr, "  -cost prints the estimated cycles per sample of the instruments with voices each, and of the patch\n");
+		fprintf(stderr, "  -calibrate fits the cost model to the units 4klangrender -U measured playing these instruments,\n");
+		fprintf(stderr, "             and writes it to the -model file (or stdout)\n");
+		return 1;
+	}
+
+	if (batch || pack) {
+		std::vector<std::string> files;
+		for (; arg < argc; arg++)
+			collectFiles(argv[arg], files);
+		if (pack)
+			return packLibrary(pack, files);
+		return disassembleBatch(files, outdir, threads > 0 ? threads : 1, optimize);
+	}
+
+	int instruments = cpp || song || bytecode || cost || calibrate ? argc - arg : 1;
+	if (instruments > MAX_INSTRUMENTS)
+		instruments = MAX_INSTRUMENTS;
+	for (int i = 0; i < instruments; i++) {
+		if (!Go4kVSTi_LoadInstrument(argv[arg + i], (char)i))
+			return 1;
+	}
+	for (int i = 0; optimize && i < instruments; i++) {
+		Go4kOptimizeReport report;
+		Go4kVSTi_OptimizeInstrument(&SynthObj, (char)i, &report);
+		fprintf(stderr, "%s: %d units removed, %d constants folded, ~%d cycles per voice and sample saved\n",
+			argv[arg + i], report.removed, report.folded, report.cyclessaved);
+	}
+
+	if (cost || calibrate) {
+		Go4kCostModel costModel;
+		Go4kCost_Init(&costModel);
+		if (calibrate) {
+			if (calibrateCost(&SynthObj, &costModel, calibrate) < 0)
+				return 1;
+			FILE *file = model ? fopen(model, "w") : stdout;
+			if (!file || !Go4kCost_Save(&costModel, file)) {
+				fprintf(stderr, "Unable to write %s\n", model);
+				return 1;
+			}
+			if (model)
+				fclose(file);
+		}
+		else if (model && !Go4kCost_Load(&costModel, model)) {
+			fprintf(stderr, "Unable to open %s\n", model);
+			return 1;
+		}
+		if (cost || model)
+			printCost(&SynthObj, &costModel, instruments, argv + arg, voices > 0 ? voices : 1);
+	}
+	else if (bytecode) {
+		std::string code;
+		int delaylines = assembleBytecode(&SynthObj, code);
+		FILE *file = fopen(bytecode, "wb");
+		if (!file || fwrite(code.data(), 1, code.size(), file) != code.size()) {
+			fprintf(stderr, "Unable to write %s\n", bytecode);
+			return 1;
+		}
+		fclose(file);
+		fprintf(stderr, "%d instruments in %d bytes, %d delay lines\n", instruments, (int)code.size(), delaylines);
+	}
+	else if (cpp && cachedir)
+		generateInstrumentsCppCached(&SynthObj, instruments, argv + arg, cachedir);
+	else if (cpp)
+		generateInstrumentsCpp(&SynthObj, instruments, argv + arg);
+	else {
+		std::string text;
+		disassembleInstruments(&SynthObj, text, song, argv + arg);
+		fputs(text.c_str(), stdout);
+	}
+	return 0;
+}
@@ -1,3 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
 #define MAX_POLYPHONY		2
 #define MAX_INSTRUMENTS		16
 #define MAX_UNITS			64
@@ -245,3 +250,118 @@ typedef struct SynthObject
 	int HighestSlotIndex[17];
 } *SynthObjectP;
 
+extern SynthObject SynthObj;
+
+// the .4ki version written now, the one the presets of libraries are in
+extern DWORD versiontag;
+
+// the delay times 4klang_inc.make.js emits unless a song sets its own, the DLL and GLITCH units of .4ki files index them
+#define GO4K_DEFAULT_DELAY_TIMES	20
+extern const WORD Go4kDefaultDelayTimes[GO4K_DEFAULT_DELAY_TIMES];
+
+// load instrumen data to specified channel
+bool Go4kVSTi_LoadInstrument(char* filename, char channel);
+// load a .4ki file, or a preset of a library named library.4kl:name or library.4kl:#hash, to a
+// channel of synth, the state of one song or preview (SynthObj for the above)
+bool Go4kVSTi_LoadInstrumentFile(SynthObjectP synth, const char *filename, char channel);
+// load instrument data from the contents of a .4ki file to a channel of synth, returns false for unknown formats
+bool Go4kVSTi_LoadInstrumentData(SynthObjectP synth, const BYTE *data, size_t size, char channel);
+
+typedef struct Go4kOptimizeReport
+{
+	int		removed;		// units removed
+	int		folded;			// constants folded into other units
+	int		cyclessaved;	// estimated cycles per voice and sample
+} *Go4kOptimizeReportP;
+
+// removes the units without effect on the output and folds constants in the instrument of a channel
+bool Go4kVSTi_OptimizeInstrument(SynthObjectP synth, char channel, Go4kOptimizeReportP report);
+
+// unit variants of the cost model, see instrumentcost.cpp
+enum Go4kCostVariant
+{
+	COST_NONE = 0, COST_ENV, COST_VCO, COST_VCO_STEREO, COST_VCO_NOISE, COST_VCF, COST_VCF_STEREO, COST_DST, COST_DST_STEREO,
+	COST_DLL, COST_FOP, COST_FST, COST_FSTG, COST_PAN, COST_OUT, COST_ACC, COST_FLD, COST_GLITCH, COST_VARIANTS
+};
+
+typedef struct Go4kCostModel
+{
+	float	base[COST_VARIANTS];		// cycles per voice and sample
+	float	perline[COST_VARIANTS];		// and per delay line of DLL units
+	int		samples[COST_VARIANTS];		// units measured for the calibration, 0 for the defaults
+} *Go4kCostModelP;
+
+// a unit measured by a profiling build of 4klangrender
+typedef struct Go4kCostSample
+{
+	int					variant;
+	int					lines;
+	unsigned long long	calls;
+	unsigned long long	cycles;
+} *Go4kCostSampleP;
+
+extern const char *Go4kCostVariantNames[COST_VARIANTS];
+
+// the default cost of the units
+void Go4kCost_Init(Go4kCostModelP model);
+// the variant of a unit in the chain of an instrument (-1 if unknown) and the delay lines it runs
+int Go4kCost_Variant(const BYTE *unit, int instrument, int *lines);
+// estimated cycles per voice and sample of a unit, with the default model for NULL
+float Go4kCost_Unit(Go4kCostModelP model, const BYTE *unit, int instrument);
+// fits the cost of the variants measured to the samples, returns the samples used
+int Go4kCost_Fit(Go4kCostModelP model, const Go4kCostSample *samples, int count);
+bool Go4kCost_Load(Go4kCostModelP model, const char *filename);
+bool Go4kCost_Save(Go4kCostModelP model, FILE *file);
+
+// a preset of a packed library, the layout of a current .4ki file
+typedef struct Go4kPreset
+{
+	DWORD	versiontag;
+	char	name[64];
+	BYTE	values[MAX_UNITS][MAX_UNIT_SLOTS];
+} *Go4kPresetP;
+
+typedef struct Go4kLibraryHeader
+{
+	DWORD	magic;
+	DWORD	versiontag;		// of all presets
+	DWORD	count;
+	DWORD	index;			// file offsets of the index by name,
+	DWORD	hashes;			// the index entries in the order of their hash
+	DWORD	presets;		// and the presets in the order of the index
+	DWORD	reserved[2];
+} *Go4kLibraryHeaderP;
+
+typedef struct Go4kLibraryEntry
+{
+	char				name[64];	// the .4ki file name without extension
+	unsigned long long	hash;		// Go4kPreset_Hash
+} *Go4kLibraryEntryP;
+
+// a library mapped by Go4kLibrary_Open, see instrumentlibrary.cpp
+typedef struct Go4kLibrary
+{
+	const BYTE					*data;
+	size_t						size;
+	const Go4kLibraryHeader		*header;
+	const Go4kLibraryEntry		*index;
+	const DWORD					*hashes;
+} *Go4kLibraryP;
+
+// maps a library, false unless its tables lie in the file, its names end in their field and both indexes are sorted
+bool Go4kLibrary_Open(Go4kLibraryP library, const char *filename);
+void Go4kLibrary_Close(Go4kLibraryP library);
+int Go4kLibrary_Count(Go4kLibraryP library);
+// the entry at a position of the index by name, NULL past its end
+const Go4kLibraryEntry *Go4kLibrary_Entry(Go4kLibraryP library, int n);
+// the position of the first entry not below name in the index, where the names starting with it begin
+int Go4kLibrary_LowerBound(Go4kLibraryP library, const char *name);
+const Go4kLibraryEntry *Go4kLibrary_Find(Go4kLibraryP library, const char *name);
+const Go4kLibraryEntry *Go4kLibrary_FindHash(Go4kLibraryP library, unsigned long long hash);
+// the preset of an entry, a pointer into the mapping valid until Go4kLibrary_Close
+const Go4kPreset *Go4kLibrary_Preset(Go4kLibraryP library, const Go4kLibraryEntry *entry);
+unsigned long long Go4kPreset_Hash(const Go4kPreset *preset);
+// writes a library of the presets, indexed by names, returns the presets written or -1
+int Go4kLibrary_Write(const char *filename, const char *const names[], const Go4kPreset *presets, int count);
+// the preset name of a file name like library.4kl:name, NULL for other file names
+const char *Go4kLibrary_PresetName(const char *filename);
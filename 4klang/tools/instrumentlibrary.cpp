@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include <algorithm>
+#include "./instrumentdisassembler.h"
+
+// Packed instrument library (.4kl): a header, the index of the presets sorted by name, the order
+// of the index by content hash and the presets in the order of the index, each in the current
+// .4ki layout however old the file it was packed from. Everything is used in place in a read
+// only mapping of the file.
+
+#define GO4K_LIBRARY_MAGIC	0x6c6b3467	// g4kl
+
+bool Go4kLibrary_Open(Go4kLibraryP library, const char *filename)
+{
+	memset(library, 0, sizeof(Go4kLibrary));
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat status;
+	void *data = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && (size_t)status.st_size >= sizeof(Go4kLibraryHeader))
+		data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	// the tables have to lie in the file, the rest is checked below
+	const Go4kLibraryHeader *header = (const Go4kLibraryHeader *)data;
+	size_t size = status.st_size, count = header->count;
+	if (header->magic != GO4K_LIBRARY_MAGIC || header->versiontag != versiontag ||
+		header->index % 8 || header->index + count * sizeof(Go4kLibraryEntry) > size ||
+		header->hashes % 4 || header->hashes + count * sizeof(DWORD) > size ||
+		header->presets % 4 || header->presets + count * sizeof(Go4kPreset) > size)
+	{
+		munmap(data, size);
+		return false;
+	}
+	library->data = (const BYTE *)data;
+	library->size = size;
+	library->header = header;
+	library->index = (const Go4kLibraryEntry *)(library->data + header->index);
+	library->hashes = (const DWORD *)(library->data + header->hashes);
+	// the searches need names that end in their field, the index sorted by name and the hash order by hash
+	for (DWORD n = 0; n < header->count; n++)
+	{
+		const Go4kLibraryEntry *entry = &library->index[n];
+		if (!memchr(entry->name, 0, sizeof(entry->name)) || (n && strcmp(entry[-1].name, entry->name) >= 0) ||
+			library->hashes[n] >= header->count ||
+			(n && library->index[library->hashes[n - 1]].hash > library->index[library->hashes[n]].hash))
+		{
+			Go4kLibrary_Close(library);
+			return false;
+		}
+	}
+	return true;
+}
+
+void Go4kLibrary_Close(Go4kLibraryP library)
+{
+	if (library->data)
+		munmap((void *)library->data, library->size);
+	memset(library, 0, sizeof(Go4kLibrary));
+}
+
+int Go4kLibrary_Count(Go4kLibraryP library)
+{
+	return library->header ? (int)library->header->count : 0;
+}
+
+const Go4kLibraryEntry *Go4kLibrary_Entry(Go4kLibraryP library, int n)
+{
+	return n >= 0 && n < Go4kLibrary_Count(library) ? &library->index[n] : NULL;
+}
+
+// the first entry whose name is not below name, so the presets starting with a prefix follow it
+int Go4kLibrary_LowerBound(Go4kLibraryP library, const char *name)
+{
+	int low = 0, high = Go4kLibrary_Count(library);
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (strncmp(library->index[middle].name, name, sizeof(((Go4kLibraryEntry *)0)->name)) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	return low;
+}
+
+const Go4kLibraryEntry *Go4kLibrary_Find(Go4kLibraryP library, const char *name)
+{
+	int n = Go4kLibrary_LowerBound(library, name);
+	const Go4kLibraryEntry *entry = Go4kLibrary_Entry(library, n);
+	return entry && strncmp(entry->name, name, sizeof(entry->name)) == 0 ? entry : NULL;
+}
+
+const Go4kLibraryEntry *Go4kLibrary_FindHash(Go4kLibraryP library, unsigned long long hash)
+{
+	int low = 0, high = Go4kLibrary_Count(library);
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (library->index[library->hashes[middle]].hash < hash)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low == Go4kLibrary_Count(library) || library->index[library->hashes[low]].hash != hash)
+		return NULL;
+	return &library->index[library->hashes[low]];
+}
+
+const Go4kPreset *Go4kLibrary_Preset(Go4kLibraryP library, const Go4kLibraryEntry *entry)
+{
+	return (const Go4kPreset *)(library->data + library->header->presets) + (entry - library->index);
+}
+
+// FNV-1a over the units of a preset, the same for the same instrument whatever its name
+unsigned long long Go4kPreset_Hash(const Go4kPreset *preset)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	const BYTE *data = &preset->values[0][0];
+	for (int b = 0; b < MAX_UNITS * MAX_UNIT_SLOTS; b++)
+	{
+		hash ^= data[b];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static bool writeAll(FILE *file, const void *data, size_t size)
+{
+	return fwrite(data, 1, size, file) == size;
+}
+
+int Go4kLibrary_Write(const char *filename, const char *const names[], const Go4kPreset *presets, int count)
+{
+	// by name, the first of the same name wins
+	std::vector<int> order;
+	for (int p = 0; p < count; p++)
+		order.push_back(p);
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) { return strcmp(names[a], names[b]) < 0; });
+	std::vector<Go4kLibraryEntry> index;
+	std::vector<Go4kPreset> packed;
+	for (size_t o = 0; o < order.size(); o++)
+	{
+		const char *name = names[order[o]];
+		if (strlen(name) >= sizeof(((Go4kLibraryEntry *)0)->name))
+		{
+			fprintf(stderr, "Name too long, skipped %s\n", name);
+			continue;
+		}
+		if (!index.empty() && strcmp(index.back().name, name) == 0)
+		{
+			fprintf(stderr, "Duplicate name, skipped %s\n", name);
+			continue;
+		}
+		Go4kLibraryEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		strcpy(entry.name, name);
+		entry.hash = Go4kPreset_Hash(&presets[order[o]]);
+		index.push_back(entry);
+		packed.push_back(presets[order[o]]);
+	}
+	std::vector<DWORD> hashes;
+	for (size_t e = 0; e < index.size(); e++)
+		hashes.push_back((DWORD)e);
+	std::stable_sort(hashes.begin(), hashes.end(), [&](DWORD a, DWORD b) { return index[a].hash < index[b].hash; });
+
+	Go4kLibraryHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = GO4K_LIBRARY_MAGIC;
+	header.versiontag = versiontag;
+	header.count = (DWORD)index.size();
+	header.index = sizeof(header);
+	header.hashes = header.index + (DWORD)(index.size() * sizeof(Go4kLibraryEntry));
+	header.presets = header.hashes + (DWORD)(hashes.size() * sizeof(DWORD));
+	FILE *file = fopen(filename, "wb");
+	if (!file)
+		return -1;
+	bool written = writeAll(file, &header, sizeof(header)) &&
+		(index.empty() || writeAll(file, &index[0], index.size() * sizeof(Go4kLibraryEntry))) &&
+		(hashes.empty() || writeAll(file, &hashes[0], hashes.size() * sizeof(DWORD))) &&
+		(packed.empty() || writeAll(file, &packed[0], packed.size() * sizeof(Go4kPreset)));
+	if (fclose(file) != 0 || !written)
+		return -1;
+	return (int)index.size();
+}
+
+const char *Go4kLibrary_PresetName(const char *filename)
+{
+	const char *colon = strrchr(filename, ':');
+	if (!colon || colon - filename < 4 || strncasecmp(colon - 4, ".4kl", 4) != 0)
+		return NULL;
+	return colon + 1;
+}
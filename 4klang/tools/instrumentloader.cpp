@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "./instrumentdisassembler.h"
+
+DWORD versiontag10 = 0x30316b34; // 4k10
+DWORD versiontag11 = 0x31316b34; // 4k11
+//DWORD versiontag12 = 0x346b3132; // 4k12
+DWORD versiontag12 = 0x32316b34; // 4k12
+DWORD versiontag13 = 0x33316b34; // 4k13
+DWORD versiontag   = 0x34316b34; // 4k14
+
+SynthObject SynthObj;
+
+const WORD Go4kDefaultDelayTimes[GO4K_DEFAULT_DELAY_TIMES] =
+{
+	0,
+	1116, 1188, 1276, 1356, 1422, 1492, 1556, 1618,
+	1140, 1212, 1300, 1380, 1446, 1516, 1580, 1642,
+	22050, 16537, 11025
+};
+
+// load instrument data from the contents of a .4ki file to a channel of synth
+bool Go4kVSTi_LoadInstrumentData(SynthObjectP synth, const BYTE *data, size_t size, char channel)
+{
+	DWORD version = 0;
+	if (size < 4)
+		return false;
+	memcpy(&version, data, 4);
+	// 1.0 to 1.3 files had 32 units, each in a 32 byte block, only mulp2 and fld units were added since
+	bool version13 = version == versiontag13 || version == versiontag12 || version == versiontag11 || version == versiontag10;
+	if (version != versiontag && !version13)
+		return false;
+
+	if (channel < 16)
+	{
+		memset(synth->InstrumentNames[(int)channel], 0, 64);
+		memset(synth->InstrumentValues[(int)channel], 0, MAX_UNITS*MAX_UNIT_SLOTS);
+		size_t offset = 4;
+		size_t count = size - offset < 64 ? size - offset : 64;
+		memcpy(synth->InstrumentNames[(int)channel], data + offset, count);
+		offset += 64;
+
+		for (int j = 0; j < (version13 ? 32 : MAX_UNITS) && offset < size; j++)
+		{
+			count = size - offset < MAX_UNIT_SLOTS ? size - offset : MAX_UNIT_SLOTS;
+			memcpy(synth->InstrumentValues[(int)channel][j], data + offset, count);
+			offset += version13 ? 32 : MAX_UNIT_SLOTS;
+		}
+	}
+	return true;
+}
+
+// load a preset of a library to a channel of synth, the presets are in the current layout already
+static bool Go4kVSTi_LoadLibraryPreset(SynthObjectP synth, const char *filename, const char *name, char channel)
+{
+	std::string libraryname(filename, name - 1);
+	Go4kLibrary library;
+	if (!Go4kLibrary_Open(&library, libraryname.c_str()))
+	{
+		printf("Unable to open library %s\n", libraryname.c_str());
+		return false;
+	}
+	// library.4kl:#hash names a preset by the hash -list prints
+	const Go4kLibraryEntry *entry = name[0] == '#' ? Go4kLibrary_FindHash(&library, strtoull(name + 1, NULL, 16)) : Go4kLibrary_Find(&library, name);
+	if (entry)
+	{
+		const Go4kPreset *preset = Go4kLibrary_Preset(&library, entry);
+		Go4kVSTi_LoadInstrumentData(synth, (const BYTE *)preset, sizeof(Go4kPreset), channel);
+	}
+	else
+		printf("No preset %s in %s\n", name, libraryname.c_str());
+	Go4kLibrary_Close(&library);
+	return entry != NULL;
+}
+
+// load a .4ki file to a channel of synth
+bool Go4kVSTi_LoadInstrumentFile(SynthObjectP synth, const char *filename, char channel)
+{
+	const char *name = Go4kLibrary_PresetName(filename);
+	if (name)
+		return Go4kVSTi_LoadLibraryPreset(synth, filename, name, channel);
+	FILE *file = fopen(filename, "rb");
+	if (file)
+	{
+		std::vector<BYTE> data;
+		BYTE buffer[4096];
+		size_t count;
+		while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			data.insert(data.end(), buffer, buffer + count);
+		fclose(file);
+		if (!Go4kVSTi_LoadInstrumentData(synth, data.empty() ? NULL : &data[0], data.size(), channel))
+		{
+			printf("newer format than supported\n");
+			return false;
+		}
+		return true;
+	} else {
+		printf("Unable to open file %s\n",filename);
+		return false;
+	}
+}
+
+// load instrumen data to specified channel
+bool Go4kVSTi_LoadInstrument(char* filename, char channel)
+{
+	return Go4kVSTi_LoadInstrumentFile(&SynthObj, filename, channel);
+}
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <string.h>
+#include "./instrumentdisassembler.h"
+
+// Optimizer for loaded instruments: follows the values of the unit chain over the fpu stack
+// and the FST destinations, removes the units that have no effect on the output, folds
+// constant FLD arithmetic and constant modulations into the unit values, and compacts the
+// chain. Only changes that render exactly the same are made.
+
+#define MAX_STACK		64
+#define MAX_INPUTS		4
+
+// workspace slots of the units, see the go4k*_wrk structs in 4klang.inc
+#define ENV_WRK_SM		5
+#define VCO_WRK_CM		5
+#define VCF_WRK_FREQ	3
+
+typedef struct UnitFlow
+{
+	int		inputs[MAX_INPUTS];			// units that produced the values the unit reads
+	int		inputcount;
+	int		outputs;					// values the unit pushes or replaces
+	bool	live;
+} *UnitFlowP;
+
+// estimated cycles per sample of the units in 4klang.asm, for the report, see instrumentcost.cpp
+static int UnitCycles(const BYTE *unit)
+{
+	return (int)Go4kCost_Unit(NULL, unit, -1);
+}
+
+// whether the unit reads a workspace slot, a store to any other slot has no effect
+static bool ReadsSlot(const BYTE *unit, int slot)
+{
+	switch (unit[0])
+	{
+	case M_ENV:		return slot < 7 && slot != ENV_WRK_SM;	// sustain is not modulated
+	case M_VCO:		return slot < 9;
+	case M_VCF:		return slot < 9 && slot != VCF_WRK_FREQ;
+	case M_DST:		return slot < 5;
+	case M_DLL:		return slot < 6;
+	case M_GLITCH:	return slot < 4;
+	case M_PAN:		return slot < 1;
+	case M_OUT:		return slot < 2;
+	case M_FLD:		return slot < 1;
+	}
+	return false;
+}
+
+// the unit value a modulation slot is added to, 0 if it can't be folded
+static int ModulatedValue(const BYTE *unit, int slot)
+{
+	static const int env[] = { 0, 0, 5, 1, 2, 0, 4 };
+	static const int vco[] = { 0, 1, 2, 0, 3, 5, 6, 7, 0 };
+	static const int vcf[] = { 0, 0, 0, 0, 1, 2 };
+	static const int dst[] = { 0, 0, 1, 2, 0 };
+	static const int dll[] = { 1, 3, 2, 4, 5, 6 };
+	static const int glitch[] = { 1, 2, 3, 4 };
+	switch (unit[0])
+	{
+	case M_ENV:		return slot < 7 ? env[slot] : 0;
+	// the color of a gate oscillator holds gate bits
+	case M_VCO:		return slot < 9 && !(slot == VCO_WRK_CM && (unit[8] & VCO_GATE)) ? vco[slot] : 0;
+	case M_VCF:		return slot < 6 ? vcf[slot] : 0;
+	case M_DST:		return slot < 5 ? dst[slot] : 0;
+	case M_DLL:		return slot < 6 ? dll[slot] : 0;
+	case M_GLITCH:	return slot < 4 ? glitch[slot] : 0;
+	case M_PAN:		return slot == 0 ? 1 : 0;
+	case M_OUT:		return slot == 0 ? 2 : slot == 1 ? 1 : 0;
+	}
+	return 0;
+}
+
+static bool IsNoise(const BYTE *unit)
+{
+	return unit[0] == M_VCO && (unit[8] & VCO_NOISE) && !(unit[8] & (VCO_SINE | VCO_TRISAW | VCO_PULSE | VCO_GATE));
+}
+
+static bool IsLocalStore(const BYTE *unit, int channel)
+{
+	FST_valP v = (FST_valP)unit;
+	return v->id == M_FST && (v->dest_stack == -1 || v->dest_stack == channel);
+}
+
+// builds the dataflow of the chain: which units produced the values each unit reads.
+// returns false if the chain reads below the bottom of the stack or beyond its top.
+static bool BuildFlow(BYTE (*units)[MAX_UNIT_SLOTS], UnitFlowP flow)
+{
+	int stack[MAX_STACK];
+	int sp = 0;
+	memset(flow, 0, sizeof(UnitFlow) * MAX_UNITS);
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		const BYTE *unit = units[u];
+		int reads = 0;
+		int pops = 0;
+		int pushes = 0;
+		switch (unit[0])
+		{
+		case M_NONE:
+			continue;
+		case M_ENV:
+		case M_FLD:
+			pushes = 1;
+			break;
+		case M_VCO:
+			pushes = unit[8] & VCO_STEREO ? 2 : 1;
+			if (!(unit[8] & (VCO_SINE | VCO_TRISAW | VCO_PULSE | VCO_GATE | VCO_NOISE)))
+				pushes++;
+			break;
+		case M_ACC:
+			pushes = 2;
+			break;
+		case M_VCF:
+		case M_DST:
+			reads = pops = pushes = unit[3] & VCF_STEREO ? 2 : 1;
+			break;
+		case M_DLL:
+		case M_GLITCH:
+			reads = pops = pushes = 1;
+			break;
+		case M_PAN:
+			reads = pops = 1;
+			pushes = 2;
+			break;
+		case M_OUT:
+			reads = pops = 2;
+			break;
+		case M_FST:
+			reads = 1;
+			pops = unit[2] & FST_POP ? 1 : 0;
+			break;
+		case M_FOP:
+			switch (unit[1])
+			{
+			case FOP_POP:		reads = pops = 1; break;
+			case FOP_ADDP:
+			case FOP_MULP:		reads = pops = 2; pushes = 1; break;
+			case FOP_PUSH:		reads = 1; pushes = 1; break;
+			case FOP_XCH:		reads = pops = pushes = 2; break;
+			case FOP_ADD:
+			case FOP_MUL:		reads = 2; pops = pushes = 1; break;
+			case FOP_ADDP2:
+			case FOP_MULP2:		reads = pops = 4; pushes = 2; break;
+			case FOP_LOADNOTE:	pushes = 1; break;
+			}
+			break;
+		default:
+			return false;
+		}
+		if (reads > sp || sp - pops + pushes > MAX_STACK)
+			return false;
+		for (int r = 0; r < reads; r++)
+			flow[u].inputs[flow[u].inputcount++] = stack[sp - 1 - r];
+		sp -= pops;
+		for (int p = 0; p < pushes; p++)
+			stack[sp++] = u;
+		flow[u].outputs = pushes;
+	}
+	return true;
+}
+
+// marks the units whose values reach the output, or that have effects beyond the stack
+static void MarkLive(BYTE (*units)[MAX_UNIT_SLOTS], UnitFlowP flow, int channel, const bool *keep)
+{
+	int first = 0;
+	while (first < MAX_UNITS && units[first][0] == M_NONE)
+		first++;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		const BYTE *unit = units[u];
+		flow[u].live = keep[u] || u == first		// the envelope of the first unit ends the note
+			|| unit[0] == M_OUT || unit[0] == M_ACC
+			|| (unit[0] == M_FST && !IsLocalStore(unit, channel))
+			|| IsNoise(unit);						// shares the noise sequence with all other noise units
+	}
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			FST_valP v = (FST_valP)units[u];
+			if (!flow[u].live && IsLocalStore(units[u], channel) && v->dest_unit >= 0 && v->dest_unit < MAX_UNITS
+				&& flow[(int)v->dest_unit].live && ReadsSlot(units[(int)v->dest_unit], v->dest_slot))
+			{
+				flow[u].live = true;
+				changed = true;
+			}
+			if (!flow[u].live)
+				continue;
+			for (int i = 0; i < flow[u].inputcount; i++)
+			{
+				if (!flow[flow[u].inputs[i]].live)
+				{
+					flow[flow[u].inputs[i]].live = true;
+					changed = true;
+				}
+			}
+		}
+	}
+}
+
+static int NextUnit(BYTE (*units)[MAX_UNIT_SLOTS], int u)
+{
+	for (u++; u < MAX_UNITS && units[u][0] == M_NONE; u++)
+		;
+	return u;
+}
+
+// the number of local stores and stores from other chains to a workspace slot
+static int CountStores(SynthObjectP synth, int channel, int destunit, int destslot)
+{
+	int stores = 0;
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+	{
+		BYTE (*units)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			FST_valP v = (FST_valP)units[u];
+			if (v->id != M_FST || v->dest_unit != destunit || v->dest_slot != destslot)
+				continue;
+			if (i == channel ? IsLocalStore(units[u], channel) : v->dest_stack == channel)
+				stores++;
+		}
+	}
+	return stores;
+}
+
+// FLD value of a byte, (byte/128-0.5)*2, is (byte-64)/64
+static bool FoldConstants(SynthObjectP synth, BYTE (*units)[MAX_UNIT_SLOTS], int channel, int u, Go4kOptimizeReportP report)
+{
+	BYTE *unit = units[u];
+	if (unit[0] != M_FLD || CountStores(synth, channel, u, 0))
+		return false;
+	// the first unit stays, its workspace ends the note
+	bool first = NextUnit(units, -1) == u;
+	int next = NextUnit(units, u);
+	if (next >= MAX_UNITS)
+		return false;
+	BYTE *op = units[next];
+
+	// x*1 and x+0
+	if (!first && op[0] == M_FOP && ((op[1] == FOP_MULP && unit[1] == 128) || (op[1] == FOP_ADDP && unit[1] == 64)))
+	{
+		report->cyclessaved += UnitCycles(unit) + UnitCycles(op);
+		memset(unit, 0, MAX_UNIT_SLOTS);
+		memset(op, 0, MAX_UNIT_SLOTS);
+		report->folded++;
+		return true;
+	}
+
+	// FLD a, FLD b, FOP ADDP/MULP -> FLD a+b or a*b, if it is a value of a byte
+	if (op[0] == M_FLD && !CountStores(synth, channel, next, 0))
+	{
+		int last = NextUnit(units, next);
+		if (last >= MAX_UNITS || units[last][0] != M_FOP)
+			return false;
+		int a = unit[1] - 64;
+		int b = op[1] - 64;
+		int value;
+		if (units[last][1] == FOP_ADDP)
+			value = a + b;
+		else if (units[last][1] == FOP_MULP && (a * b) % 64 == 0)
+			value = a * b / 64;
+		else
+			return false;
+		if (value + 64 < 0 || value + 64 > 255)
+			return false;
+		report->cyclessaved += UnitCycles(op) + UnitCycles(units[last]);
+		unit[1] = (BYTE)(value + 64);
+		memset(op, 0, MAX_UNIT_SLOTS);
+		memset(units[last], 0, MAX_UNIT_SLOTS);
+		report->folded++;
+		return true;
+	}
+
+	// FLD c, FST to a later unit that nothing else stores to: add the stored value to the unit value
+	FST_valP v = (FST_valP)op;
+	if (first || !IsLocalStore(op, channel) || (v->type & FST_ADD) || v->dest_unit <= next || v->dest_unit >= MAX_UNITS
+		|| CountStores(synth, channel, v->dest_unit, v->dest_slot) != 1)
+		return false;
+	BYTE *target = units[(int)v->dest_unit];
+	int index = ModulatedValue(target, v->dest_slot);
+	int scale = 128;
+	if (target[0] == M_FLD && v->dest_slot == 0)
+	{
+		// FLD adds the slot after scaling its value
+		index = 1;
+		scale = 64;
+	}
+	// the stored value is (amount-64)/64 * (c-64)/64, in units of the target value
+	int product = (v->amount - 64) * (unit[1] - 64) * scale;
+	if (index == 0 || product % (64 * 64))
+		return false;
+	int value = target[index] + product / (64 * 64);
+	if (value < 0 || value > 255)
+		return false;
+	target[index] = (BYTE)value;
+	report->cyclessaved += UnitCycles(op);
+	if (v->type & FST_POP)
+	{
+		report->cyclessaved += UnitCycles(unit);
+		memset(unit, 0, MAX_UNIT_SLOTS);
+	}
+	memset(op, 0, MAX_UNIT_SLOTS);
+	report->folded++;
+	return true;
+}
+
+// one pass of removals that keep the stack layout of the rest of the chain, returns true if anything changed
+static bool RemoveDeadUnits(BYTE (*units)[MAX_UNIT_SLOTS], UnitFlowP flow, Go4kOptimizeReportP report)
+{
+	bool changed = false;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		BYTE *unit = units[u];
+		if (unit[0] == M_NONE || flow[u].live)
+			continue;
+
+		// a store that has no effect, only its pop remains
+		if (unit[0] == M_FST)
+		{
+			report->cyclessaved += UnitCycles(unit);
+			bool pop = (unit[2] & FST_POP) != 0;
+			memset(unit, 0, MAX_UNIT_SLOTS);
+			if (pop)
+			{
+				unit[0] = M_FOP;
+				unit[1] = FOP_POP;
+				report->cyclessaved -= UnitCycles(unit);
+			}
+			report->removed++;
+			changed = true;
+			continue;
+		}
+
+		// units that replace the values they read in place
+		bool inplace = unit[0] == M_VCF || unit[0] == M_DST || unit[0] == M_DLL || unit[0] == M_GLITCH
+			|| (unit[0] == M_FOP && (unit[1] == FOP_ADD || unit[1] == FOP_MUL));
+		if (inplace)
+		{
+			report->cyclessaved += UnitCycles(unit);
+			memset(unit, 0, MAX_UNIT_SLOTS);
+			report->removed++;
+			changed = true;
+			continue;
+		}
+
+		// a unit whose values are all popped right away
+		if (flow[u].outputs == 0 || (unit[0] == M_FOP && unit[1] != FOP_LOADNOTE) || unit[0] == M_PAN)
+			continue;
+		int pops[MAX_STACK];
+		int popcount = 0;
+		bool onlypops = true;
+		for (int c = u + 1; c < MAX_UNITS && onlypops; c++)
+		{
+			for (int i = 0; i < flow[c].inputcount; i++)
+			{
+				if (flow[c].inputs[i] != u)
+					continue;
+				if (units[c][0] == M_FOP && units[c][1] == FOP_POP)
+					pops[popcount++] = c;
+				else
+					onlypops = false;
+			}
+		}
+		if (!onlypops || popcount != flow[u].outputs)
+			continue;
+		report->cyclessaved += UnitCycles(unit);
+		memset(unit, 0, MAX_UNIT_SLOTS);
+		for (int p = 0; p < popcount; p++)
+		{
+			report->cyclessaved += UnitCycles(units[pops[p]]);
+			memset(units[pops[p]], 0, MAX_UNIT_SLOTS);
+			report->removed++;
+		}
+		report->removed++;
+		changed = true;
+		// the flow of the rest of the chain is stale now
+		break;
+	}
+	return changed;
+}
+
+// moves the units down over the empty ones, and points the stores to the new unit indices
+static void CompactUnits(SynthObjectP synth, int channel)
+{
+	BYTE (*units)[MAX_UNIT_SLOTS] = synth->InstrumentValues[channel];
+	int remap[MAX_UNITS];
+	int count = 0;
+	for (int u = 0; u < MAX_UNITS; u++)
+	{
+		remap[u] = units[u][0] == M_NONE ? -1 : count;
+		if (units[u][0] != M_NONE)
+		{
+			if (count != u)
+				memcpy(units[count], units[u], MAX_UNIT_SLOTS);
+			count++;
+		}
+	}
+	memset(units[count], 0, (MAX_UNITS - count) * MAX_UNIT_SLOTS);
+
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+	{
+		BYTE (*chain)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			FST_valP v = (FST_valP)chain[u];
+			if (v->id != M_FST || v->dest_unit < 0 || v->dest_unit >= MAX_UNITS)
+				continue;
+			bool target = i == channel ? IsLocalStore(chain[u], channel) : v->dest_stack == channel;
+			if (target && remap[(int)v->dest_unit] >= 0)
+				v->dest_unit = (char)remap[(int)v->dest_unit];
+		}
+	}
+}
+
+bool Go4kVSTi_OptimizeInstrument(SynthObjectP synth, char channel, Go4kOptimizeReportP report)
+{
+	memset(report, 0, sizeof(Go4kOptimizeReport));
+	BYTE (*units)[MAX_UNIT_SLOTS] = synth->InstrumentValues[(int)channel];
+
+	// units other chains store to stay, so do note synced delays when a glitch reads the synced time
+	bool keep[MAX_UNITS];
+	bool glitchsync = false;
+	memset(keep, 0, sizeof(keep));
+	for (int i = 0; i <= MAX_INSTRUMENTS; i++)
+	{
+		BYTE (*chain)[MAX_UNIT_SLOTS] = i < MAX_INSTRUMENTS ? synth->InstrumentValues[i] : synth->GlobalValues;
+		for (int u = 0; u < MAX_UNITS; u++)
+		{
+			FST_valP v = (FST_valP)chain[u];
+			if (i != channel && v->id == M_FST && v->dest_stack == channel && v->dest_unit >= 0 && v->dest_unit < MAX_UNITS)
+				keep[(int)v->dest_unit] = true;
+			if (chain[u][0] == M_GLITCH && ((GLITCH_valP)chain[u])->delay == 0)
+				glitchsync = true;
+		}
+	}
+	for (int u = 0; glitchsync && u < MAX_UNITS; u++)
+	{
+		if (units[u][0] == M_DLL && ((DLL_valP)units[u])->delay == 0)
+			keep[u] = true;
+	}
+
+	UnitFlow flow[MAX_UNITS];
+	bool changed = true;
+	while (changed)
+	{
+		if (!BuildFlow(units, flow))
+			break;
+		MarkLive(units, flow, channel, keep);
+		changed = RemoveDeadUnits(units, flow, report);
+		for (int u = 0; u < MAX_UNITS && !changed; u++)
+			changed = FoldConstants(synth, units, channel, u, report);
+	}
+	if (report->removed || report->folded)
+		CompactUnits(synth, channel);
+	return report->removed || report->folded;
+}
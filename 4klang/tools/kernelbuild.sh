@@ -0,0 +1,44 @@
+#!/bin/bash
+# Builds the unit chains of the instruments into a shared object for go4krender -k, keeping
+# an object per instrument in a cache named by the hash of its unit chain, so that only the
+# instruments that changed since the last build are compiled again.
+if [ $# -lt 2 ]
+    then
+        echo "USAGE: kernelbuild.sh instruments.so instrument.4ki [instrument.4ki ...]"
+        echo "  GO4K_CACHE sets the cache directory, CXXFLAGS the flags of the instrument objects"
+        exit 1
+fi
+set -e
+
+TOOLS=$(cd "$(dirname "$0")" && pwd)
+OUTPUT=$1
+shift
+CXXFLAGS=${CXXFLAGS:--O3 -march=native}
+# objects built with other kernels or flags live in their own cache
+KEY=$(cat "$TOOLS/go4kkernels.h" "$TOOLS/go4kengine.h" "$TOOLS/instrumentdisassembler.h" | sha1sum | cut -c1-12)
+KEY=$KEY-$(echo "$CXXFLAGS" | sha1sum | cut -c1-8)
+CACHE=${GO4K_CACHE:-$HOME/.cache/go4k}/$KEY
+mkdir -p "$CACHE"
+
+"$TOOLS/instrumentdisassembler" -cpp -cache "$CACHE" "$@" > "$CACHE/table.$$.cpp"
+for SOURCE in "$CACHE"/go4k_*.cpp
+    do
+        if [ -e "$SOURCE" ]
+            then
+                # compile to a temporary name first, so an interrupted build leaves no object behind
+                g++ $CXXFLAGS -fPIC -I"$TOOLS" -c "$SOURCE" -o "${SOURCE%.cpp}.tmp.$$" &
+        fi
+    done
+wait
+for SOURCE in "$CACHE"/go4k_*.cpp
+    do
+        if [ -e "${SOURCE%.cpp}.tmp.$$" ]
+            then
+                mv "${SOURCE%.cpp}.tmp.$$" "${SOURCE%.cpp}.o"
+                rm "$SOURCE"
+        fi
+    done
+
+OBJECTS=$(grep -o 'go4k_[0-9a-f]\{16\}' "$CACHE/table.$$.cpp" | sort -u | sed "s|.*|$CACHE/&.o|")
+g++ -fPIC -shared "$CACHE/table.$$.cpp" $OBJECTS -o "$OUTPUT"
+rm "$CACHE/table.$$.cpp"
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Compiles the instruments to C++ with instrumentdisassembler -cpp, and null tests the
+# compiled unit chains and the instruments optimized with -O against the interpreter of go4krender.
+# Instruments next to an expected.txt (see optimizer/) also have to lose the units and fold the
+# constants it lists.
+if [ $# -lt 1 ]
+    then
+        echo "USAGE: kerneltest.sh instrument.4ki [instrument.4ki ...]"
+        exit 1
+fi
+set -e
+
+TOOLS=$(cd "$(dirname "$0")" && pwd)
+PATTERN=${PATTERN:-60,1,1,1,1,1,1,1,0,0,0,0,67,1,0,0}
+TICKS=${TICKS:-64}
+VOICES=${VOICES:-1}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+(cd "$TOOLS" && sh compile.sh > /dev/null)
+
+"$TOOLS/instrumentdisassembler" -cpp "$@" > "$WORK/instruments.cpp"
+g++ -O3 -march=native -fPIC -shared -I"$TOOLS" "$WORK/instruments.cpp" -o "$WORK/instruments.so"
+
+"$TOOLS/go4krender" -p "$PATTERN" -t $TICKS -v $VOICES "$@" > "$WORK/interpreter.raw"
+"$TOOLS/go4krender" -p "$PATTERN" -t $TICKS -v $VOICES -k "$WORK/instruments.so" -c "$WORK/interpreter.raw" "$@"
+
+# the optimizer has to render exactly the same, which also catches stores left pointing at moved units
+if ! "$TOOLS/go4krender" -p "$PATTERN" -t $TICKS -v $VOICES -O -e 0 -c "$WORK/interpreter.raw" "$@" 2> "$WORK/optimizer.txt"; then
+    cat "$WORK/optimizer.txt"
+    exit 1
+fi
+grep -e "units removed" -e "PASS" "$WORK/optimizer.txt"
+for instrument in "$@"; do
+    EXPECTED="$(dirname "$instrument")/expected.txt"
+    [ -f "$EXPECTED" ] || continue
+    COUNTS=$(awk -v name="$(basename "$instrument")" '$1 == name { print $2 " units removed, " $3 " constants folded" }' "$EXPECTED")
+    if [ -n "$COUNTS" ] && ! grep -qF "$instrument: $COUNTS," "$WORK/optimizer.txt"; then
+        echo "FAIL: $instrument, expected $COUNTS"
+        exit 1
+    fi
+done
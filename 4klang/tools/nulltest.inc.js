@@ -0,0 +1,20 @@
+// Song for nulltest.sh: plays NULLTEST_PATTERN NULLTEST_PATTERNS times on every instrument given on the command line
+const incMake4k = require('../4klang_inc/4klang_inc.make.js');
+const fs = require('fs');
+
+global.bpm = 120;
+global.pattern_size_shift = 4;
+global.beats_per_pattern_shift = 2;
+calculatePatternSize();
+global.looptimes = 1;
+
+process.argv.slice(2).forEach((filename, n) =>
+	addInstrument('instr' + n, fs.readFileSync(filename).toString())
+);
+
+addPattern('nulltest', process.env.NULLTEST_PATTERN.split(',').map(n => parseInt(n)));
+const patterns = {};
+instrumentNames.forEach(name => patterns[name] = 'nulltest');
+repeatSection(parseInt(process.env.NULLTEST_PATTERNS), () => playPatterns(patterns));
+
+incMake4k.makeVierKlangInc();
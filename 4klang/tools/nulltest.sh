@@ -0,0 +1,61 @@
+#!/bin/bash
+# Null test of the native engine (go4krender) against 4klang.asm, rendering the same pattern
+# with the instruments disassembled to a song for the asm. The asm render is also checked
+# against a GO4K_PROFILE build, against -d in sub-tick periods (with a 32 bit libasound) and
+# for the JSON of -B.
+# Needs node, yasm and gcc with 32 bit support (multilib) for the reference render.
+if [ $# -lt 1 ]
+    then
+        echo "USAGE: nulltest.sh instrument.4ki [instrument.4ki ...]"
+        exit 1
+fi
+set -e
+
+TOOLS=$(cd "$(dirname "$0")" && pwd)
+PATTERN=${PATTERN:-60,1,1,1,1,1,1,1,0,0,0,0,67,1,0,0}
+PATTERNS=${PATTERNS:-4}
+# the sources of 4klangrender, with the headers they include
+RENDER_SOURCES="4klangrender.c 4klangoutput.c 4klangkeyframes.c 4klangqueue.c 4klanglive.c 4klangdevice.c 4klangserver.c"
+RENDER_HEADERS="4klangrender.h 4klangoutput.h 4klangkeyframes.h 4klangqueue.h 4klanglive.h 4klangdevice.h 4klangserver.h"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+(cd "$TOOLS" && sh compile.sh > /dev/null)
+
+INCS=()
+for ((n = 1; n <= $#; n++)); do
+    "$TOOLS/instrumentdisassembler" "${!n}" > "$WORK/instr$n.inc"
+    INCS+=("instr$n.inc")
+done
+
+(cd "$TOOLS/.." && cp 4klang.asm $RENDER_SOURCES $RENDER_HEADERS "$WORK")
+(
+    cd "$WORK"
+    NULLTEST_PATTERN=$PATTERN NULLTEST_PATTERNS=$PATTERNS node "$TOOLS/nulltest.inc.js" "${INCS[@]}"
+    yasm -f elf32 4klang.asm
+    gcc -m32 -pthread -I"$TOOLS/.." 4klang.o $RENDER_SOURCES -o 4klangrender
+    ./4klangrender > asm.raw 2> /dev/null
+
+    # the rdtsc of a GO4K_PROFILE build and the sub-tick periods of -d change the timing, never the samples
+    yasm -f elf32 -DGO4K_PROFILE -o profile.o 4klang.asm
+    gcc -m32 -pthread -DGO4K_PROFILE -I"$TOOLS/.." profile.o $RENDER_SOURCES -o 4klangprofile
+    ./4klangprofile -U units.txt > profile.raw 2> /dev/null
+    cmp asm.raw profile.raw || { echo "GO4K_PROFILE build differs from 4klang.asm" >&2; exit 1; }
+    # the ALSA file plugin writes what -d plays, on top of the null device
+    if gcc -m32 -pthread -DALSA_OUTPUT -I"$TOOLS/.." 4klang.o $RENDER_SOURCES -lasound -o 4klangdevice 2> /dev/null
+        then
+            for PERIOD in 16 100 256; do
+                ./4klangdevice -d "file:FILE=period$PERIOD.raw,FORMAT=raw" -p $PERIOD 2> /dev/null
+                cmp asm.raw period$PERIOD.raw || { echo "-p $PERIOD periods differ from the whole ticks" >&2; exit 1; }
+            done
+        else
+            echo "No 32 bit libasound, sub-tick periods not tested" >&2
+    fi
+    ./4klangrender -B nulltest > bench.json 2> /dev/null
+    node -e "const b = JSON.parse(require('fs').readFileSync('bench.json')); process.exit(b.realtime > 0 && b.instruments.length ? 0 : 1)" ||
+        { echo "-B printed no benchmark" >&2; exit 1; }
+)
+
+"$TOOLS/go4krender" -p "$PATTERN" -t $((PATTERNS * 16)) -c "$WORK/asm.raw" "$@"
+# the instruments optimized with -O against the asm of the instruments as they are
+"$TOOLS/go4krender" -O -p "$PATTERN" -t $((PATTERNS * 16)) -c "$WORK/asm.raw" "$@"
@@ -0,0 +1,116 @@
+#include "SynthModule.h"
+#include <dlfcn.h>
+
+/**
+ * Runs a synth compiled to a native shared object, with no VM boundary.
+ *
+ * The shared object must export the same ABI as the wasm modules:
+ *
+ *   extern "C" void shortmessage(int status, int data1, int data2);
+ *   extern "C" void fillSampleBufferWithNumSamples(int numSamples);
+ *   extern "C" float samplebuffer[256];   // 128 left samples followed by 128 right samples
+ *
+ * and optionally `extern "C" float SAMPLERATE;`, which is written before the first render
+ * (the wasm modules import it as `environment.SAMPLERATE`), and
+ * `extern "C" void init();`, which is called after the samplerate has been written.
+ * Parameters are exported the same way as from the wasm modules, as `int parametercount`,
+ * `uint8_t parameterdescriptors[]` and `float parameterblock[]`.
+ *
+ * Every instance dlopens its own copy of the file, so the same synth can be loaded several
+ * times (e.g. next to the wasm build of it for A/B comparison) without sharing state.
+ */
+class NativeSynthModule final : public SynthModule
+{
+public:
+    ~NativeSynthModule() override
+    {
+        if (handle)
+            dlclose(handle);
+        if (instanceFile.existsAsFile())
+            instanceFile.deleteFile();
+    }
+
+    bool load(const juce::String &sharedObjectPath)
+    {
+        juce::File sourceFile(sharedObjectPath);
+        juce::File tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
+        instanceFile = tempDir.getChildFile(sourceFile.getFileNameWithoutExtension() + "-" + juce::Uuid().toString() + sourceFile.getFileExtension());
+
+        if (!sourceFile.copyFileTo(instanceFile)) {
+            printf("Failed to copy native synth %s\n", sharedObjectPath.toRawUTF8());
+            return false;
+        }
+
+        printf("Loading native synth: %s\n", sharedObjectPath.toRawUTF8());
+        handle = dlopen(instanceFile.getFullPathName().toRawUTF8(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == NULL) {
+            printf("Failed to load native synth: %s\n", dlerror());
+            return false;
+        }
+
+        shortmessageFunc = (ShortMessageFunc)dlsym(handle, "shortmessage");
+        fillSampleBufferFunc = (FillSampleBufferFunc)dlsym(handle, "fillSampleBufferWithNumSamples");
+        renderbuf = (const float *)dlsym(handle, "samplebuffer");
+        sampleRateSymbol = (float *)dlsym(handle, "SAMPLERATE");
+        initFunc = (InitFunc)dlsym(handle, "init");
+
+        if (shortmessageFunc == NULL || fillSampleBufferFunc == NULL || renderbuf == NULL) {
+            printf("Native synth does not export shortmessage, fillSampleBufferWithNumSamples and samplebuffer\n");
+            return false;
+        }
+        printf("Native synth loaded successfully.\n");
+        return true;
+    }
+
+    bool prepare(double sampleRate) override
+    {
+        if (handle == NULL)
+            return false;
+        if (sampleRateSymbol != NULL)
+            *sampleRateSymbol = (float)sampleRate;
+        if (initFunc != NULL)
+            initFunc();
+
+        // read after init(), which is where a native build declares its parameters
+        const int *parameterCount = (const int *)dlsym(handle, "parametercount");
+        setParameters((const uint8_t *)dlsym(handle, "parameterdescriptors"),
+                      parameterCount != NULL ? *parameterCount : 0,
+                      (float *)dlsym(handle, "parameterblock"));
+        printf("Native synth prepared for samplerate %f\n", sampleRate);
+        return true;
+    }
+
+    void shortMessage(uint8_t status, uint8_t data1, uint8_t data2) override
+    {
+        shortmessageFunc(status, data1, data2);
+    }
+
+    void fillSampleBuffer(int numSamples) override
+    {
+        fillSampleBufferFunc(numSamples);
+    }
+
+    const float *getSampleBuffer() const override { return renderbuf; }
+    Backend getBackend() const override { return Backend::Native; }
+
+private:
+    typedef void (*ShortMessageFunc)(int, int, int);
+    typedef void (*FillSampleBufferFunc)(int);
+    typedef void (*InitFunc)();
+
+    juce::File instanceFile;
+    void *handle = NULL;
+    ShortMessageFunc shortmessageFunc = NULL;
+    FillSampleBufferFunc fillSampleBufferFunc = NULL;
+    InitFunc initFunc = NULL;
+    float *sampleRateSymbol = NULL;
+    const float *renderbuf = NULL;
+};
+
+std::unique_ptr<SynthModule> SynthModule::createNative(const juce::String &sharedObjectPath)
+{
+    auto module = std::make_unique<NativeSynthModule>();
+    if (!module->load(sharedObjectPath))
+        return nullptr;
+    return module;
+}
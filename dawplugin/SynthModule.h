@@ -0,0 +1,168 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/**
+ * Execution cost of a synth module, attributed per export and per MIDI channel.
+ */
+struct SynthModuleProfile
+{
+    struct ExportStats
+    {
+        juce::String name;
+        uint64_t calls = 0;
+        uint64_t instructions = 0; // executed wasm instructions
+        uint64_t cost = 0;         // instructions weighted by the cost table
+        double seconds = 0;        // wall time spent inside the export
+    };
+
+    std::vector<ExportStats> exports;
+    // Instructions of sampled fillSampleBufferWithNumSamples calls, split over the MIDI channels
+    // by their number of active voices at the time of the sample
+    std::array<uint64_t, 16> channelInstructions {};
+    std::array<uint64_t, 16> channelVoices {};
+    uint64_t voiceSamples = 0;
+
+    juce::var toVar() const
+    {
+        juce::Array<juce::var> exportsArray;
+        for (const auto &exportStats : exports)
+        {
+            juce::DynamicObject::Ptr obj = new juce::DynamicObject();
+            obj->setProperty("name", exportStats.name);
+            obj->setProperty("calls", (juce::int64)exportStats.calls);
+            obj->setProperty("instructions", (juce::int64)exportStats.instructions);
+            obj->setProperty("cost", (juce::int64)exportStats.cost);
+            obj->setProperty("seconds", exportStats.seconds);
+            exportsArray.add(juce::var(obj.get()));
+        }
+
+        juce::Array<juce::var> channelsArray;
+        for (int channel = 0; channel < 16; channel++)
+        {
+            juce::DynamicObject::Ptr obj = new juce::DynamicObject();
+            obj->setProperty("channel", channel + 1);
+            obj->setProperty("instructions", (juce::int64)channelInstructions[channel]);
+            obj->setProperty("averageVoices", voiceSamples > 0 ? (double)channelVoices[channel] / voiceSamples : 0.0);
+            channelsArray.add(juce::var(obj.get()));
+        }
+
+        juce::DynamicObject::Ptr profile = new juce::DynamicObject();
+        profile->setProperty("exports", exportsArray);
+        profile->setProperty("channels", channelsArray);
+        profile->setProperty("voiceSamples", (juce::int64)voiceSamples);
+        return juce::var(profile.get());
+    }
+};
+
+/**
+ * A loaded synth kernel exposing the WebAssembly Music module ABI:
+ *
+ *   shortmessage(status, data1, data2)
+ *   fillSampleBufferWithNumSamples(numSamples)
+ *   samplebuffer - 128 left samples followed by 128 right samples
+ *
+ * and optionally host automatable parameters (see synth1/assembly/midi/parameters.ts):
+ *
+ *   parametercount       - number of declared parameters
+ *   parameterdescriptors - parametercount descriptors of 32 bytes zero padded UTF-8 name, f32 min, max and default
+ *   parameterblock       - parametercount floats, read by the module while rendering
+ *
+ * The same ABI is served either by a WebAssembly module running in WasmEdge,
+ * or by a native shared object exporting the same symbols (see NativeSynthModule.cpp).
+ */
+class SynthModule
+{
+public:
+    static constexpr int sampleBufferFrames = 128;
+    static constexpr int maxParameters = 32;
+    static constexpr int parameterNameLength = 32;
+    static constexpr int parameterDescriptorSize = parameterNameLength + 3 * 4;
+
+    struct Parameter
+    {
+        juce::String name;
+        float minValue;
+        float maxValue;
+        float defaultValue;
+    };
+
+    enum class Backend
+    {
+        WasmEdge,
+        Native
+    };
+
+    virtual ~SynthModule() = default;
+
+    // (Re)initializes the module for the given samplerate. Returns false if the module is not usable.
+    virtual bool prepare(double sampleRate) = 0;
+    virtual void shortMessage(uint8_t status, uint8_t data1, uint8_t data2) = 0;
+    virtual void fillSampleBuffer(int numSamples) = 0;
+    // Left channel in [0, sampleBufferFrames), right channel in [sampleBufferFrames, 2 * sampleBufferFrames)
+    virtual const float *getSampleBuffer() const = 0;
+    virtual Backend getBackend() const = 0;
+
+    // Copies the accumulated execution profile. Returns false if the module was not loaded with profiling.
+    virtual bool getProfile(SynthModuleProfile &) const { return false; }
+
+    // Parameters declared by the module, available after prepare(). Empty if the module has none.
+    const std::vector<Parameter> &getParameters() const { return parameters; }
+    // Values read by the module on the next fillSampleBuffer(), one per parameter. NULL if the module has no parameters.
+    float *getParameterBlock() const { return parameterBlock; }
+
+    static const char *getBackendName(Backend backend)
+    {
+        return backend == Backend::Native ? "native" : "wasmedge";
+    }
+
+    // Native shared objects (.so / .dylib) are loaded with dlopen, anything else is compiled with WasmEdge
+    static Backend backendForFile(const juce::File &file)
+    {
+        return file.hasFileExtension("so;dylib") ? Backend::Native : Backend::WasmEdge;
+    }
+
+    // With profiling the wasm module is compiled with instruction counting and cost measuring,
+    // which makes it slower, so it is only enabled on request.
+    static std::unique_ptr<SynthModule> createWasmEdge(const juce::String &wasmPath, bool profiling = false);
+    static std::unique_ptr<SynthModule> createNative(const juce::String &sharedObjectPath);
+
+    static std::unique_ptr<SynthModule> load(const juce::String &path, bool profiling = false)
+    {
+        if (backendForFile(juce::File(path)) == Backend::Native)
+            return createNative(path);
+        return createWasmEdge(path, profiling);
+    }
+
+protected:
+    // Reads the parameter descriptors exported by the module, with the block the values are written to
+    void setParameters(const uint8_t *descriptors, int count, float *block)
+    {
+        parameters.clear();
+        parameterBlock = NULL;
+        if (descriptors == NULL || block == NULL || count <= 0)
+            return;
+
+        for (int n = 0; n < juce::jmin(count, maxParameters); n++)
+        {
+            const uint8_t *descriptor = descriptors + n * parameterDescriptorSize;
+            Parameter parameter;
+            parameter.name = juce::String::fromUTF8((const char *)descriptor, (int)strnlen((const char *)descriptor, parameterNameLength));
+            memcpy(&parameter.minValue, descriptor + parameterNameLength, 4);
+            memcpy(&parameter.maxValue, descriptor + parameterNameLength + 4, 4);
+            memcpy(&parameter.defaultValue, descriptor + parameterNameLength + 8, 4);
+            if (!(parameter.maxValue > parameter.minValue))
+                parameter.maxValue = parameter.minValue + 1.0f;
+            parameters.push_back(parameter);
+        }
+        parameterBlock = block;
+    }
+
+private:
+    std::vector<Parameter> parameters;
+    float *parameterBlock = NULL;
+};
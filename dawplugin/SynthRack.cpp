@@ -0,0 +1,420 @@
+#include "SynthRack.h"
+#include <limits>
+#include <thread>
+
+/**
+ * Runs the render jobs of a block on a fixed set of threads, with the audio thread taking
+ * jobs as well. Nothing is allocated per block: the job function is set once, and a block
+ * only hands out job indexes.
+ */
+class SynthRack::WorkerPool
+{
+public:
+    WorkerPool(int numWorkers, std::function<void(int)> jobFunction) : job(std::move(jobFunction))
+    {
+        for (int n = 0; n < numWorkers; n++)
+            workers.push_back(std::make_unique<Worker>(*this, n));
+    }
+
+    ~WorkerPool()
+    {
+        stopping = true;
+        for (auto &worker : workers)
+            worker->wake.signal();
+        for (auto &worker : workers)
+            worker->thread.join();
+    }
+
+    // Runs job(0) .. job(numJobs - 1), and returns when all of them are done
+    void run(int numJobs)
+    {
+        const int numWorkersToWake = juce::jmin(numJobs - 1, (int)workers.size());
+        if (numWorkersToWake <= 0)
+        {
+            for (int n = 0; n < numJobs; n++)
+                job(n);
+            return;
+        }
+
+        jobCount = numJobs;
+        nextJob = 0;
+        // a worker may only pick jobs of this block, so wait for all the woken workers to
+        // finish (and not only all the jobs) before the counters are reset for the next block
+        runningWorkers = numWorkersToWake;
+        for (int n = 0; n < numWorkersToWake; n++)
+            workers[n]->wake.signal();
+
+        runJobs();
+        while (runningWorkers.load() > 0)
+            std::this_thread::yield();
+    }
+
+private:
+    struct Worker
+    {
+        Worker(WorkerPool &pool, int index) : thread([&pool, this, index] { pool.workerLoop(*this, index); })
+        {
+        }
+        juce::WaitableEvent wake;
+        std::thread thread;
+    };
+
+    void workerLoop(Worker &worker, int)
+    {
+        for (;;)
+        {
+            worker.wake.wait();
+            if (stopping)
+                return;
+            runJobs();
+            runningWorkers--;
+        }
+    }
+
+    void runJobs()
+    {
+        for (;;)
+        {
+            const int n = nextJob++;
+            if (n >= jobCount)
+                return;
+            job(n);
+        }
+    }
+
+    const std::function<void(int)> job;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> jobCount { 0 };
+    std::atomic<int> nextJob { 0 };
+    std::atomic<int> runningWorkers { 0 };
+    std::atomic<bool> stopping { false };
+};
+
+SynthRack::SynthRack()
+{
+    // the first slot takes all channels, which is how the plugin behaves with a single module
+    slotInfo[0].inputChannels = allChannels;
+    slots[0].inputChannels = allChannels;
+    // the queues never grow beyond this, so the audio thread never allocates, with or without rackLock
+    for (auto &slot : slots)
+        slot.pendingMessages.reserve(maxPendingMessages);
+
+    // the audio thread renders too, so one worker less than there are cores
+    const int numWorkers = juce::jlimit(0, maxSlots - 1, juce::SystemStats::getNumCpus() - 1);
+    workerPool = std::make_unique<WorkerPool>(numWorkers, [this](int n) { renderSlot(renderQueue[n]); });
+}
+
+SynthRack::~SynthRack() = default;
+
+void SynthRack::prepareToPlay(double newSampleRate, int maximumBlockSize)
+{
+    const juce::ScopedLock lock(rackLock);
+    sampleRate = newSampleRate;
+    blockSize = maximumBlockSize;
+    for (auto &slot : slots)
+    {
+        slot.output.setSize(2, maximumBlockSize);
+        for (auto &smoothed : slot.parameterSmoothing)
+            smoothed.reset(newSampleRate, parameterSmoothingSeconds);
+        slot.parameterSmoothingNeedsReset = true;
+    }
+}
+
+void SynthRack::prepareModules()
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    const juce::ScopedLock lock(rackLock);
+    for (int n = 0; n < maxSlots; n++)
+    {
+        auto &info = slotInfo[n];
+        if (info.module == nullptr)
+            continue;
+        if (!info.module->prepare(sampleRate))
+        {
+            printf("Unloading synth module in slot %d, prepare failed\n", n + 1);
+            info.module = nullptr;
+            info.path = juce::String();
+        }
+        applySlotInfo(n);
+    }
+}
+
+void SynthRack::setModule(int slot, std::shared_ptr<SynthModule> module, const juce::String &path)
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    slotInfo[slot].module = std::move(module);
+    slotInfo[slot].path = path;
+    // keep the old module alive until it is released outside of rackLock
+    std::shared_ptr<SynthModule> previousModule;
+    {
+        const juce::ScopedLock lock(rackLock);
+        previousModule = slots[slot].module;
+        applySlotInfo(slot);
+    }
+}
+
+std::shared_ptr<SynthModule> SynthRack::getModule(int slot) const
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    return slotInfo[slot].module;
+}
+
+juce::String SynthRack::getModulePath(int slot) const
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    return slotInfo[slot].path;
+}
+
+void SynthRack::setInputChannels(int slot, uint16_t channelMask)
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    slotInfo[slot].inputChannels = channelMask;
+    const juce::ScopedLock lock(rackLock);
+    applySlotInfo(slot);
+}
+
+uint16_t SynthRack::getInputChannels(int slot) const
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    return slotInfo[slot].inputChannels;
+}
+
+void SynthRack::setModuleChannel(int slot, int channel)
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    slotInfo[slot].moduleChannel = channel;
+    const juce::ScopedLock lock(rackLock);
+    applySlotInfo(slot);
+}
+
+int SynthRack::getModuleChannel(int slot) const
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    return slotInfo[slot].moduleChannel;
+}
+
+std::array<SynthRack::ParameterAssignment, SynthRack::maxSlots> SynthRack::getParameterAssignments() const
+{
+    const juce::ScopedLock infoLock(slotInfoLock);
+    std::array<ParameterAssignment, maxSlots> assignments;
+    int offset = 0;
+    for (int n = 0; n < maxSlots; n++)
+    {
+        const int numParameters = slotInfo[n].module != nullptr ? (int)slotInfo[n].module->getParameters().size() : 0;
+        assignments[n].offset = offset;
+        assignments[n].count = juce::jmin(numParameters, SynthModule::maxParameters - offset);
+        offset += assignments[n].count;
+    }
+    return assignments;
+}
+
+void SynthRack::resetParameterSmoothing()
+{
+    const juce::ScopedLock lock(rackLock);
+    for (auto &slot : slots)
+        slot.parameterSmoothingNeedsReset = true;
+}
+
+void SynthRack::applySlotInfo(int slotIndex)
+{
+    auto &slot = slots[slotIndex];
+    const auto &info = slotInfo[slotIndex];
+    if (slot.module != info.module)
+    {
+        slot.module = info.module;
+        slot.heldNotes = 0;
+        slot.silentSamples = 0;
+    }
+    slot.inputChannels = info.inputChannels;
+    slot.moduleChannel = info.moduleChannel;
+    slot.midiRouting = (slot.module != nullptr ? 0x80000000u : 0u) | ((uint32_t)(slot.moduleChannel & 0x1F) << 16) | slot.inputChannels;
+
+    // parameters of the later slots move when a module with a different number of parameters is loaded
+    const auto assignments = getParameterAssignments();
+    for (int n = 0; n < maxSlots; n++)
+    {
+        slots[n].parameters = assignments[n];
+        slots[n].parameterSmoothingNeedsReset = true;
+    }
+}
+
+float SynthRack::parameterValue(const SynthModule::Parameter &parameter, float normalisedValue)
+{
+    return parameter.minValue + normalisedValue * (parameter.maxValue - parameter.minValue);
+}
+
+bool SynthRack::isIdle(const Slot &slot) const
+{
+    return slot.pendingMessages.empty() && slot.heldNotes == 0 && slot.silentSamples >= (int)(idleAfterSeconds * sampleRate);
+}
+
+static bool isNoteOff(const std::array<uint8_t, 3> &message)
+{
+    const uint8_t command = message[0] & 0xF0;
+    // note-offs, and all sound off, reset controllers, all notes off ...
+    return command == 0x80 || (command == 0x90 && message[2] == 0) || (command == 0xB0 && message[1] >= 120);
+}
+
+void SynthRack::queueMessage(Slot &slot, const std::array<uint8_t, 3> &message)
+{
+    auto &queue = slot.pendingMessages;
+    if ((int)queue.size() < maxPendingMessages - noteOffReserve)
+    {
+        queue.push_back(message);
+        return;
+    }
+    if (!isNoteOff(message))
+    {
+        numDroppedMessages++;
+        return;
+    }
+    if ((int)queue.size() < maxPendingMessages)
+    {
+        queue.push_back(message);
+        return;
+    }
+    // not even room for the note-offs, silence all the notes of the channel instead
+    numDroppedMessages++;
+    queue.back() = { (uint8_t)(0xB0 | (message[0] & 0x0F)), 123, 0 };
+}
+
+void SynthRack::queueMidi(const juce::MidiBuffer &midiMessages, int start, int end)
+{
+    for (const auto metadata : midiMessages)
+    {
+        const uint8_t *rawmessage = metadata.data;
+        if (metadata.samplePosition < start || metadata.samplePosition >= end
+            || metadata.numBytes > 3 || (rawmessage[0] & 0xF0) == 0xF0)
+            continue;
+        const int channel = rawmessage[0] & 0x0F;
+        for (auto &slot : slots)
+        {
+            const uint32_t routing = slot.midiRouting.load();
+            if ((routing & 0x80000000u) == 0 || (routing & (1u << channel)) == 0)
+                continue;
+            const int moduleChannel = (int)((routing >> 16) & 0x1F);
+            const uint8_t status = moduleChannel > 0 ? (uint8_t)((rawmessage[0] & 0xF0) | ((moduleChannel - 1) & 0x0F)) : rawmessage[0];
+            queueMessage(slot, { status,
+                                 metadata.numBytes > 1 ? rawmessage[1] : (uint8_t)0,
+                                 metadata.numBytes > 2 ? rawmessage[2] : (uint8_t)0 });
+        }
+    }
+}
+
+void SynthRack::process(juce::AudioBuffer<float> &buffer, const juce::MidiBuffer &midiMessages,
+                        const std::array<float, SynthModule::maxParameters> &normalisedParameters)
+{
+    buffer.clear();
+    const juce::ScopedTryLock lock(rackLock);
+    const int numSamples = buffer.getNumSamples();
+    if (!lock.isLocked())
+    {
+        // rendered with the next block, so that no note-off gets lost
+        queueMidi(midiMessages, std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+        return;
+    }
+    if (blockSize <= 0)
+    {
+        // nothing to render them with before prepareToPlay
+        for (const auto metadata : midiMessages)
+            if (metadata.numBytes <= 3 && (metadata.data[0] & 0xF0) != 0xF0)
+                numDroppedMessages++;
+        return;
+    }
+
+    // a block larger than announced in prepareToPlay renders in chunks of blockSize, each
+    // with the MIDI of its sample positions
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+    {
+        const int numChunkSamples = juce::jmin(blockSize, numSamples - offset);
+        queueMidi(midiMessages, offset == 0 ? std::numeric_limits<int>::min() : offset,
+                  offset + numChunkSamples < numSamples ? offset + numChunkSamples : std::numeric_limits<int>::max());
+        renderBlock(buffer, offset, numChunkSamples, normalisedParameters);
+    }
+}
+
+void SynthRack::renderBlock(juce::AudioBuffer<float> &buffer, int offset, int numSamples,
+                            const std::array<float, SynthModule::maxParameters> &normalisedParameters)
+{
+    currentBlockSamples = numSamples;
+
+    int numQueued = 0;
+    for (int n = 0; n < maxSlots; n++)
+    {
+        auto &slot = slots[n];
+        if (slot.module == nullptr || slot.module->getSampleBuffer() == NULL)
+        {
+            // queued before the module was unloaded
+            slot.pendingMessages.clear();
+            continue;
+        }
+        if (isIdle(slot))
+            continue;
+
+        const auto &parameters = slot.module->getParameters();
+        for (int p = 0; p < slot.parameters.count; p++)
+        {
+            const float value = parameterValue(parameters[p], normalisedParameters[slot.parameters.offset + p]);
+            if (slot.parameterSmoothingNeedsReset)
+                slot.parameterSmoothing[p].setCurrentAndTargetValue(value);
+            else
+                slot.parameterSmoothing[p].setTargetValue(value);
+        }
+        slot.parameterSmoothingNeedsReset = false;
+        renderQueue[numQueued++] = n;
+    }
+    numActiveSlots = numQueued;
+    workerPool->run(numQueued);
+
+    // the shared mix bus
+    for (int n = 0; n < numQueued; n++)
+    {
+        const auto &slot = slots[renderQueue[n]];
+        for (int channel = 0; channel < 2; channel++)
+            buffer.addFrom(channel, offset, slot.output, channel, 0, currentBlockSamples, 0.3f);
+    }
+}
+
+void SynthRack::renderSlot(int slotIndex)
+{
+    auto &slot = slots[slotIndex];
+    SynthModule &module = *slot.module;
+
+    for (const auto &message : slot.pendingMessages)
+    {
+        const uint8_t command = message[0] & 0xF0;
+        if (command == 0x90 && message[2] > 0)
+            slot.heldNotes++;
+        else if ((command == 0x80 || command == 0x90) && slot.heldNotes > 0)
+            slot.heldNotes--;
+        else if (command == 0xB0 && message[1] >= 120) // all sound off, reset controllers, all notes off ...
+            slot.heldNotes = 0;
+        module.shortMessage(message[0], message[1], message[2]);
+    }
+    slot.pendingMessages.clear();
+
+    float *left = slot.output.getWritePointer(0);
+    float *right = slot.output.getWritePointer(1);
+    const float *renderbuf = module.getSampleBuffer();
+    float *parameterBlock = module.getParameterBlock();
+    bool silent = true;
+
+    for (int sampleNo = 0; sampleNo < currentBlockSamples; sampleNo += SynthModule::sampleBufferFrames)
+    {
+        const int numSamplesToRender = std::min(currentBlockSamples - sampleNo, SynthModule::sampleBufferFrames);
+
+        // one write per parameter and render quantum, straight into the module memory
+        for (int n = 0; n < slot.parameters.count; n++)
+            parameterBlock[n] = slot.parameterSmoothing[n].skip(numSamplesToRender);
+
+        module.fillSampleBuffer(numSamplesToRender);
+
+        for (int ndx = 0; ndx < numSamplesToRender; ndx++)
+        {
+            left[sampleNo + ndx] = renderbuf[ndx];
+            right[sampleNo + ndx] = renderbuf[ndx + SynthModule::sampleBufferFrames];
+            silent = silent && std::abs(renderbuf[ndx]) < 1.0e-5f && std::abs(renderbuf[ndx + SynthModule::sampleBufferFrames]) < 1.0e-5f;
+        }
+    }
+    slot.silentSamples = silent ? slot.silentSamples + currentBlockSamples : 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "SynthModule.h"
+
+/**
+ * Hosts up to maxSlots synth modules in one plugin instance.
+ *
+ * Every slot receives the MIDI channels in its input mask, optionally remapped to one
+ * channel the module listens on. The slots render in parallel on a worker pool shared by
+ * all the slots of the rack, and are summed into one stereo mix bus. A slot with no held
+ * notes whose output has been silent for idleAfterSeconds is not rendered until it receives MIDI again.
+ *
+ * The host parameters are assigned to the module parameters in slot order, so that the
+ * first slot gets the first parameters, and so on until all maxParameters are taken.
+ */
+class SynthRack
+{
+public:
+    static constexpr int maxSlots = 16;
+    static constexpr uint16_t allChannels = 0xFFFF;
+    static constexpr double idleAfterSeconds = 0.5;
+    static constexpr double parameterSmoothingSeconds = 0.02;
+    static constexpr int maxPendingMessages = 1024;
+    // the end of the queue of a slot that only note-offs may take
+    static constexpr int noteOffReserve = 128;
+
+    SynthRack();
+    ~SynthRack();
+
+    // Called with no audio running
+    void prepareToPlay(double sampleRate, int maximumBlockSize);
+    // Re-prepares the loaded modules for the current samplerate, unloading those that fail
+    void prepareModules();
+
+    // Swaps the module of a slot, nullptr empties it. The module must already be prepared.
+    void setModule(int slot, std::shared_ptr<SynthModule> module, const juce::String &path);
+    std::shared_ptr<SynthModule> getModule(int slot) const;
+    juce::String getModulePath(int slot) const;
+
+    // Host MIDI channels (bit n for channel n + 1) routed to the slot
+    void setInputChannels(int slot, uint16_t channelMask);
+    uint16_t getInputChannels(int slot) const;
+    // Channel 1-16 the routed messages are remapped to, or 0 to keep the channel of the message
+    void setModuleChannel(int slot, int channel);
+    int getModuleChannel(int slot) const;
+
+    // First host parameter and number of host parameters assigned to the modules of each slot
+    struct ParameterAssignment
+    {
+        int offset = 0;
+        int count = 0;
+    };
+    std::array<ParameterAssignment, maxSlots> getParameterAssignments() const;
+    // Makes the smoothing of all parameters start over at the host values of the next block,
+    // for when the host parameters have been reassigned
+    void resetParameterSmoothing();
+
+    int getNumActiveSlots() const { return numActiveSlots.load(); }
+    // MIDI messages dropped because the queue of a slot was full, note-offs are never dropped
+    int getNumDroppedMessages() const { return numDroppedMessages.load(); }
+
+    // Renders all slots into buffer, in chunks of the prepared block size if it is larger.
+    // normalisedParameters holds the 0..1 host value of every parameter. The MIDI is queued
+    // for the slots also when the rack is busy being reconfigured and the block stays silent.
+    void process(juce::AudioBuffer<float> &buffer, const juce::MidiBuffer &midiMessages,
+                 const std::array<float, SynthModule::maxParameters> &normalisedParameters);
+
+private:
+    class WorkerPool;
+
+    // Slot configuration as set from the message thread, readable without taking rackLock
+    struct SlotInfo
+    {
+        std::shared_ptr<SynthModule> module;
+        juce::String path;
+        uint16_t inputChannels = 0;
+        int moduleChannel = 0;
+    };
+
+    // Slot state used while rendering, guarded by rackLock
+    struct Slot
+    {
+        std::shared_ptr<SynthModule> module;
+        uint16_t inputChannels = 0;
+        int moduleChannel = 0;
+        ParameterAssignment parameters;
+        std::array<juce::SmoothedValue<float>, SynthModule::maxParameters> parameterSmoothing;
+        bool parameterSmoothingNeedsReset = true;
+
+        // routing of the slot for process(), readable without rackLock: the input channels,
+        // the module channel and whether there is a module, see applySlotInfo
+        std::atomic<uint32_t> midiRouting { 0 };
+        // MIDI queued by process(), also without rackLock, and sent by the thread rendering the slot
+        std::vector<std::array<uint8_t, 3>> pendingMessages;
+        int heldNotes = 0;
+        int silentSamples = 0;
+        juce::AudioBuffer<float> output;
+    };
+
+    // Copies the configuration of a slot to the render state. Called with slotInfoLock held.
+    void applySlotInfo(int slotIndex);
+    static float parameterValue(const SynthModule::Parameter &parameter, float normalisedValue);
+    bool isIdle(const Slot &slot) const;
+    // Queues the messages from sample position start up to end for the slots they are routed to
+    void queueMidi(const juce::MidiBuffer &midiMessages, int start, int end);
+    void queueMessage(Slot &slot, const std::array<uint8_t, 3> &message);
+    // Renders the slots and mixes numSamples of them into buffer at offset. Called with rackLock held.
+    void renderBlock(juce::AudioBuffer<float> &buffer, int offset, int numSamples,
+                     const std::array<float, SynthModule::maxParameters> &normalisedParameters);
+    void renderSlot(int slotIndex);
+
+    mutable juce::CriticalSection slotInfoLock;
+    std::array<SlotInfo, maxSlots> slotInfo;
+    mutable juce::CriticalSection rackLock;
+    std::array<Slot, maxSlots> slots;
+    double sampleRate = 44100.0;
+    int blockSize = 0;
+    int currentBlockSamples = 0;
+
+    // slots rendered in the current block, filled by process() for the workers
+    std::array<int, maxSlots> renderQueue {};
+    std::atomic<int> numActiveSlots { 0 };
+    std::atomic<int> numDroppedMessages { 0 };
+    std::unique_ptr<WorkerPool> workerPool;
+};
@@ -0,0 +1,353 @@
+#include "SynthModule.h"
+#include <wasmedge/wasmedge.h>
+
+class WasmEdgeSynthModule final : public SynthModule
+{
+public:
+    explicit WasmEdgeSynthModule(bool profilingEnabled) : profiling(profilingEnabled)
+    {
+    }
+
+    ~WasmEdgeSynthModule() override
+    {
+        if (vm_cxt)
+            WasmEdge_VMDelete(vm_cxt);
+        if (environmentModuleInstanceContext)
+            WasmEdge_ModuleInstanceDelete(environmentModuleInstanceContext);
+        WasmEdge_StringDelete(shortMessageFuncNameString);
+        WasmEdge_StringDelete(fillSampleBufferFuncNameString);
+        WasmEdge_StringDelete(activeVoicesSnapshotFuncNameString);
+        // only after the VM is gone, since it keeps the compiled code mapped
+        if (compiledFile.existsAsFile())
+            compiledFile.deleteFile();
+    }
+
+    bool compileAndLoad(const juce::String &wasmPath)
+    {
+        juce::File wasmFile(wasmPath);
+        juce::File tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
+        // every instance compiles to its own file, since another slot, a reload or the instrumented
+        // build of the same wasm would otherwise overwrite a file that is still mapped
+        compiledFile = tempDir.getChildFile(wasmFile.getFileNameWithoutExtension() + "-" + juce::Uuid().toString() + (profiling ? ".profile.so" : ".so"));
+        juce::String tempWasmSo = compiledFile.getFullPathName();
+
+        printf("Compiling Wasm file: %s\n", wasmPath.toRawUTF8());
+        WasmEdge_ConfigureContext *ConfCxt = WasmEdge_ConfigureCreate();
+        if (profiling) {
+            WasmEdge_ConfigureCompilerSetInstructionCounting(ConfCxt, true);
+            WasmEdge_ConfigureCompilerSetCostMeasuring(ConfCxt, true);
+        }
+        WasmEdge_CompilerContext *CompilerCxt = WasmEdge_CompilerCreate(ConfCxt);
+        WasmEdge_Result compResult = WasmEdge_CompilerCompile(CompilerCxt, wasmPath.toRawUTF8(), tempWasmSo.toRawUTF8());
+        WasmEdge_CompilerDelete(CompilerCxt);
+
+        if (!WasmEdge_ResultOK(compResult)) {
+            printf("Failed to compile Wasm file. Error code: %u\n", compResult.Code);
+            WasmEdge_ConfigureDelete(ConfCxt);
+            return false;
+        }
+
+        if (profiling) {
+            WasmEdge_ConfigureStatisticsSetInstructionCounting(ConfCxt, true);
+            WasmEdge_ConfigureStatisticsSetCostMeasuring(ConfCxt, true);
+            WasmEdge_ConfigureStatisticsSetTimeMeasuring(ConfCxt, true);
+        }
+        vm_cxt = WasmEdge_VMCreate(ConfCxt, NULL);
+        WasmEdge_ConfigureDelete(ConfCxt);
+
+        WasmEdge_Result loadResult = WasmEdge_VMLoadWasmFromFile(vm_cxt, tempWasmSo.toRawUTF8());
+        if (!WasmEdge_ResultOK(loadResult)) {
+            printf("Failed to load Wasm file. Error code: %u\n", loadResult.Code);
+            return false;
+        }
+        printf("Wasm file loaded successfully.\n");
+        return true;
+    }
+
+    bool prepare(double sampleRate) override
+    {
+        if (vm_cxt == NULL) {
+            printf("Wasm VM context is NULL\n");
+            return false;
+        }
+        renderbuf = NULL;
+        if (environmentModuleInstanceContext != NULL) {
+            WasmEdge_ModuleInstanceDelete(environmentModuleInstanceContext);
+        }
+        WasmEdge_String environmentName = WasmEdge_StringCreateByCString("environment");
+        environmentModuleInstanceContext = WasmEdge_ModuleInstanceCreate(environmentName);
+        WasmEdge_StringDelete(environmentName);
+
+        WasmEdge_GlobalTypeContext *SAMPLERATE_type = WasmEdge_GlobalTypeCreate(WasmEdge_ValTypeGenF32(), WasmEdge_Mutability_Const);
+        WasmEdge_GlobalInstanceContext *SAMPLERATE_global = WasmEdge_GlobalInstanceCreate(SAMPLERATE_type, WasmEdge_ValueGenF32((float)sampleRate));
+        WasmEdge_GlobalTypeDelete(SAMPLERATE_type);
+        WasmEdge_String sampleRateName = WasmEdge_StringCreateByCString("SAMPLERATE");
+        WasmEdge_ModuleInstanceAddGlobal(environmentModuleInstanceContext, sampleRateName, SAMPLERATE_global);
+        WasmEdge_StringDelete(sampleRateName);
+        WasmEdge_VMRegisterModuleFromImport(vm_cxt, environmentModuleInstanceContext);
+
+        WasmEdge_VMValidate(vm_cxt);
+        printf("Wasm module validated\n");
+        WasmEdge_Result instantiateResult = WasmEdge_VMInstantiate(vm_cxt);
+        if (!WasmEdge_ResultOK(instantiateResult)) {
+            printf("Failed to instantiate Wasm module. Error code: %u\n", instantiateResult.Code);
+            return false;
+        }
+        printf("Wasm module instantiated\n");
+
+        const WasmEdge_ModuleInstanceContext *moduleCtx = WasmEdge_VMGetActiveModule(vm_cxt);
+        WasmEdge_String sampleBufferName = WasmEdge_StringCreateByCString("samplebuffer");
+        WasmEdge_String memoryName = WasmEdge_StringCreateByCString("memory");
+        WasmEdge_GlobalInstanceContext *globCtx = WasmEdge_ModuleInstanceFindGlobal(moduleCtx, sampleBufferName);
+        memCtx = WasmEdge_ModuleInstanceFindMemory(moduleCtx, memoryName);
+        WasmEdge_StringDelete(sampleBufferName);
+        WasmEdge_StringDelete(memoryName);
+
+        if (globCtx == NULL || memCtx == NULL) {
+            printf("Wasm module does not export samplebuffer and memory\n");
+            return false;
+        }
+
+        WasmEdge_Value globValue = WasmEdge_GlobalInstanceGetValue(globCtx);
+        uint32_t sampleBufferAddrValue = WasmEdge_ValueGetI32(globValue);
+
+        const uint8_t *renderbytebuf = WasmEdge_MemoryInstanceGetPointer(memCtx, sampleBufferAddrValue, sampleBufferFrames * 2 * 4);
+        renderbuf = (const float *)renderbytebuf;
+        printf("Wasm module exports stored\n");
+
+        prepareParameters(moduleCtx);
+        if (profiling)
+            prepareProfile(moduleCtx);
+        return renderbuf != NULL;
+    }
+
+    void shortMessage(uint8_t status, uint8_t data1, uint8_t data2) override
+    {
+        WasmEdge_Value args[3];
+        args[0] = WasmEdge_ValueGenI32(status);
+        args[1] = WasmEdge_ValueGenI32(data1);
+        args[2] = WasmEdge_ValueGenI32(data2);
+        execute(shortMessageExportIndex, shortMessageFuncNameString, args, 3, NULL, 0);
+    }
+
+    void fillSampleBuffer(int numSamples) override
+    {
+        WasmEdge_Value args[1] = {WasmEdge_ValueGenI32((uint32_t)numSamples)};
+        const uint64_t instructions = execute(fillSampleBufferExportIndex, fillSampleBufferFuncNameString, args, 1, NULL, 0);
+
+        if (profiling && hasActiveVoicesSnapshot && ++fillCallsSinceVoiceSample >= voiceSampleInterval) {
+            fillCallsSinceVoiceSample = 0;
+            sampleActiveVoices(instructions);
+        }
+        if (profiling)
+            publishProfile();
+    }
+
+    const float *getSampleBuffer() const override { return renderbuf; }
+    Backend getBackend() const override { return Backend::WasmEdge; }
+
+    bool getProfile(SynthModuleProfile &profileCopy) const override
+    {
+        if (!profiling)
+            return false;
+        const juce::SpinLock::ScopedLockType lock(profileLock);
+        profileCopy = publishedProfile;
+        return true;
+    }
+
+private:
+    static bool findGlobalI32(const WasmEdge_ModuleInstanceContext *moduleCtx, const char *name, uint32_t &value)
+    {
+        WasmEdge_String globalName = WasmEdge_StringCreateByCString(name);
+        WasmEdge_GlobalInstanceContext *globalCtx = WasmEdge_ModuleInstanceFindGlobal(moduleCtx, globalName);
+        WasmEdge_StringDelete(globalName);
+        if (globalCtx == NULL)
+            return false;
+        value = (uint32_t)WasmEdge_ValueGetI32(WasmEdge_GlobalInstanceGetValue(globalCtx));
+        return true;
+    }
+
+    // The parameter block lives in linear memory, so the host writes the values without calling into the module
+    void prepareParameters(const WasmEdge_ModuleInstanceContext *moduleCtx)
+    {
+        uint32_t parameterCount = 0, descriptorsAddr = 0, blockAddr = 0;
+        if (!findGlobalI32(moduleCtx, "parametercount", parameterCount)
+            || !findGlobalI32(moduleCtx, "parameterdescriptors", descriptorsAddr)
+            || !findGlobalI32(moduleCtx, "parameterblock", blockAddr)
+            || parameterCount == 0) {
+            setParameters(NULL, 0, NULL);
+            return;
+        }
+        const int count = juce::jmin((int)parameterCount, maxParameters);
+        const uint8_t *descriptors = WasmEdge_MemoryInstanceGetPointer(memCtx, descriptorsAddr, count * parameterDescriptorSize);
+        uint8_t *block = WasmEdge_MemoryInstanceGetPointer(memCtx, blockAddr, count * 4);
+        setParameters(descriptors, count, (float *)block);
+        printf("Wasm module has %d parameters\n", (int)getParameters().size());
+    }
+
+    // fillSampleBufferWithNumSamples calls between each sample of the active voices
+    static constexpr int voiceSampleInterval = 16;
+    // matches MAX_ACTIVE_VOICES in synth1/assembly/midi/midisynth.ts, 3 bytes (channel, note, velocity) per voice
+    static constexpr int maxActiveVoices = 32;
+
+    // Relative cost of the wasm opcodes that are notably more expensive than a simple arithmetic instruction.
+    // All other opcodes cost 1, so that the total cost stays comparable to the instruction count.
+    static void fillCostTable(std::vector<uint64_t> &costTable)
+    {
+        costTable.assign(65536, 1);
+        costTable[0x10] = 4;   // call
+        costTable[0x11] = 8;   // call_indirect
+        costTable[0x40] = 100; // memory.grow
+        costTable[0x6D] = costTable[0x6E] = costTable[0x6F] = costTable[0x70] = 20; // i32.div/rem
+        costTable[0x7F] = costTable[0x80] = costTable[0x81] = costTable[0x82] = 40; // i64.div/rem
+        costTable[0x91] = 15;  // f32.sqrt
+        costTable[0x95] = 10;  // f32.div
+        costTable[0x9F] = 20;  // f64.sqrt
+        costTable[0xA3] = 20;  // f64.div
+    }
+
+    void prepareProfile(const WasmEdge_ModuleInstanceContext *moduleCtx)
+    {
+        statCxt = WasmEdge_VMGetStatisticsContext(vm_cxt);
+        fillCostTable(costTable);
+        WasmEdge_StatisticsSetCostTable(statCxt, costTable.data(), (uint32_t)costTable.size());
+
+        // list every exported function, so that exports the host never calls show up with zero cost
+        pendingProfile = SynthModuleProfile();
+        const uint32_t numFunctions = WasmEdge_ModuleInstanceListFunctionLength(moduleCtx);
+        std::vector<WasmEdge_String> functionNames(numFunctions);
+        WasmEdge_ModuleInstanceListFunction(moduleCtx, functionNames.data(), numFunctions);
+        for (const auto &functionName : functionNames) {
+            SynthModuleProfile::ExportStats exportStats;
+            exportStats.name = juce::String::fromUTF8(functionName.Buf, (int)functionName.Length);
+            pendingProfile.exports.push_back(exportStats);
+        }
+        shortMessageExportIndex = findExport("shortmessage");
+        fillSampleBufferExportIndex = findExport("fillSampleBufferWithNumSamples");
+        activeVoicesSnapshotExportIndex = findExport("getActiveVoicesStatusSnapshot");
+        hasActiveVoicesSnapshot = activeVoicesSnapshotExportIndex >= 0;
+
+        const juce::SpinLock::ScopedLockType lock(profileLock);
+        publishedProfile = pendingProfile;
+        for (auto &exportStats : pendingProfile.exports)
+            exportStats = SynthModuleProfile::ExportStats { exportStats.name };
+    }
+
+    int findExport(const char *name) const
+    {
+        for (size_t n = 0; n < pendingProfile.exports.size(); n++)
+            if (pendingProfile.exports[n].name == name)
+                return (int)n;
+        return -1;
+    }
+
+    // Executes an export, and when profiling attributes its instructions, cost and wall time to it.
+    // Returns the number of instructions executed by the call.
+    uint64_t execute(int exportIndex, const WasmEdge_String &funcName, const WasmEdge_Value *params, uint32_t paramLen,
+                     WasmEdge_Value *returns, uint32_t returnLen)
+    {
+        if (!profiling || exportIndex < 0) {
+            WasmEdge_VMExecute(vm_cxt, funcName, params, paramLen, returns, returnLen);
+            return 0;
+        }
+        const uint64_t instructionsBefore = WasmEdge_StatisticsGetInstrCount(statCxt);
+        const uint64_t costBefore = WasmEdge_StatisticsGetTotalCost(statCxt);
+        const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+
+        WasmEdge_VMExecute(vm_cxt, funcName, params, paramLen, returns, returnLen);
+
+        const juce::int64 elapsedTicks = juce::Time::getHighResolutionTicks() - startTicks;
+        const uint64_t instructions = WasmEdge_StatisticsGetInstrCount(statCxt) - instructionsBefore;
+
+        auto &exportStats = pendingProfile.exports[exportIndex];
+        exportStats.calls++;
+        exportStats.instructions += instructions;
+        exportStats.cost += WasmEdge_StatisticsGetTotalCost(statCxt) - costBefore;
+        exportStats.seconds += juce::Time::highResolutionTicksToSeconds(elapsedTicks);
+        return instructions;
+    }
+
+    // Splits the instructions of a render call over the MIDI channels by their number of active voices,
+    // so that the cost of the instrument on each channel can be estimated.
+    void sampleActiveVoices(uint64_t renderInstructions)
+    {
+        WasmEdge_Value snapshotAddress[1];
+        execute(activeVoicesSnapshotExportIndex, activeVoicesSnapshotFuncNameString, NULL, 0, snapshotAddress, 1);
+        const uint8_t *snapshot = WasmEdge_MemoryInstanceGetPointer(memCtx, (uint32_t)WasmEdge_ValueGetI32(snapshotAddress[0]), maxActiveVoices * 3);
+        if (snapshot == NULL)
+            return;
+
+        std::array<int, 16> voicesPerChannel {};
+        int totalVoices = 0;
+        for (int n = 0; n < maxActiveVoices; n++) {
+            const uint8_t *voice = snapshot + n * 3;
+            // unused slots are zeroed, and an active voice always has a velocity
+            if (voice[2] == 0)
+                continue;
+            voicesPerChannel[voice[0] & 0x0F]++;
+            totalVoices++;
+        }
+
+        pendingProfile.voiceSamples++;
+        for (int channel = 0; channel < 16; channel++) {
+            pendingProfile.channelVoices[channel] += voicesPerChannel[channel];
+            if (totalVoices > 0)
+                pendingProfile.channelInstructions[channel] += renderInstructions * voicesPerChannel[channel] / totalVoices;
+        }
+    }
+
+    // Moves the counters accumulated on the audio thread into the profile read by the editor.
+    // If the editor is reading at the moment, the counters are kept for the next attempt.
+    void publishProfile()
+    {
+        const juce::SpinLock::ScopedTryLockType lock(profileLock);
+        if (!lock.isLocked())
+            return;
+        for (size_t n = 0; n < pendingProfile.exports.size(); n++) {
+            auto &pending = pendingProfile.exports[n];
+            auto &published = publishedProfile.exports[n];
+            published.calls += pending.calls;
+            published.instructions += pending.instructions;
+            published.cost += pending.cost;
+            published.seconds += pending.seconds;
+            pending = SynthModuleProfile::ExportStats { pending.name };
+        }
+        for (int channel = 0; channel < 16; channel++) {
+            publishedProfile.channelInstructions[channel] += pendingProfile.channelInstructions[channel];
+            publishedProfile.channelVoices[channel] += pendingProfile.channelVoices[channel];
+        }
+        publishedProfile.voiceSamples += pendingProfile.voiceSamples;
+        pendingProfile.channelInstructions.fill(0);
+        pendingProfile.channelVoices.fill(0);
+        pendingProfile.voiceSamples = 0;
+    }
+
+    const bool profiling;
+    juce::File compiledFile;
+    WasmEdge_VMContext *vm_cxt = NULL;
+    WasmEdge_ModuleInstanceContext *environmentModuleInstanceContext = NULL;
+    WasmEdge_MemoryInstanceContext *memCtx = NULL;
+    WasmEdge_StatisticsContext *statCxt = NULL;
+    WasmEdge_String shortMessageFuncNameString = WasmEdge_StringCreateByCString("shortmessage");
+    WasmEdge_String fillSampleBufferFuncNameString = WasmEdge_StringCreateByCString("fillSampleBufferWithNumSamples");
+    WasmEdge_String activeVoicesSnapshotFuncNameString = WasmEdge_StringCreateByCString("getActiveVoicesStatusSnapshot");
+    const float *renderbuf = NULL;
+
+    std::vector<uint64_t> costTable;
+    int shortMessageExportIndex = -1;
+    int fillSampleBufferExportIndex = -1;
+    int activeVoicesSnapshotExportIndex = -1;
+    bool hasActiveVoicesSnapshot = false;
+    int fillCallsSinceVoiceSample = 0;
+    SynthModuleProfile pendingProfile;
+    SynthModuleProfile publishedProfile;
+    juce::SpinLock profileLock;
+};
+
+std::unique_ptr<SynthModule> SynthModule::createWasmEdge(const juce::String &wasmPath, bool profiling)
+{
+    auto module = std::make_unique<WasmEdgeSynthModule>(profiling);
+    if (!module->compileAndLoad(wasmPath))
+        return nullptr;
+    return module;
+}
@@ -1,217 +1,22 @@
-#include <JuceHeader.h>
-#include <wasmedge/wasmedge.h>
-#include <string> // Add this for std::string
-
-class WebAssemblyMusicSynth; // Forward declare
-
-class WebAssemblyMusicSynthEditor : public juce::AudioProcessorEditor,
-                            private juce::ComboBox::Listener,
-                            private juce::Button::Listener
-{
-public:
-    explicit WebAssemblyMusicSynthEditor(WebAssemblyMusicSynth &p);
-    void resized() override;
-
-private:
-    void comboBoxChanged(juce::ComboBox *comboBoxThatHasChanged) override;
-    void buttonClicked(juce::Button* button) override;
-
-    WebAssemblyMusicSynth &processor;
-    juce::ComboBox instrumentSelector;
-    juce::TextButton browseButton { "Browse Wasm File" };
-    juce::Label wasmFileLabel;
-    std::unique_ptr<juce::FileChooser> wasmChooser;
-
-    // Added for Wasm download feature
-    juce::TextEditor accessMessageInput;
-    juce::TextButton downloadButton { "Download & Load Wasm" };
-};
-class WebAssemblyMusicSynth final : public AudioProcessor
-{
-public:
-    WebAssemblyMusicSynth()
-        : AudioProcessor(BusesProperties().withOutput("Output", AudioChannelSet::stereo()))
-    {
-    }
-
-    void compileAndLoadWasm(const juce::String& wasmPath)
-    {
-        juce::File wasmFile(wasmPath);
-        juce::File tempDir = juce::File::getSpecialLocation(juce::File::tempDirectory);
-        juce::String baseName = wasmFile.getFileName();
-        juce::String tempWasmSo = tempDir.getChildFile(baseName + ".so").getFullPathName();
-
-        printf("Compiling Wasm file: %s\n", wasmPath.toRawUTF8());
-        WasmEdge_ConfigureContext *ConfCxt = WasmEdge_ConfigureCreate();
-        WasmEdge_CompilerContext *CompilerCxt = WasmEdge_CompilerCreate(ConfCxt);
-        WasmEdge_Result compResult = WasmEdge_CompilerCompile(CompilerCxt, wasmPath.toRawUTF8(), tempWasmSo.toRawUTF8());
-        WasmEdge_CompilerDelete(CompilerCxt);
-        WasmEdge_ConfigureDelete(ConfCxt);
-
-        if (!WasmEdge_ResultOK(compResult)) {
-            printf("Failed to compile Wasm file. Error code: %u\n", compResult.Code);
-            return;
-        }
-
-        if (vm_cxt) {
-            WasmEdge_VMDelete(vm_cxt);
-            renderbuf = NULL;
-        }
-        vm_cxt = WasmEdge_VMCreate(NULL, NULL);
-        WasmEdge_Result loadResult = WasmEdge_VMLoadWasmFromFile(vm_cxt, tempWasmSo.toRawUTF8());
-        if (WasmEdge_ResultOK(loadResult)) {
-            WasmEdge_VMValidate(vm_cxt);
-            WasmEdge_VMInstantiate(vm_cxt);
-            printf("Wasm file loaded and instantiated successfully.\n");
-        } else {
-            printf("Failed to load Wasm file. Error code: %u\n", loadResult.Code);
-        }
-    }
-
-    static String getIdentifier()
-    {
-        return "WasmEdge Synth";
-    }
-
-    void prepareToPlay(double newSampleRate, int) override
-    {
-        synth.setCurrentPlaybackSampleRate(newSampleRate);
-        printf("Samplerate is %f\n", newSampleRate);
-        prepareWasm();
-    }
-
-    void prepareWasm() {
-        if (vm_cxt == NULL) {
-            printf("Wasm VM context is NULL\n");
-            return;
-        }
-        double newSampleRate = synth.getSampleRate();
-        if (environmentModuleInstanceContext != NULL) {
-            WasmEdge_ModuleInstanceDelete(environmentModuleInstanceContext);
-        }
-        environmentModuleInstanceContext = WasmEdge_ModuleInstanceCreate(WasmEdge_StringCreateByCString("environment"));
-        
-        WasmEdge_GlobalTypeContext *SAMPLERATE_type = WasmEdge_GlobalTypeCreate(WasmEdge_ValTypeGenF32(), WasmEdge_Mutability_Const);
-        WasmEdge_GlobalInstanceContext *SAMPLERATE_global = WasmEdge_GlobalInstanceCreate(SAMPLERATE_type, WasmEdge_ValueGenF32(newSampleRate));
-        WasmEdge_ModuleInstanceAddGlobal(environmentModuleInstanceContext, WasmEdge_StringCreateByCString("SAMPLERATE"), SAMPLERATE_global);
-        WasmEdge_VMRegisterModuleFromImport(vm_cxt, environmentModuleInstanceContext);
-
-        WasmEdge_VMValidate(vm_cxt);
-        printf("Wasm module validatedf\n");
-        WasmEdge_VMInstantiate(vm_cxt);
-
-        printf("Wasm module instantiated\n");
-
-        const WasmEdge_ModuleInstanceContext *moduleCtx = WasmEdge_VMGetActiveModule(vm_cxt);
-        WasmEdge_GlobalInstanceContext *globCtx = WasmEdge_ModuleInstanceFindGlobal(moduleCtx, WasmEdge_StringCreateByCString("samplebuffer"));
-        WasmEdge_MemoryInstanceContext *memCtx = WasmEdge_ModuleInstanceFindMemory(moduleCtx, WasmEdge_StringCreateByCString("memory"));
-
-        fillSampleBufferFuncNameString = WasmEdge_StringCreateByCString("fillSampleBufferWithNumSamples");
-        WasmEdge_Value globValue = WasmEdge_GlobalInstanceGetValue(globCtx);
-        uint32_t sampleBufferAddrValue = WasmEdge_ValueGetI32(globValue);
-
-        const uint8_t *renderbytebuf = WasmEdge_MemoryInstanceGetPointer(memCtx, sampleBufferAddrValue, 128 * 2 * 4);
-        renderbuf = (float32_t *)renderbytebuf;
-        printf("Wasm module exports stored\n");
-
-        printf("Prepare completed\n");
-    }
-
-    void selectInstrument(int instrumentId)
-    {
-        selectedInstrumentId = instrumentId;
-        printf("Selected instrument ID: %d\n", instrumentId);
-    }
-
-    void loadWasmFile(const juce::String& filePath)
-    {
-        compileAndLoadWasm(filePath);
-        prepareWasm();
-    }
-
-    void releaseResources() override
-    {
-    }
-
-    void processBlock(AudioBuffer<float> &buffer, MidiBuffer &midiMessages) override
-    {
-        if (renderbuf == NULL)
-        {
-            return;
-        }
-        for (const auto metadata : midiMessages)
-        {
-            MidiMessage message = metadata.getMessage();
-            const uint8 *rawmessage = message.getRawData();
-
-            // Copy the message so we can modify the channel
-            uint8_t msg0 = (rawmessage[0] & 0xF0) | ((selectedInstrumentId - 1) & 0x0F);
-
-            WasmEdge_Value args[3];
-            args[0] = WasmEdge_ValueGenI32(msg0);
-            args[1] = WasmEdge_ValueGenI32((uint8_t)rawmessage[1]);
-            args[2] = WasmEdge_ValueGenI32((uint8_t)rawmessage[2]);
-            WasmEdge_VMExecute(vm_cxt, WasmEdge_StringCreateByCString("shortmessage"), args, 3, NULL, 0);
-
-            printf("sent midi to wasm synth: %d, %d, %d (channel %d)\n", msg0, rawmessage[1], rawmessage[2], (selectedInstrumentId - 1));
-        }
-
-        int numSamples = buffer.getNumSamples();
-        auto *left = buffer.getWritePointer(0);
-        auto *right = buffer.getWritePointer(1);
-
-        for (int sampleNo = 0; sampleNo < numSamples; sampleNo += 128)
-        {
-            int numSamplesToRender = std::min(numSamples - sampleNo, 128);
-
-            WasmEdge_Value args[1] = {WasmEdge_ValueGenI32((uint32_t)numSamplesToRender)};
-            WasmEdge_Result result = WasmEdge_VMExecute(vm_cxt, fillSampleBufferFuncNameString, args, 1, NULL, 0);
-
-            for (int ndx = 0; ndx < numSamplesToRender; ndx++)
-            {
-                left[sampleNo + ndx] = renderbuf[ndx] * 0.3;
-                right[sampleNo + ndx] = renderbuf[ndx + 128] * 0.3;
-            }
-        }
-    }
-
-    using AudioProcessor::processBlock;
-
-    const String getName() const override { return getIdentifier(); }
-    double getTailLengthSeconds() const override { return 0.0; }
-    bool acceptsMidi() const override { return true; }
-    bool producesMidi() const override { return true; }
-    AudioProcessorEditor *createEditor() override
-    {
-        return new WebAssemblyMusicSynthEditor(*this);
-    }
-
-    bool hasEditor() const override
-    {
-        return true;
-    }
-    int getNumPrograms() override { return 1; }
-    int getCurrentProgram() override { return 0; }
-    void setCurrentProgram(int) override {}
-    const String getProgramName(int) override { return {}; }
-    void changeProgramName(int, const String &) override {}
-    void getStateInformation(juce::MemoryBlock &) override {}
-    void setStateInformation(const void *, int) override {}
-
-private:
-    int selectedInstrumentId = 1; // Default to 1 (Piano)
-    WasmEdge_VMContext *vm_cxt;
-    WasmEdge_ModuleInstanceContext *environmentModuleInstanceContext;
-    WasmEdge_String fillSampleBufferFuncNameString;
-    float32_t *renderbuf = NULL;
-    Synthesiser synth;
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WebAssemblyMusicSynth)
-};
+#include "WebAssemblyMusicSynth.h"
 
 WebAssemblyMusicSynthEditor::WebAssemblyMusicSynthEditor(WebAssemblyMusicSynth &p)
     : juce::AudioProcessorEditor(p), processor(p)
 {
-    setSize(400, 200);
+    setSize(400, 440);
+    for (int slot = 1; slot <= SynthRack::maxSlots; slot++)
+        slotSelector.addItem("Slot " + juce::String(slot), slot);
+    slotSelector.setSelectedId(processor.getSelectedSlot() + 1, juce::dontSendNotification);
+    slotSelector.addListener(this);
+    addAndMakeVisible(slotSelector);
+
+    // combo box ids can't be 0, so "all" is 17 here
+    for (int channel = 1; channel <= 16; channel++)
+        inputChannelSelector.addItem("MIDI in " + juce::String(channel), channel);
+    inputChannelSelector.addItem("MIDI in all", 17);
+    inputChannelSelector.addListener(this);
+    addAndMakeVisible(inputChannelSelector);
+
     instrumentSelector.addItem("Channel 1", 1);
     instrumentSelector.addItem("Channel 2", 2);
     instrumentSelector.addItem("Channel 3", 3);
@@ -228,14 +33,26 @@ WebAssemblyMusicSynthEditor::WebAssemblyMusicSynthEditor(WebAssemblyMusicSynth &
     instrumentSelector.addItem("Channel 14", 14);
     instrumentSelector.addItem("Channel 15", 15);
     instrumentSelector.addItem("Channel 16", 16);
-    instrumentSelector.setSelectedId(1);
+    instrumentSelector.addItem("Keep channel", 17);
     instrumentSelector.addListener(this);
     addAndMakeVisible(instrumentSelector);
 
     addAndMakeVisible(browseButton);
     browseButton.addListener(this);
     addAndMakeVisible(wasmFileLabel);
-    wasmFileLabel.setText("No wasm file selected", juce::dontSendNotification);
+    addAndMakeVisible(renderLoadLabel);
+    updateSlotControls();
+
+    addAndMakeVisible(profileToggle);
+    profileToggle.setToggleState(processor.isProfilingEnabled(), juce::dontSendNotification);
+    profileToggle.addListener(this);
+    addAndMakeVisible(saveProfileButton);
+    saveProfileButton.addListener(this);
+    addAndMakeVisible(profileView);
+    profileView.setMultiLine(true);
+    profileView.setReadOnly(true);
+    profileView.setFont(juce::FontOptions(juce::Font::getDefaultMonospacedFontName(), 12.0f, juce::Font::plain));
+    startTimerHz(4);
 
     // Initialize and add new UI elements for Wasm download
     addAndMakeVisible(accessMessageInput);
@@ -250,29 +67,141 @@ WebAssemblyMusicSynthEditor::WebAssemblyMusicSynthEditor(WebAssemblyMusicSynth &
 
 void WebAssemblyMusicSynthEditor::resized()
 {
-    instrumentSelector.setBounds(10, 10, getWidth() - 20, 30);
+    const int selectorWidth = (getWidth() - 40) / 3;
+    slotSelector.setBounds(10, 10, selectorWidth, 30);
+    inputChannelSelector.setBounds(20 + selectorWidth, 10, selectorWidth, 30);
+    instrumentSelector.setBounds(30 + 2 * selectorWidth, 10, selectorWidth, 30);
     browseButton.setBounds(10, 50, getWidth() - 20, 30);
     wasmFileLabel.setBounds(10, 90, getWidth() - 20, 24);
 
     // Position new UI elements
     accessMessageInput.setBounds(10, 120, getWidth() - 20, 24);
     downloadButton.setBounds(10, 150, getWidth() - 20, 30);
+    renderLoadLabel.setBounds(10, 190, getWidth() - 20, 24);
+    profileToggle.setBounds(10, 220, 100, 30);
+    saveProfileButton.setBounds(120, 220, getWidth() - 130, 30);
+    profileView.setBounds(10, 260, getWidth() - 20, getHeight() - 270);
+}
+
+// Shows the routing and module of the selected slot
+void WebAssemblyMusicSynthEditor::updateSlotControls()
+{
+    const int inputChannel = processor.getSelectedInputChannel();
+    if (inputChannel >= 0)
+        inputChannelSelector.setSelectedId(inputChannel == 0 ? 17 : inputChannel, juce::dontSendNotification);
+    const int instrument = processor.getSelectedInstrument();
+    instrumentSelector.setSelectedId(instrument == 0 ? 17 : instrument, juce::dontSendNotification);
+
+    const juce::String modulePath = processor.getModulePath();
+    wasmFileLabel.setText(modulePath.isNotEmpty() ? modulePath : "No wasm file selected", juce::dontSendNotification);
+}
+
+void WebAssemblyMusicSynthEditor::timerCallback()
+{
+    juce::String backendName = processor.getBackendName();
+    if (backendName.isEmpty())
+    {
+        renderLoadLabel.setText("No synth loaded in slot " + juce::String(processor.getSelectedSlot() + 1), juce::dontSendNotification);
+        profileView.setText("", false);
+        return;
+    }
+    renderLoadLabel.setText(backendName + ": " + juce::String(processor.getAverageRenderMicroseconds(), 1) + " us/block, "
+                                + juce::String(processor.getRenderLoad() * 100.0, 1) + "% CPU, "
+                                + juce::String(processor.getNumActiveSlots()) + " active slots",
+                            juce::dontSendNotification);
+    updateProfileView();
+}
+
+void WebAssemblyMusicSynthEditor::updateProfileView()
+{
+    SynthModuleProfile profile;
+    if (!processor.getProfile(profile))
+    {
+        profileView.setText(processor.isProfilingEnabled() ? "No profile, only wasm modules can be profiled" : "", false);
+        return;
+    }
+
+    juce::String text = "export                        calls    instructions        cost    ms\n";
+    for (const auto &exportStats : profile.exports)
+    {
+        text << exportStats.name.paddedRight(' ', 28)
+             << juce::String((juce::int64)exportStats.calls).paddedLeft(' ', 8)
+             << juce::String((juce::int64)exportStats.instructions).paddedLeft(' ', 16)
+             << juce::String((juce::int64)exportStats.cost).paddedLeft(' ', 12)
+             << juce::String(exportStats.seconds * 1000.0, 1).paddedLeft(' ', 8) << "\n";
+    }
+
+    // hottest channels first, from the sampled voice activity
+    std::array<int, 16> channels;
+    for (int n = 0; n < 16; n++)
+        channels[n] = n;
+    std::sort(channels.begin(), channels.end(), [&profile](int a, int b)
+              { return profile.channelInstructions[a] > profile.channelInstructions[b]; });
+
+    text << "\nchannel    instructions    voices\n";
+    for (int channel : channels)
+    {
+        if (profile.channelInstructions[channel] == 0)
+            break;
+        text << juce::String(channel + 1).paddedLeft(' ', 7)
+             << juce::String((juce::int64)profile.channelInstructions[channel]).paddedLeft(' ', 16)
+             << juce::String((double)profile.channelVoices[channel] / profile.voiceSamples, 1).paddedLeft(' ', 10) << "\n";
+    }
+    profileView.setText(text, false);
 }
 
 void WebAssemblyMusicSynthEditor::comboBoxChanged(juce::ComboBox *comboBoxThatHasChanged)
 {
-    if (comboBoxThatHasChanged == &instrumentSelector)
-        processor.selectInstrument(instrumentSelector.getSelectedId());
+    if (comboBoxThatHasChanged == &slotSelector)
+    {
+        processor.selectSlot(slotSelector.getSelectedId() - 1);
+        updateSlotControls();
+    }
+    else if (comboBoxThatHasChanged == &inputChannelSelector)
+    {
+        const int id = inputChannelSelector.getSelectedId();
+        processor.selectInputChannel(id == 17 ? 0 : id);
+    }
+    else if (comboBoxThatHasChanged == &instrumentSelector)
+    {
+        const int id = instrumentSelector.getSelectedId();
+        processor.selectInstrument(id == 17 ? 0 : id);
+    }
 }
 
 void WebAssemblyMusicSynthEditor::buttonClicked(juce::Button* button)
 {
-    if (button == &browseButton)
+    if (button == &profileToggle)
+    {
+        processor.setProfilingEnabled(profileToggle.getToggleState());
+    }
+    else if (button == &saveProfileButton)
+    {
+        profileChooser = std::make_unique<juce::FileChooser>(
+            "Save profile",
+            juce::File::getSpecialLocation(juce::File::userDocumentsDirectory).getChildFile("synthprofile.json"),
+            "*.json"
+        );
+
+        auto chooserFlags = juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::warnAboutOverwriting;
+
+        profileChooser->launchAsync(chooserFlags, [this](const juce::FileChooser& fc)
+        {
+            auto selectedFile = fc.getResult();
+            if (selectedFile != juce::File() && !processor.saveProfile(selectedFile))
+            {
+                juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon,
+                                                       "Profile Error",
+                                                       "No profile to save. Enable profiling and load a wasm file first.");
+            }
+        });
+    }
+    else if (button == &browseButton)
     {
         wasmChooser = std::make_unique<juce::FileChooser>(
-            "Select a Wasm file",
+            "Select a Wasm file or native synth",
             juce::File(),
-            "*.wasm"
+            "*.wasm;*.so;*.dylib"
         );
 
         auto chooserFlags = juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles;
@@ -544,8 +473,7 @@ void WebAssemblyMusicSynthEditor::buttonClicked(juce::Button* button)
             {
                 juce::Logger::writeToLog("Successfully saved Wasm to: " + actualTempFile.getFullPathName() + " Size: " + juce::String(actualTempFile.getSize()));
 
-                processor.compileAndLoadWasm(actualTempFile.getFullPathName());
-                processor.prepareWasm(); 
+                processor.loadWasmFile(actualTempFile.getFullPathName());
             }
             else
             {
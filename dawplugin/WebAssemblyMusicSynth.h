@@ -0,0 +1,310 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <string> // Add this for std::string
+#include "SynthModule.h"
+#include "SynthRack.h"
+
+class WebAssemblyMusicSynth; // Forward declare
+
+class WebAssemblyMusicSynthEditor : public juce::AudioProcessorEditor,
+                            private juce::ComboBox::Listener,
+                            private juce::Button::Listener,
+                            private juce::Timer
+{
+public:
+    explicit WebAssemblyMusicSynthEditor(WebAssemblyMusicSynth &p);
+    void resized() override;
+
+private:
+    void comboBoxChanged(juce::ComboBox *comboBoxThatHasChanged) override;
+    void buttonClicked(juce::Button* button) override;
+    void timerCallback() override;
+    void updateProfileView();
+    void updateSlotControls();
+
+    WebAssemblyMusicSynth &processor;
+    juce::ComboBox slotSelector;
+    juce::ComboBox inputChannelSelector;
+    juce::ComboBox instrumentSelector;
+    juce::TextButton browseButton { "Browse Wasm File" };
+    juce::Label wasmFileLabel;
+    juce::Label renderLoadLabel;
+    std::unique_ptr<juce::FileChooser> wasmChooser;
+
+    juce::ToggleButton profileToggle { "Profile" };
+    juce::TextButton saveProfileButton { "Save Profile JSON" };
+    juce::TextEditor profileView;
+    std::unique_ptr<juce::FileChooser> profileChooser;
+
+    // Added for Wasm download feature
+    juce::TextEditor accessMessageInput;
+    juce::TextButton downloadButton { "Download & Load Wasm" };
+};
+
+// Host parameter slot, mapped onto the parameter with the same index in the loaded module.
+// The host sees a 0..1 value, which is scaled to the range declared by the module.
+class SynthModuleParameter final : public juce::AudioParameterFloat
+{
+public:
+    explicit SynthModuleParameter(int index)
+        : juce::AudioParameterFloat(juce::ParameterID("param" + juce::String(index + 1), 1),
+                                    "Parameter " + juce::String(index + 1), 0.0f, 1.0f, 0.0f),
+          slotName("Parameter " + juce::String(index + 1))
+    {
+    }
+
+    // Called on the message thread when a module is loaded, with NULL if the module has no parameter in this slot
+    void setModuleParameter(const SynthModule::Parameter *parameter)
+    {
+        {
+            const juce::SpinLock::ScopedLockType lock(nameLock);
+            moduleParameterName = parameter != NULL ? parameter->name : juce::String();
+        }
+        if (parameter != NULL)
+            setValueNotifyingHost((parameter->defaultValue - parameter->minValue) / (parameter->maxValue - parameter->minValue));
+    }
+
+    juce::String getName(int maximumStringLength) const override
+    {
+        const juce::SpinLock::ScopedLockType lock(nameLock);
+        return (moduleParameterName.isNotEmpty() ? moduleParameterName : slotName).substring(0, maximumStringLength);
+    }
+
+private:
+    const juce::String slotName;
+    juce::String moduleParameterName;
+    juce::SpinLock nameLock;
+};
+
+class WebAssemblyMusicSynth final : public AudioProcessor
+{
+public:
+    WebAssemblyMusicSynth()
+        : AudioProcessor(BusesProperties().withOutput("Output", AudioChannelSet::stereo()))
+    {
+        // Hosts expect a fixed parameter list, so there is one slot for each parameter a module can declare
+        for (int n = 0; n < SynthModule::maxParameters; n++)
+        {
+            auto parameter = std::make_unique<SynthModuleParameter>(n);
+            moduleParameters[n] = parameter.get();
+            addParameter(parameter.release());
+        }
+        rack.setModuleChannel(0, selectedInstrumentId);
+    }
+
+    // Loads a synth module into a rack slot, selecting the backend from the file: .wasm files are compiled and run
+    // in WasmEdge, .so / .dylib files are native builds of the same synth loaded with dlopen.
+    bool loadSynthModule(int slot, const juce::String& path)
+    {
+        std::unique_ptr<SynthModule> newModule = SynthModule::load(path, profilingEnabled);
+        if (newModule == nullptr)
+            return false;
+        if (!newModule->prepare(synth.getSampleRate() > 0 ? synth.getSampleRate() : 44100.0))
+            return false;
+
+        rack.setModule(slot, std::move(newModule), path);
+        publishModuleParameters();
+        resetRenderStats();
+        return true;
+    }
+
+    // Profiling instruments the compiled wasm modules, so toggling it reloads the modules of all slots.
+    // Only applies to the WasmEdge backend, native modules have no profile.
+    void setProfilingEnabled(bool shouldProfile)
+    {
+        if (profilingEnabled == shouldProfile)
+            return;
+        profilingEnabled = shouldProfile;
+        for (int slot = 0; slot < SynthRack::maxSlots; slot++)
+        {
+            const juce::String path = rack.getModulePath(slot);
+            if (path.isNotEmpty() && juce::File(path).existsAsFile())
+                loadSynthModule(slot, path);
+        }
+    }
+
+    bool isProfilingEnabled() const { return profilingEnabled; }
+
+    // Profile of the module in the selected slot. Reads through the slot configuration, so the editor never blocks rendering.
+    bool getProfile(SynthModuleProfile &profile) const
+    {
+        std::shared_ptr<SynthModule> module = rack.getModule(selectedSlot);
+        return module != nullptr && module->getProfile(profile);
+    }
+
+    bool saveProfile(const juce::File &file) const
+    {
+        SynthModuleProfile profile;
+        if (!getProfile(profile))
+            return false;
+        return file.replaceWithText(juce::JSON::toString(profile.toVar()));
+    }
+
+    static String getIdentifier()
+    {
+        return "WasmEdge Synth";
+    }
+
+    void prepareToPlay(double newSampleRate, int maximumExpectedSamplesPerBlock) override
+    {
+        synth.setCurrentPlaybackSampleRate(newSampleRate);
+        printf("Samplerate is %f\n", newSampleRate);
+        rack.prepareToPlay(newSampleRate, maximumExpectedSamplesPerBlock);
+        prepareSynthModules();
+    }
+
+    void prepareSynthModules() {
+        rack.prepareModules();
+        publishModuleParameters();
+        resetRenderStats();
+        printf("Prepare completed\n");
+    }
+
+    // Rack slot that the editor controls
+    void selectSlot(int slot)
+    {
+        selectedSlot = juce::jlimit(0, SynthRack::maxSlots - 1, slot);
+    }
+
+    int getSelectedSlot() const { return selectedSlot; }
+
+    // Channel the selected slot remaps its MIDI to, 1-16, or 0 to keep the channel of the incoming messages
+    void selectInstrument(int instrumentId)
+    {
+        rack.setModuleChannel(selectedSlot, instrumentId);
+        printf("Selected instrument ID: %d for slot %d\n", instrumentId, selectedSlot + 1);
+    }
+
+    int getSelectedInstrument() const { return rack.getModuleChannel(selectedSlot); }
+
+    // Incoming MIDI channel 1-16 routed to the selected slot, or 0 for all channels
+    void selectInputChannel(int channel)
+    {
+        rack.setInputChannels(selectedSlot, channel == 0 ? SynthRack::allChannels : (uint16_t)(1 << (channel - 1)));
+    }
+
+    int getSelectedInputChannel() const
+    {
+        const uint16_t channels = rack.getInputChannels(selectedSlot);
+        if (channels == SynthRack::allChannels)
+            return 0;
+        for (int channel = 0; channel < 16; channel++)
+            if (channels == (1 << channel))
+                return channel + 1;
+        return -1;
+    }
+
+    void loadWasmFile(const juce::String& filePath)
+    {
+        loadSynthModule(selectedSlot, filePath);
+    }
+
+    juce::String getModulePath() const { return rack.getModulePath(selectedSlot); }
+
+    // Backend of the module in the selected slot, or an empty string if none is loaded
+    juce::String getBackendName() const
+    {
+        std::shared_ptr<SynthModule> module = rack.getModule(selectedSlot);
+        return module != nullptr ? juce::String(SynthModule::getBackendName(module->getBackend())) : juce::String();
+    }
+
+    // Average time spent inside the synth modules per rendered block, and the share of the
+    // realtime budget it takes. Used for comparing the wasm and native build of the same synth.
+    double getAverageRenderMicroseconds() const { return averageRenderMicroseconds.load(); }
+    double getRenderLoad() const { return renderLoad.load(); }
+    int getNumActiveSlots() const { return rack.getNumActiveSlots(); }
+
+    void releaseResources() override
+    {
+    }
+
+    void processBlock(AudioBuffer<float> &buffer, MidiBuffer &midiMessages) override
+    {
+        const int64 renderStartTicks = Time::getHighResolutionTicks();
+
+        std::array<float, SynthModule::maxParameters> normalisedParameters;
+        for (int n = 0; n < SynthModule::maxParameters; n++)
+            normalisedParameters[n] = moduleParameters[n]->get();
+
+        rack.process(buffer, midiMessages, normalisedParameters);
+
+        updateRenderStats(Time::getHighResolutionTicks() - renderStartTicks, buffer.getNumSamples());
+    }
+
+    using AudioProcessor::processBlock;
+
+    const String getName() const override { return getIdentifier(); }
+    double getTailLengthSeconds() const override { return 0.0; }
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return true; }
+    AudioProcessorEditor *createEditor() override
+    {
+        return new WebAssemblyMusicSynthEditor(*this);
+    }
+
+    bool hasEditor() const override
+    {
+        return true;
+    }
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const String &) override {}
+    void getStateInformation(juce::MemoryBlock &) override {}
+    void setStateInformation(const void *, int) override {}
+
+private:
+    // Names the host parameters after the module parameters they are assigned to, and resets them to the
+    // defaults of the modules. The smoothing starts over from there, so nothing ramps from the previous assignment.
+    void publishModuleParameters()
+    {
+        const auto assignments = rack.getParameterAssignments();
+        std::array<bool, SynthModule::maxParameters> assigned {};
+        for (int slot = 0; slot < SynthRack::maxSlots; slot++)
+        {
+            if (assignments[slot].count == 0)
+                continue;
+            const auto &parameters = rack.getModule(slot)->getParameters();
+            for (int n = 0; n < assignments[slot].count; n++)
+            {
+                moduleParameters[assignments[slot].offset + n]->setModuleParameter(&parameters[n]);
+                assigned[assignments[slot].offset + n] = true;
+            }
+        }
+        for (int n = 0; n < SynthModule::maxParameters; n++)
+            if (!assigned[n])
+                moduleParameters[n]->setModuleParameter(NULL);
+        rack.resetParameterSmoothing();
+        updateHostDisplay(ChangeDetails().withParameterInfoChanged(true));
+    }
+
+    void resetRenderStats()
+    {
+        averageRenderMicroseconds = 0.0;
+        renderLoad = 0.0;
+    }
+
+    void updateRenderStats(int64 elapsedTicks, int numSamples)
+    {
+        if (numSamples == 0)
+            return;
+        const double elapsedMicroseconds = Time::highResolutionTicksToSeconds(elapsedTicks) * 1.0e6;
+        const double blockMicroseconds = numSamples * 1.0e6 / synth.getSampleRate();
+        // exponential moving average, smooths over roughly the last 100 blocks
+        const double smoothing = 0.01;
+        averageRenderMicroseconds = averageRenderMicroseconds.load() + (elapsedMicroseconds - averageRenderMicroseconds.load()) * smoothing;
+        renderLoad = renderLoad.load() + (elapsedMicroseconds / blockMicroseconds - renderLoad.load()) * smoothing;
+    }
+
+    int selectedInstrumentId = 1; // Default to 1 (Piano)
+    int selectedSlot = 0;
+    SynthRack rack;
+    bool profilingEnabled = false;
+    std::atomic<double> averageRenderMicroseconds { 0.0 };
+    std::atomic<double> renderLoad { 0.0 };
+    std::array<SynthModuleParameter *, SynthModule::maxParameters> moduleParameters {};
+    Synthesiser synth;
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WebAssemblyMusicSynth)
+};
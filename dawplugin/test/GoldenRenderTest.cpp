@@ -0,0 +1,268 @@
+#include "../WebAssemblyMusicSynth.h"
+
+/**
+ * Golden render regression and performance test for the plugin host.
+ *
+ * Plays the MIDI scenarios of test/scenarios.json through WebAssemblyMusicSynth with the reference
+ * wasm module (built from wasmaudioworklet/synth1 by buildreferencewasm.sh), and compares the output
+ * sample by sample with the golden renders, which rendergolden.mjs records by running the same
+ * module in node the way the rack drives it. A missing module, scenario file or golden render fails.
+ *
+ *   WebAssemblyMusicSynthTests [--wasm <file>] [--golden-dir <dir>] [--scenarios <file>] [--tolerance <abs>]
+ *                              [--budgets <file> [--threshold <fraction>] | --record-budgets <file>] [--runs <n>]
+ *
+ * The render times are only checked against the budgets of a --budgets file, since they depend
+ * on the machine. --record-budgets writes the render time of every scenario on this machine.
+ * --threshold is how much slower than the budget a scenario may render before it fails,
+ * 0.25 (25%) by default, or taken from the SYNTH_PERF_THRESHOLD environment variable.
+ */
+
+namespace
+{
+struct MidiEvent
+{
+    int position;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+};
+
+struct Scenario
+{
+    juce::String name;
+    // each slot gets the reference module, with MIDI channel n + 1 routed to channel 1 of slot n
+    int numSlots;
+    int numSamples;
+    std::vector<MidiEvent> events;
+};
+
+struct Scenarios
+{
+    double sampleRate = 0;
+    int blockSize = 0;
+    std::vector<Scenario> scenarios;
+};
+
+bool readScenarios(const juce::File &file, Scenarios &result)
+{
+    const juce::var json = juce::JSON::parse(file);
+    result.sampleRate = json["sampleRate"];
+    result.blockSize = json["blockSize"];
+    const juce::Array<juce::var> *scenarios = json["scenarios"].getArray();
+    if (result.sampleRate <= 0 || result.blockSize <= 0 || scenarios == nullptr)
+        return false;
+    for (const auto &entry : *scenarios)
+    {
+        Scenario scenario { entry["name"].toString(), entry["slots"], entry["frames"], {} };
+        const juce::Array<juce::var> *events = entry["events"].getArray();
+        if (scenario.name.isEmpty() || scenario.numSlots < 1 || scenario.numSlots > SynthRack::maxSlots
+            || scenario.numSamples < 1 || events == nullptr)
+            return false;
+        for (const auto &event : *events)
+        {
+            if (event.size() != 4)
+                return false;
+            scenario.events.push_back({ event[0], (uint8_t)(int)event[1], (uint8_t)(int)event[2], (uint8_t)(int)event[3] });
+        }
+        result.scenarios.push_back(scenario);
+    }
+    return true;
+}
+
+struct Render
+{
+    std::vector<float> samples; // interleaved stereo
+    double seconds = 0;         // time spent in processBlock
+};
+
+bool render(const Scenario &scenario, double sampleRate, int blockSize, const juce::String &wasmPath, Render &result)
+{
+    WebAssemblyMusicSynth processor;
+    processor.prepareToPlay(sampleRate, blockSize);
+    for (int slot = 0; slot < scenario.numSlots; slot++)
+    {
+        processor.selectSlot(slot);
+        processor.selectInputChannel(slot + 1);
+        processor.selectInstrument(1);
+        if (!processor.loadSynthModule(slot, wasmPath))
+            return false;
+    }
+
+    const int numSamples = scenario.numSamples;
+    juce::AudioBuffer<float> buffer(2, blockSize);
+    juce::MidiBuffer midiMessages;
+    result.samples.clear();
+    result.samples.reserve((size_t)numSamples * 2);
+    result.seconds = 0;
+
+    for (int blockStart = 0; blockStart < numSamples; blockStart += blockSize)
+    {
+        const int numBlockSamples = juce::jmin(blockSize, numSamples - blockStart);
+        midiMessages.clear();
+        for (const auto &event : scenario.events)
+        {
+            if (event.position >= blockStart && event.position < blockStart + numBlockSamples)
+                midiMessages.addEvent(juce::MidiMessage(event.status, event.data1, event.data2), event.position - blockStart);
+        }
+
+        buffer.setSize(2, numBlockSamples, false, false, true);
+        const juce::int64 startTicks = juce::Time::getHighResolutionTicks();
+        processor.processBlock(buffer, midiMessages);
+        result.seconds += juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - startTicks);
+
+        for (int n = 0; n < numBlockSamples; n++)
+        {
+            result.samples.push_back(buffer.getSample(0, n));
+            result.samples.push_back(buffer.getSample(1, n));
+        }
+    }
+    return true;
+}
+
+bool readGolden(const juce::File &file, std::vector<float> &samples)
+{
+    juce::MemoryBlock data;
+    if (!file.loadFileAsData(data))
+        return false;
+    samples.resize(data.getSize() / sizeof(float));
+    memcpy(samples.data(), data.getData(), samples.size() * sizeof(float));
+    return true;
+}
+
+// Null test: subtracts the golden render and returns the largest remaining difference
+double nullTest(const std::vector<float> &samples, const std::vector<float> &golden)
+{
+    double peakDifference = 0;
+    for (size_t n = 0; n < samples.size(); n++)
+        peakDifference = juce::jmax(peakDifference, (double)std::abs(samples[n] - golden[n]));
+    return peakDifference;
+}
+
+juce::String getOption(const juce::StringArray &args, const juce::String &name, const juce::String &defaultValue)
+{
+    const int index = args.indexOf(name);
+    return index >= 0 && index + 1 < args.size() ? args[index + 1] : defaultValue;
+}
+
+juce::File getFileOption(const juce::StringArray &args, const juce::String &name, const juce::File &defaultFile)
+{
+    const int index = args.indexOf(name);
+    return index >= 0 && index + 1 < args.size() ? juce::File::getCurrentWorkingDirectory().getChildFile(args[index + 1]) : defaultFile;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::StringArray args;
+    for (int n = 1; n < argc; n++)
+        args.add(argv[n]);
+
+    const juce::File testDir(GOLDEN_TEST_DIR);
+    const juce::String wasmPath = getFileOption(args, "--wasm", testDir.getChildFile("reference/midisynth.wasm")).getFullPathName();
+    const juce::File goldenDir = getFileOption(args, "--golden-dir", testDir.getChildFile("golden"));
+    const juce::File scenariosFile = getFileOption(args, "--scenarios", testDir.getChildFile("scenarios.json"));
+    const juce::File budgetsFile = getFileOption(args, "--budgets", juce::File());
+    const juce::File recordBudgetsFile = getFileOption(args, "--record-budgets", juce::File());
+    const double tolerance = getOption(args, "--tolerance", "0").getDoubleValue();
+    const double threshold = getOption(args, "--threshold", juce::SystemStats::getEnvironmentVariable("SYNTH_PERF_THRESHOLD", "0.25")).getDoubleValue();
+    const bool timed = budgetsFile != juce::File() || recordBudgetsFile != juce::File();
+    const int runs = timed ? juce::jmax(1, getOption(args, "--runs", "3").getIntValue()) : 1;
+
+    if (!juce::File(wasmPath).existsAsFile())
+    {
+        printf("FAIL: reference wasm module %s not found, build it with test/buildreferencewasm.sh\n", wasmPath.toRawUTF8());
+        return 1;
+    }
+    Scenarios scenarios;
+    if (!readScenarios(scenariosFile, scenarios))
+    {
+        printf("FAIL: no scenarios in %s\n", scenariosFile.getFullPathName().toRawUTF8());
+        return 1;
+    }
+    juce::var budgets;
+    if (budgetsFile != juce::File())
+    {
+        budgets = juce::JSON::parse(budgetsFile);
+        if (!budgets.isObject())
+        {
+            printf("FAIL: no budgets in %s\n", budgetsFile.getFullPathName().toRawUTF8());
+            return 1;
+        }
+    }
+    juce::var recordedBudgets(new juce::DynamicObject());
+
+    int failures = 0;
+    for (const auto &scenario : scenarios.scenarios)
+    {
+        const char *name = scenario.name.toRawUTF8();
+        Render result;
+        // the fastest of the runs, so that the budgets are not affected by other load on the machine
+        double fastestSeconds = 0;
+        for (int run = 0; run < runs; run++)
+        {
+            if (!render(scenario, scenarios.sampleRate, scenarios.blockSize, wasmPath, result))
+            {
+                printf("FAIL %s: could not load %s\n", name, wasmPath.toRawUTF8());
+                return 1;
+            }
+            fastestSeconds = run == 0 ? result.seconds : juce::jmin(fastestSeconds, result.seconds);
+        }
+        const int numBlocks = (scenario.numSamples + scenarios.blockSize - 1) / scenarios.blockSize;
+        const double microsecondsPerBlock = fastestSeconds * 1.0e6 / numBlocks;
+        recordedBudgets.getDynamicObject()->setProperty(scenario.name, microsecondsPerBlock);
+
+        const juce::File goldenFile = goldenDir.getChildFile(scenario.name + ".f32");
+        std::vector<float> golden;
+        if (!readGolden(goldenFile, golden))
+        {
+            printf("FAIL %s: no golden render %s, record it with test/rendergolden.mjs\n", name, goldenFile.getFullPathName().toRawUTF8());
+            failures++;
+            continue;
+        }
+        if (golden.size() != result.samples.size())
+        {
+            printf("FAIL %s: rendered %d samples, the golden render has %d\n", name, (int)result.samples.size(), (int)golden.size());
+            failures++;
+            continue;
+        }
+        const double peakDifference = nullTest(result.samples, golden);
+        if (peakDifference > tolerance)
+        {
+            printf("FAIL %s: differs from the golden render by up to %g (%.1f dB)\n", name, peakDifference,
+                   juce::Decibels::gainToDecibels(peakDifference));
+            failures++;
+            continue;
+        }
+
+        if (budgetsFile == juce::File())
+        {
+            printf("PASS %s\n", name);
+            continue;
+        }
+        const double budget = budgets[scenario.name.toRawUTF8()];
+        if (!(budget > 0))
+        {
+            printf("FAIL %s: no budget in %s\n", name, budgetsFile.getFullPathName().toRawUTF8());
+            failures++;
+            continue;
+        }
+        if (microsecondsPerBlock > budget * (1.0 + threshold))
+        {
+            printf("FAIL %s: %.1f us/block, budget is %.1f us/block + %.0f%%\n", name, microsecondsPerBlock, budget, threshold * 100.0);
+            failures++;
+            continue;
+        }
+        printf("PASS %s: %.1f us/block (budget %.1f)\n", name, microsecondsPerBlock, budget);
+    }
+
+    if (recordBudgetsFile != juce::File())
+    {
+        recordBudgetsFile.replaceWithText(juce::JSON::toString(recordedBudgets));
+        printf("Recorded the budgets in %s\n", recordBudgetsFile.getFullPathName().toRawUTF8());
+    }
+
+    printf("%d failed\n", failures);
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/bash
+# Builds the reference wasm module for the golden render tests from wasmaudioworklet/synth1,
+# with the default midi mix (assembly/mixes/midi.mix.ts). Run `npm install` in wasmaudioworklet first.
+#
+#   buildreferencewasm.sh [output.wasm]
+#
+# The samplerate is imported from the host, the same way as in modules exported from the browser.
+set -e
+TESTDIR="$(cd "$(dirname "$0")" && pwd)"
+WASMAUDIOWORKLET="$TESTDIR/../../wasmaudioworklet"
+OUTPUT="${1:-$TESTDIR/reference/midisynth.wasm}"
+ASC="$WASMAUDIOWORKLET/node_modules/.bin/asc"
+if [ ! -x "$ASC" ]; then
+    echo "No AssemblyScript compiler in $WASMAUDIOWORKLET, run npm install there" >&2
+    exit 1
+fi
+BUILDDIR="$(mktemp -d)"
+trap 'rm -rf "$BUILDDIR"' EXIT
+
+cp -R "$WASMAUDIOWORKLET/synth1/assembly" "$BUILDDIR/assembly"
+echo 'export declare const SAMPLERATE: f32;' > "$BUILDDIR/assembly/environment.ts"
+cat > "$BUILDDIR/assembly/reference.ts" <<'ENTRY'
+export { fillSampleBuffer, fillSampleBufferWithNumSamples, samplebuffer, allNotesOff, shortmessage, getActiveVoicesStatusSnapshot } from './midi/midisynth';
+export { parameterblock, parameterdescriptors, parametercount } from './midi/parameters';
+ENTRY
+
+mkdir -p "$(dirname "$OUTPUT")"
+"$ASC" "$BUILDDIR/assembly/reference.ts" --runtime stub -O3 -o "$OUTPUT"
+echo "Built $OUTPUT"
@@ -0,0 +1,131 @@
+// Records the golden renders for GoldenRenderTest.cpp: plays the scenarios of scenarios.json with
+// the reference wasm module in node, driving the module the way SynthRack does in the plugin
+// (MIDI at the start of each block, 128 frame render quanta, idle slots skipped, a 0.3 mix gain).
+// The plugin runs the same module with WasmEdge, so the two renders have to be bit identical.
+//
+//   node rendergolden.mjs [--wasm <file>] [--golden-dir <dir>] [--scenarios <file>]
+
+import fs from 'fs';
+import path from 'path';
+import { fileURLToPath } from 'url';
+
+const testDir = path.dirname(fileURLToPath(import.meta.url));
+const SAMPLE_BUFFER_FRAMES = 128;
+const IDLE_AFTER_SECONDS = 0.5;
+const SILENCE = Math.fround(1.0e-5);
+const MIX_GAIN = Math.fround(0.3);
+
+function getOption(name, defaultValue) {
+    const index = process.argv.indexOf(name);
+    return index >= 0 && index + 1 < process.argv.length ? process.argv[index + 1] : defaultValue;
+}
+
+async function createSlot(wasm, sampleRate, blockSize) {
+    const { instance } = await WebAssembly.instantiate(wasm, {
+        environment: { SAMPLERATE: new WebAssembly.Global({ value: 'f32', mutable: false }, sampleRate) }
+    });
+    const exports = instance.exports;
+    // the plugin writes smoothed host values to the parameter block, which this host doesn't model
+    if (exports.parametercount && exports.parametercount.value > 0) {
+        throw new Error('the reference module must not declare parameters');
+    }
+    return {
+        exports,
+        pendingMessages: [],
+        heldNotes: 0,
+        silentSamples: 0,
+        output: [new Float32Array(blockSize), new Float32Array(blockSize)]
+    };
+}
+
+function isIdle(slot, sampleRate) {
+    return slot.pendingMessages.length === 0 && slot.heldNotes === 0 &&
+        slot.silentSamples >= Math.trunc(IDLE_AFTER_SECONDS * sampleRate);
+}
+
+// SynthRack::renderSlot
+function renderSlot(slot, numSamples) {
+    for (const [status, data1, data2] of slot.pendingMessages) {
+        const command = status & 0xF0;
+        if (command === 0x90 && data2 > 0) {
+            slot.heldNotes++;
+        } else if ((command === 0x80 || command === 0x90) && slot.heldNotes > 0) {
+            slot.heldNotes--;
+        } else if (command === 0xB0 && data1 >= 120) {
+            slot.heldNotes = 0;
+        }
+        slot.exports.shortmessage(status, data1, data2);
+    }
+    slot.pendingMessages = [];
+
+    let silent = true;
+    for (let sampleNo = 0; sampleNo < numSamples; sampleNo += SAMPLE_BUFFER_FRAMES) {
+        const numSamplesToRender = Math.min(numSamples - sampleNo, SAMPLE_BUFFER_FRAMES);
+        slot.exports.fillSampleBufferWithNumSamples(numSamplesToRender);
+        // the memory may have grown, which replaces its buffer
+        const samplebuffer = new Float32Array(slot.exports.memory.buffer, slot.exports.samplebuffer.value, SAMPLE_BUFFER_FRAMES * 2);
+        for (let ndx = 0; ndx < numSamplesToRender; ndx++) {
+            const left = samplebuffer[ndx];
+            const right = samplebuffer[ndx + SAMPLE_BUFFER_FRAMES];
+            slot.output[0][sampleNo + ndx] = left;
+            slot.output[1][sampleNo + ndx] = right;
+            silent = silent && Math.abs(left) < SILENCE && Math.abs(right) < SILENCE;
+        }
+    }
+    slot.silentSamples = silent ? slot.silentSamples + numSamples : 0;
+}
+
+async function renderScenario(wasm, scenario, sampleRate, blockSize) {
+    const slots = [];
+    for (let n = 0; n < scenario.slots; n++) {
+        slots.push(await createSlot(wasm, sampleRate, blockSize));
+    }
+    const samples = new Float32Array(scenario.frames * 2);
+    const mix = [new Float32Array(blockSize), new Float32Array(blockSize)];
+
+    for (let blockStart = 0; blockStart < scenario.frames; blockStart += blockSize) {
+        const numBlockSamples = Math.min(blockSize, scenario.frames - blockStart);
+        // slot n plays MIDI channel n + 1 on channel 1 of its module, in the order of the sample positions
+        const events = scenario.events
+            .filter(([frame]) => frame >= blockStart && frame < blockStart + numBlockSamples)
+            .sort((a, b) => a[0] - b[0]);
+        for (const [, status, data1, data2] of events) {
+            const slot = slots[status & 0x0F];
+            if (slot && (status & 0xF0) !== 0xF0) {
+                slot.pendingMessages.push([status & 0xF0, data1, data2]);
+            }
+        }
+
+        mix[0].fill(0);
+        mix[1].fill(0);
+        for (const slot of slots) {
+            if (isIdle(slot, sampleRate)) {
+                continue;
+            }
+            renderSlot(slot, numBlockSamples);
+            for (let channel = 0; channel < 2; channel++) {
+                for (let n = 0; n < numBlockSamples; n++) {
+                    mix[channel][n] += Math.fround(slot.output[channel][n] * MIX_GAIN);
+                }
+            }
+        }
+        for (let n = 0; n < numBlockSamples; n++) {
+            samples[(blockStart + n) * 2] = mix[0][n];
+            samples[(blockStart + n) * 2 + 1] = mix[1][n];
+        }
+    }
+    return samples;
+}
+
+const wasmPath = getOption('--wasm', path.join(testDir, 'reference', 'midisynth.wasm'));
+const goldenDir = getOption('--golden-dir', path.join(testDir, 'golden'));
+const scenariosPath = getOption('--scenarios', path.join(testDir, 'scenarios.json'));
+
+const wasm = fs.readFileSync(wasmPath);
+const { sampleRate, blockSize, scenarios } = JSON.parse(fs.readFileSync(scenariosPath, 'utf8'));
+fs.mkdirSync(goldenDir, { recursive: true });
+for (const scenario of scenarios) {
+    const samples = await renderScenario(wasm, scenario, sampleRate, blockSize);
+    fs.writeFileSync(path.join(goldenDir, `${scenario.name}.f32`), Buffer.from(samples.buffer));
+    console.log(`RECORDED ${scenario.name}: ${scenario.frames} frames`);
+}
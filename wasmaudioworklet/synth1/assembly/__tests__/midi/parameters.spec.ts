@@ -0,0 +1,32 @@
+import { declareParameter, parameterblock, parameterdescriptors, parametercount, PARAMETER_DESCRIPTOR_SIZE, PARAMETER_NAME_LENGTH, MAX_PARAMETERS } from '../../midi/parameters';
+
+describe("parameters", () => {
+  it("should write the descriptor and default value of a declared parameter", () => {
+    const index = declareParameter('cutoff', 20, 20000, 440);
+    expect<i32>(index).toBe(0);
+    expect<i32>(parametercount).toBe(1);
+    expect<f32>(parameterblock[0]).toBe(440);
+
+    const descriptor = changetype<usize>(parameterdescriptors);
+    expect<u8>(load<u8>(descriptor)).toBe(0x63, 'c');
+    expect<u8>(load<u8>(descriptor + 5)).toBe(0x66, 'f');
+    expect<u8>(load<u8>(descriptor + 6)).toBe(0, 'name should be zero terminated');
+    expect<f32>(load<f32>(descriptor + PARAMETER_NAME_LENGTH)).toBe(20);
+    expect<f32>(load<f32>(descriptor + PARAMETER_NAME_LENGTH + 4)).toBe(20000);
+    expect<f32>(load<f32>(descriptor + PARAMETER_NAME_LENGTH + 8)).toBe(440);
+  });
+  it("should truncate long names and keep the terminating zero", () => {
+    const index = declareParameter('a parameter name that is longer than the descriptor', 0, 1, 0.5);
+    const descriptor = changetype<usize>(parameterdescriptors) + index * PARAMETER_DESCRIPTOR_SIZE;
+    expect<u8>(load<u8>(descriptor + PARAMETER_NAME_LENGTH - 2)).not.toBe(0);
+    expect<u8>(load<u8>(descriptor + PARAMETER_NAME_LENGTH - 1)).toBe(0);
+    expect<f32>(parameterblock[index]).toBe(0.5);
+  });
+  it("should refuse parameters beyond MAX_PARAMETERS", () => {
+    while (parametercount < MAX_PARAMETERS) {
+      declareParameter('p', 0, 1, 0);
+    }
+    expect<i32>(declareParameter('one too many', 0, 1, 0)).toBe(-1);
+    expect<i32>(parametercount).toBe(MAX_PARAMETERS);
+  });
+});
@@ -0,0 +1,45 @@
+// Host automatable parameters. A song's synth.ts declares its parameters with
+// declareParameter(), and reads the current values from parameterblock while
+// rendering. Hosts that support it (like the DAW plugin in dawplugin/) read the
+// descriptors once after instantiating the module, and then write the
+// (smoothed) parameter values directly into parameterblock before every
+// fillSampleBufferWithNumSamples() call, so automation needs no calls into the module.
+//
+// Each descriptor is PARAMETER_DESCRIPTOR_SIZE bytes:
+//   name:         PARAMETER_NAME_LENGTH bytes of UTF-8, zero padded
+//   min:          f32
+//   max:          f32
+//   defaultValue: f32
+
+export const MAX_PARAMETERS = 32;
+export const PARAMETER_NAME_LENGTH = 32;
+export const PARAMETER_DESCRIPTOR_SIZE = PARAMETER_NAME_LENGTH + 3 * 4;
+
+export const parameterblock = new StaticArray<f32>(MAX_PARAMETERS);
+export const parameterdescriptors = new StaticArray<u8>(MAX_PARAMETERS * PARAMETER_DESCRIPTOR_SIZE);
+export let parametercount: i32 = 0;
+
+/**
+ * Declares a parameter, and sets it to the default value. Returns the index
+ * into parameterblock, or -1 if all parameters are taken.
+ */
+export function declareParameter(name: string, minValue: f32, maxValue: f32, defaultValue: f32): i32 {
+    if (parametercount >= MAX_PARAMETERS) {
+        return -1;
+    }
+    const index = parametercount++;
+    const descriptor = changetype<usize>(parameterdescriptors) + index * PARAMETER_DESCRIPTOR_SIZE;
+
+    const nameBytes = Uint8Array.wrap(String.UTF8.encode(name));
+    // keep at least one terminating zero
+    const nameLength = min<i32>(nameBytes.length, PARAMETER_NAME_LENGTH - 1);
+    for (let n = 0; n < PARAMETER_NAME_LENGTH; n++) {
+        store<u8>(descriptor + n, n < nameLength ? nameBytes[n] : 0);
+    }
+    store<f32>(descriptor + PARAMETER_NAME_LENGTH, minValue);
+    store<f32>(descriptor + PARAMETER_NAME_LENGTH + 4, maxValue);
+    store<f32>(descriptor + PARAMETER_NAME_LENGTH + 8, defaultValue);
+
+    parameterblock[index] = defaultValue;
+    return index;
+}
@@ -55,6 +55,8 @@ export { allocateAudioBuffer } from '../midi/instruments/audioplayer';
 export { DefaultInstrument } from '../midi/instruments/defaultinstrument';
 export { synthState } from '../midi/midisynth';
 export { getSynthStateSnapshot } from '../midi/midisynth';
+export { declareParameter } from '../midi/parameters';
+export { parameterblock } from '../midi/parameters';
 export { MAX_ACTIVE_VOICES_SHIFT } from '../midi/midisynth';
 export { MAX_ACTIVE_VOICES } from '../midi/midisynth';
 export { midichannels } from '../midi/midisynth';
@@ -30,6 +30,7 @@ function createWebAssemblySongData(song, mode = EXPORT_MODE_MIDISYNTH_MULTIPART_
         `;
         assemblyscriptsynthsources[wasi_main_src] = `
             export { fillSampleBuffer, fillSampleBufferWithNumSamples, samplebuffer, allNotesOff, shortmessage, getActiveVoicesStatusSnapshot, getSynthStateSnapshot } from './midi/midisynth';
+            export { parameterblock, parameterdescriptors, parametercount } from './midi/parameters';
             export { seek, playEventsAndFillSampleBuffer, currentTimeMillis } from './midi/sequencer/midisequencer';
             import { midipartschedule } from './midi/sequencer/midiparts';
 